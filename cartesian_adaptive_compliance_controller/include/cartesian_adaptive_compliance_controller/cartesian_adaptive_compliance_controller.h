@@ -1,17 +1,23 @@
 #ifndef CARTESIAN_COMPLIANCE_CONTROLLER_H_INCLUDED
 #define CARTESIAN_COMPLIANCE_CONTROLLER_H_INCLUDED
 
+#include <cartesian_controller_base/ImpedanceSchedule.h>
 #include <cartesian_controller_base/ROS2VersionConfig.h>
+#include <cartesian_controller_base/TripleBuffer.h>
 #include <cartesian_controller_base/cartesian_controller_base.h>
 #include <cartesian_force_controller/cartesian_force_controller.h>
 #include <cartesian_motion_controller/cartesian_motion_controller.h>
 #include <controller_interface/controller_interface.hpp>
 #include <kdl/chain.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
+#include <realtime_tools/realtime_buffer.h>
 #include <cartesian_adaptive_compliance_controller/qpOASES.hpp>
+#include <cartesian_adaptive_compliance_controller/data_logger.h>
 #include <cartesian_adaptive_compliance_controller/data_reader.h>
+#include <cartesian_adaptive_compliance_controller/stiffness_optimizer.h>
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
 #include "std_msgs/msg/float64_multi_array.hpp"
-#include <queue>
+#include <atomic>
+#include <thread>
 
 USING_NAMESPACE_QPOASES
 namespace cartesian_adaptive_compliance_controller
@@ -23,6 +29,7 @@ class CartesianAdaptiveComplianceController
 {
   public:
     CartesianAdaptiveComplianceController();
+    ~CartesianAdaptiveComplianceController();
 
 #if defined CARTESIAN_CONTROLLERS_GALACTIC || defined CARTESIAN_CONTROLLERS_HUMBLE
     virtual LifecycleNodeInterface::CallbackReturn on_init() override;
@@ -50,35 +57,52 @@ class CartesianAdaptiveComplianceController
     using ForceBase = cartesian_force_controller::CartesianForceController;
 
   private:
+    /**
+     * @brief Get the real robot's end-effector position and velocity
+     *
+     * Reads the base's measured state, which \ref update computes once per cycle.
+     */
+    void getEndEffectorPoseReal();
+
+    /**
+     * @brief Compute the translational stiffness for this cycle
+     *
+     * Integrates the energy tank with the stiffness in use.
+     * The optimization itself runs either here or in the stiffness worker.
+     */
+    ctrl::Vector3D          computeStiffness();
+
+    /**
+     * @brief Optimize the translational stiffness for the given state
+     *
+     * Only call from one thread at a time.
+     */
+    void solveStiffness(const StiffnessState & state, StiffnessSolution & solution);
+
+    /**
+     * @brief Optimize the stiffness with the newest state at the given rate
+     *
+     * @param rate Optimizations per second
+     */
+    void stiffnessWorker(double rate);
+    void stopStiffnessWorker();
+
     /**
      * @brief Compute the net force of target wrench and stiffness-related pose offset
      *
      * @return The remaining error wrench, given in robot base frame
      */
-    void getEndEffectorPoseReal();
-    
-    ctrl::Vector6D          computeStiffness();
     ctrl::Vector6D          computeComplianceError();
-    std::shared_ptr<
-      KDL::ChainFkSolverVel_recursive>  m_fk_solver;
 
     ctrl::Matrix6D          m_stiffness;
     ctrl::Matrix6D          m_damping;
     std::string             m_compliance_ref_link;
 
-    const ctrl::Vector3D    Q = {3200,3200,3200};
-    const ctrl::Vector3D    R = {0.00001, 0.00001, 0.00001};
     ctrl::Vector3D          kd = {0,0,0};
-    ctrl::Vector6D          stiffness = {0,0,0,0,0,0};
-    ctrl::Vector3D          kd_max = {1000, 1000, 1000};
-    ctrl::Vector3D          kd_min = {300, 300, 100};
-    ctrl::Vector3D          F_max = {15, 15, 15};
-    ctrl::Vector3D          F_min = {-15, -15, -15};
     ctrl::Vector3D          x_d_old = {0,0,0};
     size_t                  m_window_length;
     ctrl::Vector6D          m_prev_error;
     double                  m_deltaT;
-    double                  m_sigma;
 
     ctrl::Vector3D          m_x;
     ctrl::Vector3D          m_x_dot;
@@ -88,42 +112,62 @@ class CartesianAdaptiveComplianceController
     std::vector<ctrl::Matrix3D>   m_desired_stiffness;
     
     // Tank
-    double Xt;
-    double dXt;
     double kl_ = 100;
     double dl_ = 20;
-    double tank_energy;
-    double tank_energy_threshold;
     double d_pass_const_stiff, d_pass_damp, d_pass_en;
     double d_pass_damp_int, en_var_stiff_int;
-    double energy_var_stiff, energy_var_damping;
+    EnergyTank m_tank;
+    EnergyTank::Step m_tank_step;  // Tank flow of this cycle
     rclcpp::Time old_time,current_time,start_time;
-    double old_z;
-    std::queue<double> m_surf_vel;
-    double m_surf_vel_sum;
 
-    QProblem min_problem;
-    int print_index = 0;
+    // Stiffness optimization
+    StiffnessParameters m_stiffness_parameters;
+    StiffnessOptimizer m_stiffness_optimizer;
+
+    // Asynchronous stiffness optimization
+    bool m_async_stiffness = false;
+    std::thread m_stiffness_worker;
+    std::atomic<bool> m_stiffness_worker_running{false};
+    cartesian_controller_base::TripleBuffer<StiffnessState> m_stiffness_state_buffer;
+    cartesian_controller_base::TripleBuffer<StiffnessSolution> m_stiffness_solution_buffer;
+    StiffnessSolution m_stiffness_solution;  // Newest solution in the control loop
 
     // ft sensor subscriber
     rclcpp::Subscription<geometry_msgs::msg::WrenchStamped>::SharedPtr m_ft_sensor_wrench_subscriber;
     void ftSensorWrenchCallback(const geometry_msgs::msg::WrenchStamped::SharedPtr wrench);
     ctrl::Vector3D m_ft_sensor_wrench;
 
-    // data publisher
-    rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr  m_data_publisher;
+    /**
+     * @brief Hand changes of the rotational stiffness over to the control loop
+     */
+    rcl_interfaces::msg::SetParametersResult parametersCallback(
+      const std::vector<rclcpp::Parameter> & parameters);
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr m_parameters_callback;
+    realtime_tools::RealtimeBuffer<ctrl::Vector3D> m_rot_stiffness_buffer;  // Without a schedule
+
+    // Rotational impedance schedule, with the controller's damping ratio by default
+    rclcpp::Subscription<std_msgs::msg::Float64MultiArray>::SharedPtr
+      m_impedance_schedule_subscriber;
+    void impedanceScheduleCallback(const std_msgs::msg::Float64MultiArray::SharedPtr schedule);
+    cartesian_controller_base::ImpedanceSchedule m_impedance_schedule{0.707};
+
+    /**
+     * @brief Queue this cycle's stiffness optimization data for the data logger
+     *
+     * Real-time safe. Uses the current tank and stiffness.
+     */
+    void logStiffnessData(const StiffnessState & state, const StiffnessSolution & solution);
+    DataLogger m_data_logger;
+    rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr m_data_publisher;
+
     rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr  m_target_pose_publisher;
     void publishTargetFrame();
     int step_seconds = 20;
     double z_step = 0.05;
     ctrl::Vector3D m_starting_pose;
 
-    // data from the data reader
-    std::vector<double> m_x_coordinates;
-    std::vector<double> m_y_coordinates;
-    std::vector<std::vector<double>> m_z_values;
-    std::vector<std::vector<double>> m_stiffness_values;
-    std::vector<std::vector<double>> m_damping_values;
+    // Surface height, stiffness and damping from the data reader
+    SurfaceMap m_surface_map;
 
 
 };
@@ -0,0 +1,122 @@
+#ifndef DATA_LOGGER_H_INCLUDED
+#define DATA_LOGGER_H_INCLUDED
+
+#include <cartesian_controller_base/SpscQueue.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace cartesian_adaptive_compliance_controller
+{
+/**
+ * @brief One control cycle of the stiffness optimization
+ */
+struct StiffnessRecord
+{
+  double time;
+  double x, y, z;        // End-effector position
+  double x_d, y_d, z_d;  // Target position
+  double f_ext;          // Force from the impedance law along z
+  double f_ft_x, f_ft_y, f_ft_z;
+  double f_ref;
+  double tank;
+  double tank_dot;
+  double kd_x, kd_y, kd_z;
+  double kd_z_max, kd_z_min;
+  double penetration;
+  double k_surf, d_surf;
+  double f_min;
+  double f_model;  // Force of the surface model along z
+  double max_pen;
+  double tank_threshold;
+  double power_limit;
+  double xdot_x, xdot_y, xdot_z;
+  double surf_vel;
+  double qp_nwsr;
+  double qp_cputime;
+  double qp_failures;
+
+  using Column = std::pair<const char *, double StiffnessRecord::*>;
+  static const std::array<Column, 34> columns;
+};
+
+/**
+ * @brief Real-time safe logging of \ref StiffnessRecord
+ *
+ * The control loop pushes records into a preallocated lock-free
+ * single-producer single-consumer queue. A background thread drains it and
+ * either writes one named variable per column with matlogger2 or hands
+ * each record to a \ref Sink.
+ * If the queue is full, records are dropped and counted.
+ */
+class DataLogger
+{
+public:
+  //! Consumes the records in the writer thread
+  using Sink = std::function<void(const StiffnessRecord &)>;
+
+  DataLogger();
+  ~DataLogger();
+
+  /**
+   * @brief Whether this build can write .mat files
+   */
+  static bool writesMatFiles();
+
+  /**
+   * @brief Allocate the queue and start writing a .mat file
+   *
+   * @param path The log file prefix. matlogger2 adds a time stamp and the .mat suffix.
+   * @param capacity The number of records the queue holds
+   * @param error Why starting failed
+   *
+   * @return True on success, false otherwise
+   */
+  bool start(const std::string & path, size_t capacity, std::string & error);
+
+  /**
+   * @brief Allocate the queue and start passing the records to \p sink
+   *
+   * @param sink Called in the writer thread, so it may allocate and block
+   * @param capacity The number of records the queue holds
+   * @param error Why starting failed
+   *
+   * @return True on success, false otherwise
+   */
+  bool start(const Sink & sink, size_t capacity, std::string & error);
+
+  /**
+   * @brief Write the remaining records and stop the writer thread
+   */
+  void stop();
+
+  /**
+   * @brief Queue one record for writing
+   *
+   * Doesn't block, allocate or print and is safe to call in the control loop.
+   *
+   * @return False if the record got dropped
+   */
+  bool push(const StiffnessRecord & record);
+
+  bool running() const { return m_running; }
+  size_t dropped() const { return m_dropped; }
+
+private:
+  bool startWriter(size_t capacity, std::string & error);
+  void run();
+
+  cartesian_controller_base::SpscQueue<StiffnessRecord> m_queue;
+  std::atomic<size_t> m_dropped;
+  std::atomic<bool> m_running;
+  Sink m_sink;
+  std::function<void()> m_flush;  // Optional, after each drained batch
+  std::thread m_thread;
+};
+
+}  // namespace cartesian_adaptive_compliance_controller
+
+#endif
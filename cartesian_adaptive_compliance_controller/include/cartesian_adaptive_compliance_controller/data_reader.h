@@ -3,8 +3,11 @@
 #include <vector>
 #include <sstream>
 
-void  dataReader( std::vector<double>& x_coordinates, std::vector<double>& y_coordinates, std::vector<std::vector<double>>& z_values, std::vector<std::vector<double>>& stiffness_values, std::vector<std::vector<double>>& damping_values){
-    std::string directory = "/home/robotics/ur3_ros2/matlab/data_body/";
+// The layers are stored row-major with one row per x coordinate
+inline void  dataReader( std::string directory, std::vector<double>& x_coordinates, std::vector<double>& y_coordinates, std::vector<double>& z_values, std::vector<double>& stiffness_values, std::vector<double>& damping_values){
+    if (!directory.empty() && directory.back() != '/') {
+        directory += '/';
+    }
     std::string x_filename = directory + "x.txt";
     std::string y_filename = directory + "y.txt";
     std::string z_filename = directory + "z.txt";
@@ -33,49 +36,34 @@ void  dataReader( std::vector<double>& x_coordinates, std::vector<double>& y_coo
 
     // Read z values from the third file and store them in a 2D vector
     std::ifstream z_file(z_filename);
-    z_values.resize(n, std::vector<double>(m));
+    z_values.resize(n * m);
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < m; ++j) {
-            z_file >> z_values[i][j];
-            z_values[i][j] += 0.0015;
+            z_file >> z_values[i * m + j];
+            z_values[i * m + j] += 0.0015;
         }
     }
     z_file.close();
 
     // Read stiffness values from the fourth file and store them in a 2D vector
     std::ifstream stiffness_file(stiffness_filename);
-    stiffness_values.resize(n, std::vector<double>(m));
+    stiffness_values.resize(n * m);
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < m; ++j) {
-            stiffness_file >> stiffness_values[i][j];
+            stiffness_file >> stiffness_values[i * m + j];
         }
     }
     stiffness_file.close();
 
     // Read damping values from the fifth file and store them in a 2D vector
     std::ifstream damping_file(damping_filename);
-    damping_values.resize(n, std::vector<double>(m));
+    damping_values.resize(n * m);
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < m; ++j) {
-            damping_file >> damping_values[i][j];
+            damping_file >> damping_values[i * m + j];
         }
     }
     damping_file.close();
 
     // Now you have x_coordinates, y_coordinates, z_values, stiffness_values, and damping_values
 }
-
-int findClosestIndex(const std::vector<double>& vec, double target) {
-    int index = 0;
-    double minDistance = std::abs(vec[0] - target);
-
-    for (long unsigned int i = 1; i < vec.size(); ++i) {
-        double distance = std::abs(vec[i] - target);
-        if (distance < minDistance) {
-            minDistance = distance;
-            index = i;
-        }
-    }
-
-    return index;
-}
\ No newline at end of file
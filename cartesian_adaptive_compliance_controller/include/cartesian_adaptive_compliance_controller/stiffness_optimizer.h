@@ -0,0 +1,153 @@
+#ifndef STIFFNESS_OPTIMIZER_H_INCLUDED
+#define STIFFNESS_OPTIMIZER_H_INCLUDED
+
+#include <cartesian_adaptive_compliance_controller/qpOASES.hpp>
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+#include <cartesian_controller_base/Utility.h>
+
+namespace cartesian_adaptive_compliance_controller
+{
+/**
+ * @brief The tunable parameters of the adaptive stiffness
+ */
+struct StiffnessParameters
+{
+  ctrl::Vector3D Q = {3200, 3200, 3200};           // Force tracking weight
+  ctrl::Vector3D R = {0.00001, 0.00001, 0.00001};  // Weight of the stiffness above kd_min
+  ctrl::Vector3D kd_min = {300, 300, 100};
+  ctrl::Vector3D kd_max = {1000, 1000, 1000};
+  ctrl::Vector3D F_max = {15, 15, 15};  // Symmetric force limits
+  double max_pen = 0.008;               // Penetration that defines the contact reference force
+  double power_limit = 0.1;             // Maximal power drawn from the tank
+  double tank_energy_threshold = 0.4;
+  bool explicit_qp = false;  // Use StiffnessQP instead of qpOASES
+};
+
+/**
+ * @brief The controller state a stiffness optimization starts from
+ */
+struct StiffnessState
+{
+  double time;    // seconds
+  double deltaT;  // Control cycle
+  ctrl::Vector3D x;
+  ctrl::Vector3D x_d;
+  ctrl::Vector3D x_dot;
+  ctrl::Vector3D damping;  // Translational damping diagonal
+  double ft_z;
+  double tank_energy;
+  double energy_var_damping;  // Damping power into the tank
+};
+
+/**
+ * @brief The result of one stiffness optimization
+ */
+struct StiffnessSolution
+{
+  ctrl::Vector3D kd;
+  bool success;  // False if the control loop should use the minimal stiffness
+  double F_ref;
+  double F_min;
+  SurfaceMap::Sample surface;
+  double surf_vel;  // Surface height change along the end-effector's path
+  qpOASES::returnValue qp_status;
+  qpOASES::int_t qp_nwsr;
+  qpOASES::real_t qp_cputime;
+  unsigned long qp_failures;
+};
+
+/**
+ * @brief Optimize the translational stiffness for force tracking within the tank limits
+ *
+ * Owns the QP, so each instance must only be used by one thread at a time.
+ * Doesn't depend on ROS, so that offline tools can replay recorded states
+ * through the same optimization as the controller.
+ */
+class StiffnessOptimizer
+{
+public:
+  StiffnessOptimizer();
+
+  /**
+   * @brief Start a new optimization sequence
+   *
+   * Solves a neutral QP to initialize the active set for hot-starting.
+   *
+   * @param parameters The stiffness parameters
+   * @param surface_map The surface to track. Must outlive the optimization sequence.
+   *
+   * @return False if the initial QP failed. The first solve then starts from scratch.
+   */
+  bool reset(const StiffnessParameters & parameters, const SurfaceMap * surface_map);
+
+  /**
+   * @brief Optimize the stiffness for the given state
+   *
+   * Falls back to the minimal stiffness if the tank is empty or the QP fails.
+   */
+  void solve(const StiffnessState & state, StiffnessSolution & solution);
+
+  const StiffnessParameters & parameters() const { return m_parameters; }
+
+private:
+  StiffnessParameters m_parameters;
+  const SurfaceMap * m_surface_map;
+
+  qpOASES::SQProblem m_qp;
+  bool m_qp_initialized;
+  const qpOASES::int_t m_qp_max_nwsr = 10;
+  const qpOASES::real_t m_qp_max_cputime = 0.0005;  // seconds
+  unsigned long m_qp_failures;
+};
+
+/**
+ * @brief The energy tank that keeps the stiffness variation passive
+ */
+class EnergyTank
+{
+public:
+  /**
+   * @brief The tank flow of one control cycle
+   */
+  struct Step
+  {
+    ctrl::Vector3D kd;       // The stiffness in use
+    double stiffness_power;  // Power of the stiffness above kd_min
+    double damping_power;
+    bool depleted;  // The tank was empty and refilled to its threshold
+  };
+
+  EnergyTank();
+
+  void reset(const StiffnessParameters & parameters, double energy = 0.5);
+
+  double energy() const { return m_energy; }
+
+  /**
+   * @brief The damping power that flows into the tank
+   *
+   * Zero once the tank is full.
+   */
+  double dampingPower(const ctrl::Vector3D & x_dot, const ctrl::Vector3D & damping) const;
+
+  /**
+   * @brief Integrate the tank over one control cycle
+   *
+   * Uses the solution's stiffness if it succeeded and the tank isn't empty,
+   * and the minimal stiffness otherwise.
+   *
+   * @param state The state of this cycle
+   * @param solution The newest optimization
+   * @param validate Also fall back to the minimal stiffness if the solution would violate
+   * the tank constraints for this state. Use for solutions of older states.
+   */
+  Step step(const StiffnessState & state, const StiffnessSolution & solution, bool validate);
+
+private:
+  StiffnessParameters m_parameters;
+  double m_energy;
+};
+
+}  // namespace cartesian_adaptive_compliance_controller
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef STIFFNESS_QP_H_INCLUDED
+#define STIFFNESS_QP_H_INCLUDED
+
+namespace cartesian_adaptive_compliance_controller
+{
+/**
+ * @brief Exact solver for the stiffness QP of the adaptive compliance controller
+ *
+ * Solves
+ *
+ *   min 1/2 k' H k + g' k  s.t.  lb <= k <= ub,  lbA <= A k <= ubA
+ *
+ * for three stiffnesses `k`, with a diagonal `H`, one force constraint per
+ * stiffness in the first three rows of `A`, and two tank constraints with
+ * identical coefficients in the last two rows.
+ * The arguments follow qpOASES' dense row-major convention, so that both
+ * can be used interchangeably.
+ *
+ * The force constraints merge into the box bounds. The tank constraints
+ * merge into one coupling constraint. Its multiplier is found exactly by
+ * walking the at most six points where the stiffnesses hit their bounds.
+ * The solver doesn't allocate and has a fixed worst-case run time.
+ */
+class StiffnessQP
+{
+public:
+  enum class Status
+  {
+    Success,
+    Infeasible,
+    Unsupported,  // The problem doesn't have the structure from above
+  };
+
+  static Status solve(const double * H, const double * g, const double * A, const double * lb,
+                      const double * ub, const double * lbA, const double * ubA, double * x);
+};
+
+}  // namespace cartesian_adaptive_compliance_controller
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef SURFACE_MAP_H_INCLUDED
+#define SURFACE_MAP_H_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cartesian_adaptive_compliance_controller
+{
+/**
+ * @brief A 2D grid of surface height, stiffness and damping
+ *
+ * Queries return bilinearly interpolated values and the height gradient.
+ * Uniformly spaced axes are indexed arithmetically, others with a binary
+ * search. Queries outside the grid hold the border values.
+ *
+ * The grid is stored as one contiguous array of \ref SurfaceMap::Cell
+ * records, so that each query touches a single cache line.
+ *
+ * Maps are either built from their axes and layers, or memory-mapped from a
+ * binary file. The binary format is a \ref SurfaceMap::FileHeader in native
+ * byte order, directly followed by
+ * - version 1: the z, stiffness and damping layers as contiguous float64
+ *   arrays, each row-major with one row per x coordinate.
+ * - version 2: the cell records, row-major with one row per x cell.
+ *
+ * Version 2 files are used in place. Version 1 files are converted on loading.
+ * Binary maps are always uniformly spaced.
+ */
+class SurfaceMap
+{
+public:
+  /**
+   * @brief The map values at one position
+   */
+  struct Sample
+  {
+    double z;
+    double stiffness;
+    double damping;
+    double dz_dx;
+    double dz_dy;
+  };
+
+  /**
+   * @brief The interpolation stencil of one grid cell
+   *
+   * Each quantity is stored as bilinear coefficients `c` in the normalized
+   * cell coordinates `tx, ty` in [0, 1], i.e. `c[0] + c[1] * tx + c[2] * ty + c[3] * tx * ty`.
+   * `c[1]` and `c[2]` are thereby the precomputed edge gradients.
+   * Stiffness and damping are single precision to fit the record into 64 bytes.
+   */
+  struct alignas(64) Cell
+  {
+    double z[4];
+    float stiffness[4];
+    float damping[4];
+  };
+
+  /**
+   * @brief The header of binary map files
+   */
+  struct FileHeader
+  {
+    char magic[8];  // "SURFMAP"
+    uint32_t version;
+    uint32_t layout;  // Number of layers (version 1) or size of a cell record (version 2)
+    uint64_t size_x;
+    uint64_t size_y;
+    double origin_x;
+    double spacing_x;
+    double origin_y;
+    double spacing_y;
+  };
+
+  static constexpr uint32_t file_version = 2;
+
+  SurfaceMap();
+
+  // The layer views must not outlive their storage
+  SurfaceMap(const SurfaceMap &) = delete;
+  SurfaceMap & operator=(const SurfaceMap &) = delete;
+  SurfaceMap(SurfaceMap &&) = default;
+  SurfaceMap & operator=(SurfaceMap &&) = default;
+
+  /**
+   * @brief Initialize the map from its axes and layers
+   *
+   * The layers are given with the x index as the slow and the y index as
+   * the fast running index, i.e. `z[i * y.size() + j]` belongs to `x[i]` and `y[j]`.
+   * Axes can be in ascending or descending order.
+   *
+   * @param x The grid coordinates along x
+   * @param y The grid coordinates along y
+   * @param z The surface height
+   * @param stiffness The surface stiffness
+   * @param damping The surface damping
+   * @param error Why initialization failed
+   *
+   * @return True on success, false otherwise
+   */
+  bool init(std::vector<double> x, std::vector<double> y, const std::vector<double> & z,
+            const std::vector<double> & stiffness, const std::vector<double> & damping,
+            std::string & error);
+
+  /**
+   * @brief Memory-map a binary map file
+   *
+   * The file is mapped read-only and prefaulted, so that later queries don't
+   * touch the disk. Prefaulting reads the whole file, so loading takes time
+   * proportional to the map size, but a version 2 file isn't parsed or copied.
+   *
+   * @param filename The binary map file
+   * @param error Why loading failed
+   *
+   * @return True on success, false otherwise
+   */
+  bool load(const std::string & filename, std::string & error);
+
+  /**
+   * @brief Write the map in the binary format
+   *
+   * @param filename The binary map file
+   * @param error Why writing failed, e.g. for non-uniform axes
+   *
+   * @return True on success, false otherwise
+   */
+  bool save(const std::string & filename, std::string & error) const;
+
+  /**
+   * @brief Interpolate the map at the given position
+   *
+   * Doesn't allocate and is safe to call in the control loop.
+   *
+   * @param x The query position along x
+   * @param y The query position along y
+   * @param sample The interpolated values
+   */
+  void sample(double x, double y, Sample & sample) const;
+
+  bool empty() const { return m_cells == nullptr; }
+  bool uniform() const { return m_x.uniform && m_y.uniform; }
+  size_t sizeX() const { return m_x.coordinates.size(); }
+  size_t sizeY() const { return m_y.coordinates.size(); }
+  const std::vector<double> & coordinatesX() const { return m_x.coordinates; }
+  const std::vector<double> & coordinatesY() const { return m_y.coordinates; }
+
+private:
+  struct Axis
+  {
+    std::vector<double> coordinates;
+    bool uniform = false;
+    double inv_spacing = 0.0;
+
+    /**
+     * @brief Find the grid cell and the normalized position inside it
+     *
+     * @return False if the position got clamped to the axis range
+     */
+    bool locate(double value, size_t & index, double & t) const;
+  };
+
+  static bool initAxis(std::vector<double> & coordinates, bool & reversed, Axis & axis,
+                       std::string & error);
+
+  /**
+   * @brief Build the cell records from row-major layers in ascending axis order
+   */
+  void buildCells(const double * z, const double * stiffness, const double * damping);
+
+  size_t cellsX() const { return sizeX() > 1 ? sizeX() - 1 : 1; }
+  size_t cellsY() const { return sizeY() > 1 ? sizeY() - 1 : 1; }
+
+  Axis m_x;
+  Axis m_y;
+
+  // View on the cells in either m_storage or m_mapping
+  const Cell * m_cells;
+
+  std::vector<Cell> m_storage;
+  std::shared_ptr<const void> m_mapping;
+};
+
+}  // namespace cartesian_adaptive_compliance_controller
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Compare the explicit StiffnessQP solver against qpOASES on randomized
+ * problems with the structure of the adaptive compliance controller, and
+ * measure the run time of both.
+ *
+ * Usage: benchmark_stiffness_qp [number of problems] [seed]
+ *
+ * Returns non-zero if the solvers disagree.
+ */
+
+#include <cartesian_adaptive_compliance_controller/qpOASES.hpp>
+#include <cartesian_adaptive_compliance_controller/stiffness_qp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using cartesian_adaptive_compliance_controller::StiffnessQP;
+
+namespace
+{
+struct Problem
+{
+  double H[9];
+  double g[3];
+  double A[15];
+  double lb[3];
+  double ub[3];
+  double lbA[5];
+  double ubA[5];
+};
+
+// Mimics CartesianAdaptiveComplianceController::computeStiffness
+Problem randomProblem(std::mt19937 & rng)
+{
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  auto uniform = [&](double a, double b) { return a + (b - a) * unit(rng); };
+
+  const double Q = 3200;
+  const double R = 0.00001;
+  const double kd_min[3] = {300, 300, 100};
+  const double kd_max[3] = {1000, 1000, 1000};
+  const double F_max = 15;
+  const double delta_t = 0.002;
+  const double power_limit = 0.1;
+  const double threshold = 0.4;
+
+  double e[3], v[3], d[3], F_ref[3] = {0, 0, 0};
+  for (int i = 0; i < 3; ++i)
+  {
+    e[i] = uniform(-0.01, 0.01);
+    v[i] = uniform(-0.05, 0.05);
+    d[i] = 2.0 * 0.707 * std::sqrt(uniform(kd_min[i], kd_max[i]));
+  }
+  const bool contact = unit(rng) < 0.5;
+  F_ref[2] = contact ? uniform(-12, 0) : 0.0;
+  const double F_min_z = contact ? -9 : -F_max;
+  // Near the threshold, the tank constraints become active.
+  // Below, they are often infeasible.
+  const double mode = unit(rng);
+  const double tank = mode < 0.4   ? uniform(threshold, 1.2)
+                      : mode < 0.8 ? threshold + uniform(0, 1e-5)
+                                   : threshold - uniform(0, 0.01);
+  const double sigma = tank >= 1.0 ? 0.0 : 1.0;
+
+  double damping_power = 0.0;
+  double min_stiffness_power = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    damping_power += sigma * d[i] * v[i] * v[i];
+    min_stiffness_power += e[i] * kd_min[i] * v[i];
+  }
+
+  Problem p = {};
+  for (int i = 0; i < 3; ++i)
+  {
+    p.H[i * 3 + i] = R + Q * e[i] * e[i];
+    p.g[i] = -kd_min[i] * R + (-F_ref[i] + d[i] * v[i]) * e[i] * Q;
+    p.lb[i] = kd_min[i];
+    p.ub[i] = kd_max[i];
+    p.A[i * 3 + i] = e[i];
+    p.A[9 + i] = e[i] * v[i];
+    p.A[12 + i] = e[i] * v[i];
+    p.lbA[i] = (i == 2 ? F_min_z : -F_max) - d[i] * v[i];
+    p.ubA[i] = F_max - d[i] * v[i];
+  }
+  p.lbA[3] = -damping_power + min_stiffness_power + (threshold - tank) / delta_t;
+  p.lbA[4] = -damping_power + min_stiffness_power - power_limit;
+  p.ubA[3] = 1e9;
+  p.ubA[4] = 1e9;
+  return p;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  USING_NAMESPACE_QPOASES
+
+  const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+  const unsigned seed = argc > 2 ? std::atoi(argv[2]) : 42;
+
+  std::mt19937 rng(seed);
+  std::vector<Problem> problems(count);
+  for (auto & p : problems)
+  {
+    p = randomProblem(rng);
+  }
+
+  Options options;
+  options.printLevel = PL_NONE;
+
+  std::vector<double> x_explicit(3 * count);
+  std::vector<double> x_qpoases(3 * count);
+  std::vector<StiffnessQP::Status> explicit_status(count);
+  std::vector<bool> qpoases_success(count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int k = 0; k < count; ++k)
+  {
+    const Problem & p = problems[k];
+    explicit_status[k] =
+      StiffnessQP::solve(p.H, p.g, p.A, p.lb, p.ub, p.lbA, p.ubA, &x_explicit[3 * k]);
+  }
+  const double explicit_time =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  QProblem qp(3, 5);
+  qp.setOptions(options);
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < count; ++k)
+  {
+    const Problem & p = problems[k];
+    int_t nWSR = 100;
+    qp.reset();
+    qpoases_success[k] =
+      qp.init(p.H, p.g, p.A, p.lb, p.ub, p.lbA, p.ubA, nWSR) == SUCCESSFUL_RETURN;
+    qp.getPrimalSolution(&x_qpoases[3 * k]);
+  }
+  const double qpoases_time =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Compare
+  int mismatches = 0;
+  int infeasible = 0;
+  int qpoases_failures = 0;
+  int tank_active = 0;
+  int explicit_only = 0;
+  double max_deviation = 0.0;
+  for (int k = 0; k < count; ++k)
+  {
+    const bool explicit_success = explicit_status[k] == StiffnessQP::Status::Success;
+    infeasible += explicit_status[k] == StiffnessQP::Status::Infeasible;
+    if (explicit_success)
+    {
+      const Problem & p = problems[k];
+      double power = 0.0;
+      for (int i = 0; i < 3; ++i)
+      {
+        power += p.A[9 + i] * x_explicit[3 * k + i];
+      }
+      const double bound = std::max(p.lbA[3], p.lbA[4]);
+      tank_active += std::abs(power - bound) <= 1e-9 * (1.0 + std::abs(bound));
+    }
+    if (!qpoases_success[k])
+    {
+      // Not a mismatch if qpOASES failed for numerical reasons on a feasible problem
+      qpoases_failures++;
+      explicit_only += explicit_success;
+      continue;
+    }
+    if (!explicit_success)
+    {
+      mismatches++;
+      continue;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      const double deviation = std::abs(x_explicit[3 * k + i] - x_qpoases[3 * k + i]);
+      max_deviation = std::max(max_deviation, deviation);
+      if (deviation > 1e-6 * std::max(1.0, std::abs(x_qpoases[3 * k + i])))
+      {
+        mismatches++;
+        break;
+      }
+    }
+  }
+
+  std::cout << "Problems:             " << count << std::endl;
+  std::cout << "Infeasible:           " << infeasible << std::endl;
+  std::cout << "Tank active:          " << tank_active << std::endl;
+  std::cout << "qpOASES failures:     " << qpoases_failures << " (" << explicit_only
+            << " solved by the explicit solver)" << std::endl;
+  std::cout << "Mismatches:           " << mismatches << std::endl;
+  std::cout << "Max deviation:        " << max_deviation << std::endl;
+  std::cout << "Explicit [us/solve]:  " << 1e6 * explicit_time / count << std::endl;
+  std::cout << "qpOASES [us/solve]:   " << 1e6 * qpoases_time / count << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
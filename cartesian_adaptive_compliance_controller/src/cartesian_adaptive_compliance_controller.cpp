@@ -1,5 +1,8 @@
 #include <cartesian_adaptive_compliance_controller/cartesian_adaptive_compliance_controller.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <iostream>
 
 #include "cartesian_controller_base/Utility.h"
@@ -18,6 +21,11 @@ CartesianAdaptiveComplianceController::CartesianAdaptiveComplianceController()
 {
 }
 
+CartesianAdaptiveComplianceController::~CartesianAdaptiveComplianceController()
+{
+  stopStiffnessWorker();
+}
+
 #if defined CARTESIAN_CONTROLLERS_GALACTIC || defined CARTESIAN_CONTROLLERS_HUMBLE || true
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 CartesianAdaptiveComplianceController::on_init()
@@ -29,6 +37,29 @@ CartesianAdaptiveComplianceController::on_init()
   }
 
   auto_declare<std::string>("compliance_ref_link", "");
+  auto_declare<std::string>("surface_map.format", "text");
+  auto_declare<std::string>("surface_map.path", "");
+  auto_declare<std::string>("qp_solver", "qpoases");
+  auto_declare<bool>("data_log.enabled", true);
+  auto_declare<std::string>("data_log.path", "/tmp/adaptive_compliance");
+  auto_declare<int>("data_log.capacity", 4096);
+  auto_declare<int>("data_log.publish_decimation", 0);
+  auto_declare<double>("stiffness_optimization.rate", 0.0);
+
+  const StiffnessParameters stiffness_defaults;
+  auto vector = [](const ctrl::Vector3D & v) { return std::vector<double>{v(0), v(1), v(2)}; };
+  auto_declare<std::vector<double>>("stiffness_optimization.Q", vector(stiffness_defaults.Q));
+  auto_declare<std::vector<double>>("stiffness_optimization.R", vector(stiffness_defaults.R));
+  auto_declare<std::vector<double>>("stiffness_optimization.kd_min",
+                                    vector(stiffness_defaults.kd_min));
+  auto_declare<std::vector<double>>("stiffness_optimization.kd_max",
+                                    vector(stiffness_defaults.kd_max));
+  auto_declare<std::vector<double>>("stiffness_optimization.F_max",
+                                    vector(stiffness_defaults.F_max));
+  auto_declare<double>("stiffness_optimization.max_pen", stiffness_defaults.max_pen);
+  auto_declare<double>("stiffness_optimization.power_limit", stiffness_defaults.power_limit);
+  auto_declare<double>("stiffness_optimization.tank_threshold",
+                       stiffness_defaults.tank_energy_threshold);
 
   constexpr double default_lin_stiff = 500.0;
   constexpr double default_rot_stiff = 50.0;
@@ -52,6 +83,34 @@ controller_interface::return_type CartesianAdaptiveComplianceController::init(
   }
 
   auto_declare<std::string>("compliance_ref_link", "");
+  auto_declare<std::string>("surface_map.format", "text");
+  auto_declare<std::string>("surface_map.path", "");
+  auto_declare<std::string>("qp_solver", "qpoases");
+  auto_declare<bool>("data_log.enabled", true);
+  auto_declare<std::string>("data_log.path", "/tmp/adaptive_compliance");
+  auto_declare<int>("data_log.capacity", 4096);
+  auto_declare<int>("data_log.publish_decimation", 0);
+  auto_declare<double>("stiffness_optimization.rate", 0.0);
+
+  const StiffnessParameters stiffness_defaults;
+  auto vector = [](const ctrl::Vector3D & v) { return std::vector<double>{v(0), v(1), v(2)}; };
+  auto_declare<std::vector<double>>("stiffness_optimization.Q", vector(stiffness_defaults.Q));
+  auto_declare<std::vector<double>>("stiffness_optimization.R", vector(stiffness_defaults.R));
+  auto_declare<std::vector<double>>("stiffness_optimization.kd_min",
+                                    vector(stiffness_defaults.kd_min));
+  auto_declare<std::vector<double>>("stiffness_optimization.kd_max",
+                                    vector(stiffness_defaults.kd_max));
+  auto_declare<std::vector<double>>("stiffness_optimization.F_max",
+                                    vector(stiffness_defaults.F_max));
+  auto_declare<double>("stiffness_optimization.max_pen", stiffness_defaults.max_pen);
+  auto_declare<double>("stiffness_optimization.power_limit", stiffness_defaults.power_limit);
+  auto_declare<double>("stiffness_optimization.tank_threshold",
+                       stiffness_defaults.tank_energy_threshold);
+
+  constexpr double default_rot_stiff = 50.0;
+  auto_declare<double>("stiffness.rot_x", default_rot_stiff);
+  auto_declare<double>("stiffness.rot_y", default_rot_stiff);
+  auto_declare<double>("stiffness.rot_z", default_rot_stiff);
 
   return TYPE::OK;
 }
@@ -81,12 +140,96 @@ CartesianAdaptiveComplianceController::on_configure(const rclcpp_lifecycle::Stat
   // Make sure sensor wrenches are interpreted correctly
   ForceBase::setFtSensorReferenceFrame(m_compliance_ref_link);
 
-  m_fk_solver.reset(new KDL::ChainFkSolverVel_recursive(Base::m_robot_chain));
-  old_z = 0.098;
-  // Read data from files
-  dataReader(m_x_coordinates, m_y_coordinates, m_z_values, m_stiffness_values, m_damping_values);
-  cout << m_x_coordinates.size() << " " << m_y_coordinates.size() << " " << m_z_values.size() << " "
-       << m_stiffness_values.size() << " " << m_damping_values.size() << endl;
+  // Load the surface map.
+  // Binary maps are memory-mapped. Text maps are parsed value by value.
+  const std::string map_format = get_node()->get_parameter("surface_map.format").as_string();
+  const std::string map_path = get_node()->get_parameter("surface_map.path").as_string();
+  if (map_path.empty())
+  {
+    RCLCPP_ERROR(get_node()->get_logger(),
+                 "No surface map. Set surface_map.path to a text map's directory or a binary map");
+    return TYPE::ERROR;
+  }
+  std::string error;
+  if (map_format == "binary")
+  {
+    if (!m_surface_map.load(map_path, error))
+    {
+      RCLCPP_ERROR_STREAM(get_node()->get_logger(), "Invalid surface map: " << error);
+      return TYPE::ERROR;
+    }
+  }
+  else if (map_format == "text")
+  {
+    std::vector<double> x_coordinates, y_coordinates, z_values, stiffness_values, damping_values;
+    dataReader(map_path, x_coordinates, y_coordinates, z_values, stiffness_values,
+               damping_values);
+    if (!m_surface_map.init(x_coordinates, y_coordinates, z_values, stiffness_values,
+                            damping_values, error))
+    {
+      RCLCPP_ERROR_STREAM(get_node()->get_logger(), "Invalid surface map: " << error);
+      return TYPE::ERROR;
+    }
+  }
+  else
+  {
+    RCLCPP_ERROR_STREAM(get_node()->get_logger(), "Unknown surface_map.format: "
+                                                    << map_format << ". Choose text or binary");
+    return TYPE::ERROR;
+  }
+  RCLCPP_INFO(get_node()->get_logger(), "Loaded a %zux%zu surface map from %s",
+              m_surface_map.sizeX(), m_surface_map.sizeY(), map_path.c_str());
+
+  // Choose the stiffness QP backend
+  const std::string qp_solver = get_node()->get_parameter("qp_solver").as_string();
+  if (qp_solver != "qpoases" && qp_solver != "explicit")
+  {
+    RCLCPP_ERROR_STREAM(get_node()->get_logger(),
+                        "Unknown qp_solver: " << qp_solver << ". Choose qpoases or explicit");
+    return TYPE::ERROR;
+  }
+  m_stiffness_parameters.explicit_qp = qp_solver == "explicit";
+
+  // The stiffness parameters, e.g. as found by the tune_adaptive_compliance tool
+  auto vector_param = [this](const std::string & name, ctrl::Vector3D & value)
+  {
+    const std::vector<double> v = get_node()->get_parameter(name).as_double_array();
+    if (v.size() != 3)
+    {
+      RCLCPP_ERROR_STREAM(get_node()->get_logger(), name << " needs 3 values, got " << v.size());
+      return false;
+    }
+    value << v[0], v[1], v[2];
+    return true;
+  };
+  if (!vector_param("stiffness_optimization.Q", m_stiffness_parameters.Q) ||
+      !vector_param("stiffness_optimization.R", m_stiffness_parameters.R) ||
+      !vector_param("stiffness_optimization.kd_min", m_stiffness_parameters.kd_min) ||
+      !vector_param("stiffness_optimization.kd_max", m_stiffness_parameters.kd_max) ||
+      !vector_param("stiffness_optimization.F_max", m_stiffness_parameters.F_max))
+  {
+    return TYPE::ERROR;
+  }
+  m_stiffness_parameters.max_pen =
+    get_node()->get_parameter("stiffness_optimization.max_pen").as_double();
+  m_stiffness_parameters.power_limit =
+    get_node()->get_parameter("stiffness_optimization.power_limit").as_double();
+  m_stiffness_parameters.tank_energy_threshold =
+    get_node()->get_parameter("stiffness_optimization.tank_threshold").as_double();
+  if ((m_stiffness_parameters.kd_min.array() > m_stiffness_parameters.kd_max.array()).any())
+  {
+    RCLCPP_ERROR(get_node()->get_logger(),
+                 "stiffness_optimization.kd_min must not exceed stiffness_optimization.kd_max");
+    return TYPE::ERROR;
+  }
+
+  // Initial rotational stiffness. Later changes are handled in the callback.
+  if (parametersCallback({}).successful == false)
+  {
+    return TYPE::ERROR;
+  }
+  m_parameters_callback = get_node()->add_on_set_parameters_callback(std::bind(
+    &CartesianAdaptiveComplianceController::parametersCallback, this, std::placeholders::_1));
   return TYPE::SUCCESS;
 }
 
@@ -108,12 +251,17 @@ CartesianAdaptiveComplianceController::on_activate(const rclcpp_lifecycle::State
       std::bind(&CartesianAdaptiveComplianceController::ftSensorWrenchCallback, this,
                 std::placeholders::_1));
   // Publisher
-  m_data_publisher = get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
-    std::string("/adaptive_stiffness_data"), 10);
-
   m_target_pose_publisher = get_node()->create_publisher<geometry_msgs::msg::PoseStamped>(
     get_node()->get_name() + std::string("/target_frame"), 10);
 
+  // The translational stiffness is optimized online. Schedules apply to the
+  // rotational part.
+  m_impedance_schedule_subscriber =
+    get_node()->create_subscription<std_msgs::msg::Float64MultiArray>(
+      get_node()->get_name() + std::string("/impedance_schedule"), 3,
+      std::bind(&CartesianAdaptiveComplianceController::impedanceScheduleCallback, this,
+                std::placeholders::_1));
+
   m_starting_pose(0) = MotionBase::m_current_frame.p.x();
   m_starting_pose(1) = MotionBase::m_current_frame.p.y();
   m_starting_pose(2) = MotionBase::m_current_frame.p.z();
@@ -121,26 +269,93 @@ CartesianAdaptiveComplianceController::on_activate(const rclcpp_lifecycle::State
        << m_starting_pose(2) << endl;
 
   old_time = current_time = start_time = get_node()->get_clock()->now();
-  Xt = 1.0;
-  dXt = 0.0;
-  tank_energy = 0.5 * Xt * Xt;
-  tank_energy_threshold = 0.4;
+  m_tank.reset(m_stiffness_parameters);
 
-  USING_NAMESPACE_QPOASES
-  Options options;
-  options.printLevel = PL_LOW;
-  // redeclare solver with options
-  min_problem = QProblem(3, 5);
+  // Each cycle hot-starts the stiffness QP from the previous active set
+  if (!m_stiffness_optimizer.reset(m_stiffness_parameters, &m_surface_map))
+  {
+    RCLCPP_WARN(get_node()->get_logger(),
+                "Initial stiffness QP failed. The first cycle will start from scratch.");
+  }
 
   m_ft_sensor_wrench = ctrl::Vector3D::Zero();
 
   x_d_old << m_starting_pose(0), m_starting_pose(1), m_starting_pose(2);
   m_prev_error = ctrl::Vector6D::Zero();
-  for (size_t i = 0; i < 10; i++)
+
+  // Start with the minimal stiffness until the first optimization finishes
+  m_stiffness_solution = StiffnessSolution();
+  m_stiffness_solution.kd = m_stiffness_parameters.kd_min;
+  m_stiffness_solution.success = false;
+
+  // Optionally move the optimization out of the control loop
+  const double stiffness_rate =
+    get_node()->get_parameter("stiffness_optimization.rate").as_double();
+  m_async_stiffness = stiffness_rate > 0.0;
+  if (m_async_stiffness)
+  {
+    m_stiffness_state_buffer.reset();
+    m_stiffness_solution_buffer.reset();
+    m_stiffness_worker_running = true;
+    m_stiffness_worker = std::thread(&CartesianAdaptiveComplianceController::stiffnessWorker,
+                                     this, stiffness_rate);
+  }
+
+  // Structured logging without I/O in the control loop
+  if (get_node()->get_parameter("data_log.enabled").as_bool())
   {
-    m_surf_vel.push(0.0);
+    std::string error;
+    const int capacity = get_node()->get_parameter("data_log.capacity").as_int();
+    bool started = false;
+    if (DataLogger::writesMatFiles())
+    {
+      started = m_data_logger.start(get_node()->get_parameter("data_log.path").as_string(),
+                                    static_cast<size_t>(std::max(capacity, 0)), error);
+    }
+    else if (get_node()->get_parameter("data_log.publish_decimation").as_int() > 0)
+    {
+      // Without matlogger2, publish every n-th record on request.
+      // Same column order as StiffnessRecord::columns
+      const int decimation = get_node()->get_parameter("data_log.publish_decimation").as_int();
+      m_data_publisher = get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
+        std::string("/adaptive_stiffness_data"), 10);
+      auto publisher = m_data_publisher;
+      int count = 0;
+      started = m_data_logger.start(
+        [publisher, decimation, count](const StiffnessRecord & record) mutable {
+          if (++count < decimation)
+          {
+            return;
+          }
+          count = 0;
+          std_msgs::msg::Float64MultiArray msg;
+          msg.data.reserve(StiffnessRecord::columns.size());
+          for (const auto & column : StiffnessRecord::columns)
+          {
+            msg.data.push_back(record.*column.second);
+          }
+          publisher->publish(msg);
+        },
+        static_cast<size_t>(std::max(capacity, 0)), error);
+      if (started)
+      {
+        RCLCPP_INFO(get_node()->get_logger(),
+                    "Built without matlogger2. Publishing one in %d records of the data log on "
+                    "/adaptive_stiffness_data",
+                    decimation);
+      }
+    }
+    else
+    {
+      RCLCPP_INFO(get_node()->get_logger(),
+                  "Built without matlogger2. Set data_log.publish_decimation to publish the data "
+                  "log on /adaptive_stiffness_data");
+    }
+    if (!started && !error.empty())
+    {
+      RCLCPP_WARN(get_node()->get_logger(), "Data logging disabled: %s", error.c_str());
+    }
   }
-  m_surf_vel_sum = 0.0;
 
   return TYPE::SUCCESS;
 }
@@ -154,6 +369,15 @@ CartesianAdaptiveComplianceController::on_deactivate(const rclcpp_lifecycle::Sta
   {
     return TYPE::ERROR;
   }
+
+  stopStiffnessWorker();
+
+  if (m_data_logger.running())
+  {
+    m_data_logger.stop();
+    RCLCPP_INFO(get_node()->get_logger(), "Data logging stopped (%zu records dropped)",
+                m_data_logger.dropped());
+  }
   return TYPE::SUCCESS;
 }
 
@@ -172,14 +396,29 @@ controller_interface::return_type CartesianAdaptiveComplianceController::update(
   }
   // Synchronize the internal model and the real robot
   Base::m_ik_solver->synchronizeJointPositions(Base::m_joint_state_pos_handles);
+  Base::updateMeasuredState();
 
-  ctrl::Vector6D tmp = CartesianAdaptiveComplianceController::computeStiffness();
-  tmp[3] = get_node()->get_parameter("stiffness.rot_x").as_double();
-  tmp[4] = get_node()->get_parameter("stiffness.rot_y").as_double();
-  tmp[5] = get_node()->get_parameter("stiffness.rot_z").as_double();
+  const ctrl::Vector3D translational = CartesianAdaptiveComplianceController::computeStiffness();
 
-  m_stiffness = tmp.asDiagonal();
-  m_damping = 2.0 * 0.707 * m_stiffness.cwiseSqrt();
+  ctrl::Matrix6D scheduled_stiffness;
+  ctrl::Matrix6D scheduled_damping;
+  if (m_impedance_schedule.sample(current_time, scheduled_stiffness, scheduled_damping))
+  {
+    m_stiffness.setZero();
+    m_damping.setZero();
+    m_stiffness.topLeftCorner<3, 3>() = translational.asDiagonal();
+    m_damping.topLeftCorner<3, 3>() = 2.0 * 0.707 * translational.cwiseSqrt().asDiagonal();
+    m_stiffness.bottomRightCorner<3, 3>() = scheduled_stiffness.bottomRightCorner<3, 3>();
+    m_damping.bottomRightCorner<3, 3>() = scheduled_damping.bottomRightCorner<3, 3>();
+  }
+  else
+  {
+    ctrl::Vector6D diagonal;
+    diagonal << translational, *m_rot_stiffness_buffer.readFromRT();
+
+    m_stiffness = diagonal.asDiagonal();
+    m_damping = 2.0 * 0.707 * m_stiffness.cwiseSqrt();
+  }
 
   // Control the robot motion in such a way that the resulting net force
   // vanishes. This internal control needs some simulation time steps.
@@ -249,6 +488,61 @@ ctrl::Vector6D CartesianAdaptiveComplianceController::computeComplianceError()
   return net_force;
 }
 
+rcl_interfaces::msg::SetParametersResult CartesianAdaptiveComplianceController::parametersCallback(
+  const std::vector<rclcpp::Parameter> & parameters)
+{
+  rcl_interfaces::msg::SetParametersResult result;
+  result.successful = true;
+
+  // Parameters are not yet set when this callback is called.
+  // Combine the current ones with those about to change.
+  const std::array<std::string, 3> names = {"stiffness.rot_x", "stiffness.rot_y",
+                                            "stiffness.rot_z"};
+  ctrl::Vector3D rot_stiffness;
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    rot_stiffness[i] = get_node()->get_parameter(names[i]).as_double();
+  }
+
+  bool relevant = parameters.empty();
+  for (const auto & parameter : parameters)
+  {
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+      if (parameter.get_name() == names[i])
+      {
+        rot_stiffness[i] = parameter.as_double();
+        relevant = true;
+      }
+    }
+  }
+
+  if (!relevant)
+  {
+    return result;
+  }
+  if ((rot_stiffness.array() < 0.0).any())
+  {
+    result.successful = false;
+    result.reason = "The rotational stiffness must not be negative";
+    RCLCPP_ERROR(get_node()->get_logger(), "Rejecting stiffness: %s", result.reason.c_str());
+    return result;
+  }
+  m_rot_stiffness_buffer.writeFromNonRT(rot_stiffness);
+  return result;
+}
+
+void CartesianAdaptiveComplianceController::impedanceScheduleCallback(
+  const std_msgs::msg::Float64MultiArray::SharedPtr schedule)
+{
+  std::string error;
+  if (!m_impedance_schedule.set(*schedule, error))
+  {
+    RCLCPP_WARN_STREAM(get_node()->get_logger(),
+                       "Invalid impedance schedule: " << error << ". Ignoring input.");
+  }
+}
+
 void CartesianAdaptiveComplianceController::ftSensorWrenchCallback(
   const geometry_msgs::msg::WrenchStamped::SharedPtr wrench)
 {
@@ -262,378 +556,160 @@ void CartesianAdaptiveComplianceController::ftSensorWrenchCallback(
   m_ft_sensor_wrench(2) = tmp[2];
 }
 
-ctrl::Vector6D CartesianAdaptiveComplianceController::computeStiffness()
+ctrl::Vector3D CartesianAdaptiveComplianceController::computeStiffness()
 {
-  USING_NAMESPACE_QPOASES
   getEndEffectorPoseReal();
 
   rclcpp::Duration deltaT_ros = current_time - old_time;
-
-  double max_pen = 0.008;
-  double power_limit = 0.1;
-
   m_deltaT = deltaT_ros.nanoseconds() * 1e-9;
-  // retrieve target position
-  ctrl::Vector3D x;
-  x(0) = m_x(0);
-  x(1) = m_x(1);
-  x(2) = m_x(2);
-
-  // retrieve current position
-  ctrl::Vector3D x_d;
-  x_d(0) = MotionBase::m_target_frame.p.x();
-  x_d(1) = MotionBase::m_target_frame.p.y();
-  x_d(2) = MotionBase::m_target_frame.p.z();
-
-  // retrieve current velocity
-  ctrl::Vector3D velocity_error;
-  velocity_error << -m_x_dot(0), -m_x_dot(1), -m_x_dot(2);
-
-  // Get the position of the data corresponding to the current position
-  int x_index = findClosestIndex(m_x_coordinates, x(0));
-  int y_index = findClosestIndex(m_y_coordinates, x(1));
-
-  // Get the z, stiffness and damping values corresponding to the current position
-  double z_value = m_z_values[x_index][y_index];
-  double stiffness_value = m_stiffness_values[x_index][y_index];
-  double damping_value = m_damping_values[x_index][y_index];
-
-  m_surf_vel_sum -= m_surf_vel.front();
-  m_surf_vel.pop();
-  double sv = (z_value - old_z) / m_deltaT;
-  m_surf_vel.push(sv);
-  m_surf_vel_sum += sv;
-  old_z = z_value;
-
-  // mean of the last 5 values
-  double surf_vel = m_surf_vel_sum / m_surf_vel.size();
-
-  // retrieve current velocity
-  ctrl::Vector6D xdot = Base::m_ik_solver->getEndEffectorVel();
-
-  // // retrieve material stiffness
-  // ctrl::Vector3D kl = {kl_, kl_, kl_};
-
-  // // define material steady-state position
-  // ctrl::Vector3D sl = {0.0, 0.0, 0.12};
-  // // define material current position
-  // ctrl::Vector3D l = {0.0, 0.0, 0.12};
-
-  // // retrieve material damping
-  // ctrl::Vector3D dl = {dl_, dl_, dl_};
-
-  // F_ref
-  ctrl::Vector3D F_ref = {0.0, 0.0, 0.0};
-
-  // if (x(2) < z_value + 0.0025)
-  if (m_ft_sensor_wrench(2) < -0.5)
-  {
-    // penetrating material
-    // l(2) = x(2);
-    // kl = {kl_, kl_, kl_};
-    // dl = {dl_, dl_, dl_};
-    // F_ref(2) = -( stiffness_value * pow((z_value + 0.0025 - x(2)),1.35) - damping_value * pow((z_value + 0.0025 - x(2)),1.35) * (m_x_dot(2)-surf_vel) );
-    // F_min(2) = -( stiffness_value * pow(max_pen,1.35) - damping_value * pow(max_pen,1.35) * (m_x_dot(2)-surf_vel) );
-    // F_ref(2) = -9;
-    // F_min(2) = -( stiffness_value * pow(max_pen,1.35) - damping_value * pow(max_pen,1.35) * (m_x_dot(2)-surf_vel) );
-    F_ref(2) = -(stiffness_value * pow(max_pen, 1.35) -
-                 damping_value * pow(max_pen, 1.35) * (m_x_dot(2) - surf_vel));
-    F_min(2) = -9;
-  }
-  else
-  {
-    // free motion
-    // l(2) = sl(2);
-    // kl = {kl_, kl_, kl_};
-    // dl = {dl_, dl_, dl_};
-    F_ref(2) = 0.0;
-    F_min(2) = -F_max(2);
-  }
 
-  if (tank_energy >= 1.0)
+  StiffnessState state;
+  state.time = current_time.nanoseconds() * 1e-9;
+  state.deltaT = m_deltaT;
+  state.x = m_x;
+  state.x_d << MotionBase::m_target_frame.p.x(), MotionBase::m_target_frame.p.y(),
+    MotionBase::m_target_frame.p.z();
+  state.x_dot = m_x_dot;
+  state.damping = m_damping.diagonal().head<3>();
+  state.ft_z = m_ft_sensor_wrench(2);
+  state.tank_energy = m_tank.energy();
+  state.energy_var_damping = m_tank.dampingPower(m_x_dot, state.damping);
+
+  if (m_async_stiffness)
   {
-    m_sigma = 0.0;
+    // Hand over the state and use the newest stiffness the worker found
+    m_stiffness_state_buffer.write(state);
+    m_stiffness_solution_buffer.read(m_stiffness_solution);
   }
   else
   {
-    m_sigma = 1.0;
+    solveStiffness(state, m_stiffness_solution);
   }
 
-  ctrl::Vector3D position_error;
-  position_error = x_d - x;
-
-  // Update energy
+  // The tank is always integrated here with the stiffness in use.
+  // An asynchronous solution is for an older state and must still satisfy
+  // the tank constraints now.
+  m_tank_step = m_tank.step(state, m_stiffness_solution, m_async_stiffness);
+  kd = m_tank_step.kd;
 
-  real_t H[3 * 3] = {R(0) + Q(0) * pow(position_error(0), 2), 0, 0, 0,
-                     R(1) + Q(1) * pow(position_error(1), 2), 0, 0, 0,
-                     R(2) + Q(2) * pow(position_error(2), 2)};
+  logStiffnessData(state, m_stiffness_solution);
+  return kd;
+}
 
-  // -Kmin1 R1 - Fdx Q1 x1 + kd1 (R1 + Q1 x1^2)
-  real_t g[3] = {
-    -kd_min(0) * R(0) + (-F_ref(0) + m_damping(0, 0) * velocity_error(0)) * position_error(0) *
-                          Q(0),  // + kd(0) * (R(0) + Q(0) * pow(x_d(0) - x(0),2)),
-    -kd_min(1) * R(1) + (-F_ref(1) + m_damping(1, 1) * velocity_error(1)) * position_error(1) *
-                          Q(1),  // + kd(1) * (R(1) + Q(1) * pow(x_d(1) - x(1),2)),
-    -kd_min(2) * R(2) + (-F_ref(2) + m_damping(2, 2) * velocity_error(2)) * position_error(2) *
-                          Q(2)  // + kd(2) * (R(2) + Q(2) * pow(x_d(2) - x(2),2))
-  };
-  // (R(0) + Q(0) * pow(x_d(0) - x(0), 2)),
-  // (R(1) + Q(1) * pow(x_d(1) - x(1), 2)),
-  // (R(2) + Q(2) * pow(x_d(2) - x(2), 2))
-
-  // Constraints on  K2
-  real_t lb[3] = {kd_min(0), kd_min(1), kd_min(2)};
-  real_t ub[3] = {kd_max(0), kd_max(1), kd_max(2)};
-
-  // Tank equation
-  //  T =
-  //  Xt^2/2 + x_tilde_x*x_tilde_dot_x*(kd_x - kd_x_min) + x_tilde_y*x_tilde_dot_y*(kd_y - kd_y_min) + x_tilde_z*x_tilde_dot_z*(kd_z - kd_z_min)
-
-  // extract x depent on Kd from T -> this goes in A as {x(0) * xdot(0) , x(1) * xdot(1) , x(2) * xdot(2)}
-  // real_t tank_A = x(0) * xdot(0) + x(1) * xdot(1) + x(2) * xdot(2);
-
-  // Constraint equation is:
-  // A * x = b + epsilon -> I need to compute b + epsilon
-
-  // Rewriting it as tank_A * Kd will left out the following term which must be sum in the left part of the equation (so I changed sign)
-  // should be  = - Xt^2/2 + kd_x_min*x_tilde_x*x_tilde_dot_x + kd_y_min*x_tilde_y*x_tilde_dot_y + kd_z_min*x_tilde_z*x_tilde_dot_z + epsilon
-
-  // Xt^2/2 is for the first step -> then became the old tank value
-
-  real_t T_constr_min, T_dot_min;
-
-  energy_var_damping =
-    m_sigma * velocity_error.transpose() * m_damping.block<3, 3>(0, 0) * velocity_error;
-
-  if (tank_energy < tank_energy_threshold)
-  {
-    // empty tank
-    cout << "empty tank" << endl;
-    stiffness << kd_min(0), kd_min(1), kd_min(2), 50.0, 50.0, 50.0;
-    tank_energy =
-      tank_energy_threshold + energy_var_damping * m_deltaT;  // + (energy_var_stiff)*m_deltaT;
-    // old_tank_energy = tank_energy;
-    std_msgs::msg::Float64MultiArray m_data_msg;
-    m_data_msg.data = {
-      (current_time.nanoseconds() * 1e-9),                                      // Time
-      x(0),                                                                     // x ee
-      x(1),                                                                     // y ee
-      x(2),                                                                     // z ee
-      x_d(0),                                                                   // x_d ee
-      x_d(1),                                                                   // y_d ee
-      x_d(2),                                                                   // z_d ee
-      kd(2) * position_error(2) + 2 * 0.707 * sqrt(kd(2)) * velocity_error(2),  // F_ext
-      m_ft_sensor_wrench(0),                                                    // F_ft
-      m_ft_sensor_wrench(1),                                                    // F_ft
-      m_ft_sensor_wrench(2),                                                    // F_ft
-      F_ref(2),                                                                 // F_ref
-      tank_energy,                                                              // Tank
-      (energy_var_stiff + energy_var_damping) * m_deltaT,                       // Tank_dot
-      kd(0),                                                                    // Kd_x
-      kd(1),                                                                    // Kd_y
-      kd(2),                                                                    // Kd_z
-      kd_max(2),                                                                // Kd_z max
-      kd_min(2),                                                                // Kd_z min
-      (z_value + 0.0025 - x(2)),                                                // penetration
-      stiffness_value,                                                          // K_surf
-      damping_value,                                                            // D_surf
-      F_min(2),                                                                 // F_min
-      (stiffness_value * pow((z_value + 0.0025 - x(2)), 1.35) -
-       damping_value * pow((z_value + 0.0025 - x(2)), 1.35) * (m_x_dot(2) - surf_vel)),
-      max_pen,
-      tank_energy_threshold,
-      power_limit,
-      m_x_dot(0),
-      m_x_dot(1),
-      m_x_dot(2),
-      surf_vel};
-    m_data_publisher->publish(m_data_msg);
-    return stiffness;
+void CartesianAdaptiveComplianceController::solveStiffness(const StiffnessState & state,
+                                                           StiffnessSolution & solution)
+{
+  m_stiffness_optimizer.solve(state, solution);
+  if (getSimpleStatus(solution.qp_status) != SUCCESSFUL_RETURN)
+  {
+    RCLCPP_WARN_STREAM_THROTTLE(get_node()->get_logger(), *get_node()->get_clock(), 1000,
+                                "QP solver error: " << solution.qp_status << " after "
+                                                    << solution.qp_nwsr
+                                                    << " working set changes ("
+                                                    << solution.qp_failures
+                                                    << " failures in total). "
+                                                       "Falling back to minimal stiffness.");
   }
-  else
+}
+
+void CartesianAdaptiveComplianceController::stiffnessWorker(double rate)
+{
+  const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / rate));
+  auto next = std::chrono::steady_clock::now();
+  StiffnessState state;
+  StiffnessSolution solution;
+  while (m_stiffness_worker_running)
   {
-    T_constr_min = -energy_var_damping +
-                   position_error.transpose() * kd_min.asDiagonal() * velocity_error +
-                   (tank_energy_threshold - tank_energy) / m_deltaT;
-    T_dot_min = -energy_var_damping +
-                position_error.transpose() * kd_min.asDiagonal() * velocity_error - power_limit;
-  }
-
-  real_t A[5 * 3] = {x_d(0) - x(0),
-                     0,
-                     0,
-                     0,
-                     x_d(1) - x(1),
-                     0,
-                     0,
-                     0,
-                     x_d(2) - x(2),
-                     position_error(0) * velocity_error(0),
-                     position_error(1) * velocity_error(1),
-                     position_error(2) * velocity_error(2),
-                     position_error(0) * velocity_error(0),
-                     position_error(1) * velocity_error(1),
-                     position_error(2) * velocity_error(2)};
-
-  real_t ubA[5] = {F_max(0) - m_damping(0, 0) * velocity_error(0),
-                   F_max(1) - m_damping(1, 1) * velocity_error(1),
-                   F_max(2) - m_damping(2, 2) * velocity_error(2), 1e9, 1e9};
-
-  real_t lbA[5] = {F_min(0) - m_damping(0, 0) * velocity_error(0),
-                   F_min(1) - m_damping(1, 1) * velocity_error(1),
-                   F_min(2) - m_damping(2, 2) * velocity_error(2), T_constr_min, T_dot_min};
-
-  int_t ret_val;
-  int_t nWSR = 10;
-  Options options;
-  options.printLevel = PL_NONE;
-  // redeclare solver with options
-  min_problem.setOptions(options);
-  ret_val = getSimpleStatus(min_problem.init(H, g, A, lb, ub, lbA, ubA, nWSR));
-  real_t xOpt[3];
-
-  min_problem.getPrimalSolution(xOpt);
-
-  if (ret_val != SUCCESSFUL_RETURN)
-  {
-    cout << "QP solver error: " << ret_val << endl;
-
-    stiffness << kd_min(0), kd_min(1), kd_min(2), 50.0, 50.0, 50.0;
-    tank_energy += energy_var_damping * m_deltaT;  // + (energy_var_stiff)*m_deltaT;
-    // old_tank_energy = tank_energy;
-    std_msgs::msg::Float64MultiArray m_data_msg;
-    m_data_msg.data = {
-      (current_time.nanoseconds() * 1e-9),                                      // Time
-      x(0),                                                                     // x ee
-      x(1),                                                                     // y ee
-      x(2),                                                                     // z ee
-      x_d(0),                                                                   // x_d ee
-      x_d(1),                                                                   // y_d ee
-      x_d(2),                                                                   // z_d ee
-      kd(2) * position_error(2) + 2 * 0.707 * sqrt(kd(2)) * velocity_error(2),  // F_ext
-      m_ft_sensor_wrench(0),                                                    // F_ft
-      m_ft_sensor_wrench(1),                                                    // F_ft
-      m_ft_sensor_wrench(2),                                                    // F_ft
-      F_ref(2),                                                                 // F_ref
-      tank_energy,                                                              // Tank
-      (energy_var_stiff + energy_var_damping) * m_deltaT,                       // Tank_dot
-      kd(0),                                                                    // Kd_x
-      kd(1),                                                                    // Kd_y
-      kd(2),                                                                    // Kd_z
-      kd_max(2),                                                                // Kd_z max
-      kd_min(2),                                                                // Kd_z min
-      (z_value + 0.0025 - x(2)),                                                // penetration
-      stiffness_value,                                                          // K_surf
-      damping_value,                                                            // D_surf
-      F_min(2),                                                                 // F_min
-      (stiffness_value * pow((z_value + 0.0025 - x(2)), 1.35) -
-       damping_value * pow((z_value + 0.0025 - x(2)), 1.35) * (m_x_dot(2) - surf_vel)),
-      max_pen,
-      tank_energy_threshold,
-      power_limit,
-      m_x_dot(0),
-      m_x_dot(1),
-      m_x_dot(2),
-      surf_vel};
-    m_data_publisher->publish(m_data_msg);
-    return stiffness;
-  }
-
-  // cout << "ret_val: " << ret_val << endl;
-  stiffness << xOpt[0], xOpt[1], xOpt[2], 50.0, 50.0, 50.0;
-  kd << stiffness(0), stiffness(1), stiffness(2);
-
-  // compute energy tank (previous + derivative of current*delta_T) -> EQUATION 16
-  energy_var_stiff = position_error.transpose() * ((kd - kd_min).asDiagonal()) * velocity_error;
-  tank_energy += (energy_var_stiff + energy_var_damping) * m_deltaT;
-
-  print_index++;
-  if (print_index % 21 == 0)
-  {
-    cout << "#########################################################" << endl;
-    cout << " z_pos : " << x(2) << " | des " << x_d(2) << " | surf: " << z_value
-         << " | surf vel: " << surf_vel << endl;
-    cout << "EE velocity: " << velocity_error(2) << " | ik vel" << xdot(2) << endl;
-    // cout<<" KD-KMIN: "<<endl<< (kd-kd_min)<<endl;
-    // cout << "deltaX_ext: " << position_error(2) << "  | deltaX_dot: " << velocity_error(2) << endl;
-    cout << "Kd: " << kd(0) << " " << kd(1) << " " << kd(2) << endl;
-    cout << "Tank: " << tank_energy
-         << " | Tank_dot: " << (energy_var_stiff + energy_var_damping) * m_deltaT
-         << " |  threshold: " << T_constr_min << endl;
-    cout << "F_ext: " << kd(2) * position_error(2) + 2 * 0.707 * sqrt(kd(2)) * velocity_error(2)
-         << "|  F_des: " << F_ref(2) << "|  F_min: " << F_min(2)
-         << " | F_ft: " << m_ft_sensor_wrench(2) << endl;
-    cout << "Stiffness: " << stiffness_value << " | Damping: " << damping_value << endl;
-    cout << "deltaT " << m_deltaT << endl;
-    // cout<< "X: "<< x(2) <<endl;
-  }
-
-  std_msgs::msg::Float64MultiArray m_data_msg;
-  m_data_msg.data = {
-    (current_time.nanoseconds() * 1e-9),                                      // Time
-    x(0),                                                                     // x ee
-    x(1),                                                                     // y ee
-    x(2),                                                                     // z ee
-    x_d(0),                                                                   // x_d ee
-    x_d(1),                                                                   // y_d ee
-    x_d(2),                                                                   // z_d ee
-    kd(2) * position_error(2) + 2 * 0.707 * sqrt(kd(2)) * velocity_error(2),  // F_ext
-    m_ft_sensor_wrench(0),                                                    // F_ft
-    m_ft_sensor_wrench(1),                                                    // F_ft
-    m_ft_sensor_wrench(2),                                                    // F_ft
-    F_ref(2),                                                                 // F_ref
-    tank_energy,                                                              // Tank
-    (energy_var_stiff + energy_var_damping) * m_deltaT,                       // Tank_dot
-    kd(0),                                                                    // Kd_x
-    kd(1),                                                                    // Kd_y
-    kd(2),                                                                    // Kd_z
-    kd_max(2),                                                                // Kd_z max
-    kd_min(2),                                                                // Kd_z min
-    (z_value + 0.0025 - x(2)),                                                // penetration
-    stiffness_value,                                                          // K_surf
-    damping_value,                                                            // D_surf
-    F_min(2),                                                                 // F_min
-    (stiffness_value * pow((z_value + 0.0025 - x(2)), 1.35) -
-     damping_value * pow((z_value + 0.0025 - x(2)), 1.35) * (m_x_dot(2) - surf_vel)),
-    max_pen,
-    tank_energy_threshold,
-    power_limit,
-    m_x_dot(0),
-    m_x_dot(1),
-    m_x_dot(2),
-    surf_vel};
-  m_data_publisher->publish(m_data_msg);
-
-  //old_tank_energy = tank_energy;
-  return stiffness;
+    if (m_stiffness_state_buffer.read(state))
+    {
+      solveStiffness(state, solution);
+      m_stiffness_solution_buffer.write(solution);
+    }
+
+    // Don't catch up on missed optimizations
+    next = std::max(next + period, std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(next);
+  }
 }
 
-void CartesianAdaptiveComplianceController::getEndEffectorPoseReal()
+void CartesianAdaptiveComplianceController::stopStiffnessWorker()
 {
-  KDL::JntArray positions(Base::m_joint_state_pos_handles.size());
-  KDL::JntArray velocities(Base::m_joint_state_vel_handles.size());
-  for (size_t i = 0; i < Base::m_joint_state_pos_handles.size(); ++i)
+  m_stiffness_worker_running = false;
+  if (m_stiffness_worker.joinable())
   {
-    positions(i) = Base::m_joint_state_pos_handles[i].get().get_value();
-    velocities(i) = Base::m_joint_state_vel_handles[i].get().get_value();
+    m_stiffness_worker.join();
   }
+}
+
+void CartesianAdaptiveComplianceController::logStiffnessData(const StiffnessState & state,
+                                                             const StiffnessSolution & solution)
+{
+  const ctrl::Vector3D position_error = state.x_d - state.x;
+  const ctrl::Vector3D velocity_error = -state.x_dot;
+  const StiffnessParameters & parameters = m_stiffness_parameters;
+  const SurfaceMap::Sample & surface = solution.surface;
+  const double penetration = surface.z + 0.0025 - state.x(2);
+  const double pen_pow = pow(penetration, 1.35);
+
+  StiffnessRecord record;
+  record.time = state.time;
+  record.x = state.x(0);
+  record.y = state.x(1);
+  record.z = state.x(2);
+  record.x_d = state.x_d(0);
+  record.y_d = state.x_d(1);
+  record.z_d = state.x_d(2);
+  record.f_ext = kd(2) * position_error(2) + 2 * 0.707 * sqrt(kd(2)) * velocity_error(2);
+  record.f_ft_x = m_ft_sensor_wrench(0);
+  record.f_ft_y = m_ft_sensor_wrench(1);
+  record.f_ft_z = m_ft_sensor_wrench(2);
+  record.f_ref = solution.F_ref;
+  record.tank = m_tank.energy();
+  record.tank_dot = (m_tank_step.stiffness_power + m_tank_step.damping_power) * state.deltaT;
+  record.kd_x = kd(0);
+  record.kd_y = kd(1);
+  record.kd_z = kd(2);
+  record.kd_z_max = parameters.kd_max(2);
+  record.kd_z_min = parameters.kd_min(2);
+  record.penetration = penetration;
+  record.k_surf = surface.stiffness;
+  record.d_surf = surface.damping;
+  record.f_min = solution.F_min;
+  record.f_model =
+    surface.stiffness * pen_pow - surface.damping * pen_pow * (state.x_dot(2) - solution.surf_vel);
+  record.max_pen = parameters.max_pen;
+  record.tank_threshold = parameters.tank_energy_threshold;
+  record.power_limit = parameters.power_limit;
+  record.xdot_x = state.x_dot(0);
+  record.xdot_y = state.x_dot(1);
+  record.xdot_z = state.x_dot(2);
+  record.surf_vel = solution.surf_vel;
+  record.qp_nwsr = static_cast<double>(solution.qp_nwsr);
+  record.qp_cputime = solution.qp_cputime;
+  record.qp_failures = static_cast<double>(solution.qp_failures);
+  m_data_logger.push(record);
+}
 
-  KDL::JntArrayVel joint_data(positions, velocities);
-  KDL::FrameVel tmp;
-  m_fk_solver->JntToCart(joint_data, tmp);
+void CartesianAdaptiveComplianceController::getEndEffectorPoseReal()
+{
+  const KDL::Frame & pose = Base::m_measured_state.pose();
+  const KDL::Twist & twist = Base::m_measured_state.twist();
 
-  m_x(0) = tmp.p.p.x();
-  m_x(1) = tmp.p.p.y();
-  m_x(2) = tmp.p.p.z();
+  m_x(0) = pose.p.x();
+  m_x(1) = pose.p.y();
+  m_x(2) = pose.p.z();
 
-  m_x_dot(0) = tmp.p.v.x();
-  m_x_dot(1) = tmp.p.v.y();
-  m_x_dot(2) = tmp.p.v.z();
+  m_x_dot(0) = twist.vel.x();
+  m_x_dot(1) = twist.vel.y();
+  m_x_dot(2) = twist.vel.z();
 }
+
 }  // namespace cartesian_adaptive_compliance_controller
+
 // Pluginlib
 #include <pluginlib/class_list_macros.hpp>
 
 PLUGINLIB_EXPORT_CLASS(
   cartesian_adaptive_compliance_controller::CartesianAdaptiveComplianceController,
-  controller_interface::ControllerInterface)
\ No newline at end of file
+  controller_interface::ControllerInterface)
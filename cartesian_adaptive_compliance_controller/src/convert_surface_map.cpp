@@ -0,0 +1,82 @@
+/*
+ * Convert surface maps from the text layout of dataReader into the binary
+ * format of SurfaceMap. Non-uniform grids are resampled uniformly with the
+ * same number of points per axis.
+ *
+ * Usage: convert_surface_map <text map directory> <binary map file>
+ */
+
+#include <cartesian_adaptive_compliance_controller/data_reader.h>
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+
+#include <iostream>
+
+using cartesian_adaptive_compliance_controller::SurfaceMap;
+
+int main(int argc, char ** argv)
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <text map directory> <binary map file>" << std::endl;
+    return 1;
+  }
+
+  std::vector<double> x, y, z, stiffness, damping;
+  dataReader(argv[1], x, y, z, stiffness, damping);
+
+  SurfaceMap map;
+  std::string error;
+  if (!map.init(x, y, z, stiffness, damping, error))
+  {
+    std::cerr << "Invalid text map in " << argv[1] << ": " << error << std::endl;
+    return 1;
+  }
+
+  if (!map.uniform())
+  {
+    std::cout << "Resampling the non-uniform grid uniformly" << std::endl;
+    auto uniform_axis = [](const std::vector<double> & axis)
+    {
+      std::vector<double> result(axis.size());
+      for (size_t i = 0; i < axis.size(); ++i)
+      {
+        result[i] = axis.size() > 1 ? axis.front() + (axis.back() - axis.front()) * i /
+                                                       static_cast<double>(axis.size() - 1)
+                                    : axis.front();
+      }
+      return result;
+    };
+    x = uniform_axis(map.coordinatesX());
+    y = uniform_axis(map.coordinatesY());
+    z.clear();
+    stiffness.clear();
+    damping.clear();
+    SurfaceMap::Sample sample;
+    for (const double xi : x)
+    {
+      for (const double yj : y)
+      {
+        map.sample(xi, yj, sample);
+        z.push_back(sample.z);
+        stiffness.push_back(sample.stiffness);
+        damping.push_back(sample.damping);
+      }
+    }
+    SurfaceMap resampled;
+    if (!resampled.init(x, y, z, stiffness, damping, error))
+    {
+      std::cerr << "Resampling failed: " << error << std::endl;
+      return 1;
+    }
+    map = std::move(resampled);
+  }
+
+  if (!map.save(argv[2], error))
+  {
+    std::cerr << "Cannot save binary map: " << error << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << map.sizeX() << " x " << map.sizeY() << " map to " << argv[2]
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <cartesian_adaptive_compliance_controller/data_logger.h>
+
+#include <chrono>
+#include <memory>
+
+#if defined CARTESIAN_CONTROLLERS_MATLOGGER2
+#include <matlogger2/matlogger2.h>
+#endif
+
+namespace cartesian_adaptive_compliance_controller
+{
+// clang-format off
+const std::array<StiffnessRecord::Column, 34> StiffnessRecord::columns = {{
+  {"time", &StiffnessRecord::time},
+  {"x", &StiffnessRecord::x},
+  {"y", &StiffnessRecord::y},
+  {"z", &StiffnessRecord::z},
+  {"x_d", &StiffnessRecord::x_d},
+  {"y_d", &StiffnessRecord::y_d},
+  {"z_d", &StiffnessRecord::z_d},
+  {"F_ext", &StiffnessRecord::f_ext},
+  {"F_ft_x", &StiffnessRecord::f_ft_x},
+  {"F_ft_y", &StiffnessRecord::f_ft_y},
+  {"F_ft_z", &StiffnessRecord::f_ft_z},
+  {"F_ref", &StiffnessRecord::f_ref},
+  {"tank", &StiffnessRecord::tank},
+  {"tank_dot", &StiffnessRecord::tank_dot},
+  {"Kd_x", &StiffnessRecord::kd_x},
+  {"Kd_y", &StiffnessRecord::kd_y},
+  {"Kd_z", &StiffnessRecord::kd_z},
+  {"Kd_z_max", &StiffnessRecord::kd_z_max},
+  {"Kd_z_min", &StiffnessRecord::kd_z_min},
+  {"penetration", &StiffnessRecord::penetration},
+  {"K_surf", &StiffnessRecord::k_surf},
+  {"D_surf", &StiffnessRecord::d_surf},
+  {"F_min", &StiffnessRecord::f_min},
+  {"F_model", &StiffnessRecord::f_model},
+  {"max_pen", &StiffnessRecord::max_pen},
+  {"tank_threshold", &StiffnessRecord::tank_threshold},
+  {"power_limit", &StiffnessRecord::power_limit},
+  {"xdot_x", &StiffnessRecord::xdot_x},
+  {"xdot_y", &StiffnessRecord::xdot_y},
+  {"xdot_z", &StiffnessRecord::xdot_z},
+  {"surf_vel", &StiffnessRecord::surf_vel},
+  {"qp_nwsr", &StiffnessRecord::qp_nwsr},
+  {"qp_cputime", &StiffnessRecord::qp_cputime},
+  {"qp_failures", &StiffnessRecord::qp_failures},
+}};
+// clang-format on
+
+static_assert(sizeof(StiffnessRecord) == 34 * sizeof(double),
+              "Each StiffnessRecord member needs an entry in StiffnessRecord::columns");
+
+DataLogger::DataLogger() : m_dropped(0), m_running(false) {}
+
+DataLogger::~DataLogger() { stop(); }
+
+bool DataLogger::writesMatFiles()
+{
+#if defined CARTESIAN_CONTROLLERS_MATLOGGER2
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool DataLogger::start(const std::string & path, size_t capacity, std::string & error)
+{
+#if defined CARTESIAN_CONTROLLERS_MATLOGGER2
+  stop();
+  if (capacity < 1)
+  {
+    error = "capacity must be at least 1";
+    return false;
+  }
+
+  XBot::MatLogger2::Options options;
+  options.default_buffer_size = static_cast<int>(capacity);
+  std::shared_ptr<XBot::MatLogger2> logger = XBot::MatLogger2::MakeLogger(path, options);
+  for (const auto & column : StiffnessRecord::columns)
+  {
+    logger->create(column.first, 1);
+  }
+
+  // The logger writes the .mat file when stop() releases it
+  m_sink = [logger](const StiffnessRecord & record) {
+    for (const auto & column : StiffnessRecord::columns)
+    {
+      logger->add(column.first, record.*column.second);
+    }
+  };
+  m_flush = [logger]() { logger->flush_available_data(); };
+  return startWriter(capacity, error);
+#else
+  (void)path;
+  (void)capacity;
+  error = "built without matlogger2";
+  return false;
+#endif
+}
+
+bool DataLogger::start(const Sink & sink, size_t capacity, std::string & error)
+{
+  stop();
+  if (!sink)
+  {
+    error = "no sink given";
+    return false;
+  }
+  m_sink = sink;
+  m_flush = nullptr;
+  return startWriter(capacity, error);
+}
+
+bool DataLogger::startWriter(size_t capacity, std::string & error)
+{
+  if (capacity < 1)
+  {
+    m_sink = nullptr;
+    m_flush = nullptr;
+    error = "capacity must be at least 1";
+    return false;
+  }
+
+  m_queue.reset(capacity);
+  m_dropped = 0;
+  m_running = true;
+  m_thread = std::thread(&DataLogger::run, this);
+  return true;
+}
+
+void DataLogger::stop()
+{
+  m_running = false;
+  if (m_thread.joinable())
+  {
+    m_thread.join();
+  }
+  m_sink = nullptr;
+  m_flush = nullptr;
+}
+
+bool DataLogger::push(const StiffnessRecord & record)
+{
+  if (!m_running)
+  {
+    return false;
+  }
+  if (!m_queue.push(record))
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void DataLogger::run()
+{
+  // Drain until stopped, and once more afterwards
+  bool draining = true;
+  while (draining)
+  {
+    draining = m_running;
+    StiffnessRecord record;
+    while (m_queue.pop(record))
+    {
+      m_sink(record);
+    }
+    if (m_flush)
+    {
+      m_flush();
+    }
+    if (draining)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+}  // namespace cartesian_adaptive_compliance_controller
@@ -0,0 +1,463 @@
+/*
+ * Fit the surface height, elasticity and viscosity of each palpation site in
+ * a recording of the end_effector_controller, in parallel on all cores, and
+ * write them as a binary surface map.
+ *
+ * Usage: fit_surface_map <recording> <binary map file> [options]
+ *
+ * The recording is a text table with one header line of column names and
+ * one control cycle per line, separated by commas or whitespace, as published
+ * on /data_control. It needs the columns time, x, y, z, velocity, force and
+ * palpation, i.e. the site's number. With a phase column, only the palpation
+ * phase 3 is used.
+ *
+ * Each site is fitted from its first contact on, with an extended
+ * Rauch-Tung-Striebel smoother over the viscoelastic estimator's models. The
+ * smoothed penetration gives the surface height. The smoother runs once per
+ * Hunt-Crossley exponent and the one with the most likely measurements wins.
+ *
+ * The map's grid spans the sites. Each grid point takes the values of the
+ * nearest site. Elasticity and viscosity become the map's stiffness and
+ * damping.
+ *
+ * Options:
+ *   --exponents <values>  Comma-separated Hunt-Crossley exponents (default 1.2,1.35,1.5)
+ *   --elasticity <value>  Prior elasticity (default 1000)
+ *   --viscosity <value>  Prior viscosity (default 1000)
+ *   --mass <value>  The moving mass of the model (default 0.05)
+ *   --contact_force <value>  Force that marks the first contact (default 0.1)
+ *   --resolution <value>  Grid spacing of the map (default 0.0025)
+ *   --threads <n>  (default all cores)
+ *
+ * Prints one line per site.
+ */
+
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+#include <end_effector_controller/ForceMeasurementModel.hpp>
+#include <end_effector_controller/SystemModelF.hpp>
+#include <end_effector_controller/kalman/ExtendedKalmanSmoother.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace cartesian_adaptive_compliance_controller;
+
+namespace
+{
+typedef KalmanExamples2::Estimation::State<double> State;
+
+struct Sample
+{
+  double time;
+  double x;
+  double y;
+  double z;
+  double velocity;
+  double force;
+};
+
+struct Options
+{
+  std::vector<double> exponents = {1.2, 1.35, 1.5};
+  double elasticity = 1000.0;
+  double viscosity = 1000.0;
+  double mass = 0.05;
+  double contact_force = 0.1;
+  double resolution = 0.0025;
+};
+
+struct Site
+{
+  int number;
+  std::vector<Sample> samples;
+
+  // Fit
+  bool valid = false;
+  double x = 0.0;
+  double y = 0.0;
+  double height = 0.0;
+  double elasticity = 0.0;
+  double viscosity = 0.0;
+  double exponent = 0.0;
+};
+
+std::vector<std::string> split(const std::string & text, const std::string & separators)
+{
+  std::vector<std::string> tokens;
+  size_t begin = text.find_first_not_of(separators);
+  while (begin != std::string::npos)
+  {
+    const size_t end = text.find_first_of(separators, begin);
+    tokens.push_back(text.substr(begin, end - begin));
+    begin = text.find_first_not_of(separators, end);
+  }
+  return tokens;
+}
+
+/**
+ * @brief Read the recording into one site per palpation number
+ */
+bool readRecording(const std::string & path, std::vector<Site> & sites, std::string & error)
+{
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+
+  const std::vector<std::string> header = split(line, ", \t\r");
+  const std::vector<std::string> names = {"time",     "x",     "y",        "z",
+                                          "velocity", "force", "palpation"};
+  std::vector<size_t> columns;
+  for (const std::string & name : names)
+  {
+    const auto it = std::find(header.begin(), header.end(), name);
+    if (it == header.end())
+    {
+      error = "missing column " + name;
+      return false;
+    }
+    columns.push_back(static_cast<size_t>(it - header.begin()));
+  }
+  const auto phase = std::find(header.begin(), header.end(), "phase");
+
+  std::map<int, size_t> site_index;
+  size_t lines = 1;
+  while (std::getline(file, line))
+  {
+    ++lines;
+    const std::vector<std::string> tokens = split(line, ", \t\r");
+    if (tokens.empty())
+    {
+      continue;
+    }
+    if (tokens.size() != header.size())
+    {
+      error = "line " + std::to_string(lines) + " has " + std::to_string(tokens.size()) +
+              " instead of " + std::to_string(header.size()) + " values";
+      return false;
+    }
+    if (phase != header.end() && std::stod(tokens[phase - header.begin()]) != 3.0)
+    {
+      continue;
+    }
+    double v[7];
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+      v[i] = std::stod(tokens[columns[i]]);
+    }
+
+    const int number = static_cast<int>(v[6]);
+    auto it = site_index.find(number);
+    if (it == site_index.end())
+    {
+      it = site_index.emplace(number, sites.size()).first;
+      sites.push_back({number, {}});
+    }
+    sites[it->second].samples.push_back({v[0], v[1], v[2], v[3], v[4], v[5]});
+  }
+
+  if (sites.empty())
+  {
+    error = "no palpation samples";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Smooth a site's contact with one exponent
+ *
+ * @return The log-likelihood of the velocity measurements, up to a constant
+ */
+double smooth(const std::vector<Sample> & samples, size_t first, double exponent,
+              const Options & options, Kalman::ExtendedKalmanSmoother<State> & smoother)
+{
+  KalmanExamples2::Estimation::SystemModel<double> system;
+  KalmanExamples2::Estimation::ForceMeasurementModel<double> measurement;
+  const double r = measurement.getCovariance()(0, 0);
+
+  // The forces and velocities of the recording are along the base's z axis
+  State x;
+  x.x1() = 0.0;
+  x.x2() = -samples[first].velocity;
+  x.x3() = options.elasticity;
+  x.x4() = options.viscosity;
+  Kalman::Covariance<State> P;
+  P.setZero();
+  P(State::POSITION, State::POSITION) = 1e-6;
+  P(State::VELOCITY, State::VELOCITY) = 1e-6;
+  P(State::ELASTICITY, State::ELASTICITY) = 1000.0;
+  P(State::VISCOSITY, State::VISCOSITY) = 1000.0;
+  smoother.init(x);
+  smoother.setCovariance(P);
+  smoother.clear();
+  smoother.reserve(samples.size() - first);
+
+  double likelihood = 0.0;
+  for (size_t i = first + 1; i < samples.size(); ++i)
+  {
+    const double dt = samples[i].time - samples[i - 1].time;
+    if (dt <= 0.0)
+    {
+      continue;
+    }
+    system.setModelData(options.mass, dt, exponent);
+    system.setForce(-samples[i].force);
+    smoother.predict(system);
+
+    KalmanExamples2::Estimation::VelocityMeasurement<double> z;
+    z.v() = -samples[i].velocity;
+    const double innovation = z.v() - smoother.getState().x2();
+    const double variance = smoother.getCovariance()(State::VELOCITY, State::VELOCITY) + r;
+    likelihood -= 0.5 * (std::log(variance) + innovation * innovation / variance);
+    smoother.update(measurement, z);
+  }
+  if (!smoother.smooth() || !std::isfinite(likelihood))
+  {
+    return -std::numeric_limits<double>::infinity();
+  }
+  return likelihood;
+}
+
+/**
+ * @brief Fit a site's surface height, elasticity, viscosity and exponent
+ */
+void fit(Site & site, const Options & options)
+{
+  const std::vector<Sample> & samples = site.samples;
+  for (const Sample & sample : samples)
+  {
+    site.x += sample.x / samples.size();
+    site.y += sample.y / samples.size();
+  }
+
+  // The contact starts with the first force into the tissue
+  size_t first = 0;
+  while (first < samples.size() && -samples[first].force < options.contact_force)
+  {
+    ++first;
+  }
+  if (samples.size() - first < 2)
+  {
+    return;
+  }
+
+  // Fit all exponents and keep the most likely one
+  Kalman::ExtendedKalmanSmoother<State> smoother;
+  double best = -std::numeric_limits<double>::infinity();
+  for (double exponent : options.exponents)
+  {
+    const double likelihood = smooth(samples, first, exponent, options, smoother);
+    if (likelihood <= best)
+    {
+      continue;
+    }
+    best = likelihood;
+
+    // Surface height from the smoothed penetration, which points down
+    double height = 0.0;
+    size_t k = 0;
+    for (size_t i = first; i < samples.size(); ++i)
+    {
+      if (i == first || samples[i].time > samples[i - 1].time)
+      {
+        height += samples[i].z + smoother.getSmoothedState(k++).x1();
+      }
+    }
+    site.height = height / k;
+
+    const State & parameters = smoother.getSmoothedState(0);
+    site.elasticity = parameters.x3();
+    site.viscosity = parameters.x4();
+    site.exponent = exponent;
+    site.valid = true;
+  }
+}
+
+bool parseScalars(const std::string & text, std::vector<double> & values)
+{
+  values.clear();
+  for (const std::string & value : split(text, ","))
+  {
+    values.push_back(std::stod(value));
+  }
+  return !values.empty();
+}
+
+/**
+ * @brief Uniform axis with about the given spacing over the range
+ */
+std::vector<double> axis(double min, double max, double resolution)
+{
+  const size_t n = static_cast<size_t>(std::round((max - min) / resolution)) + 1;
+  std::vector<double> coordinates(std::max<size_t>(n, 2));
+  for (size_t i = 0; i < coordinates.size(); ++i)
+  {
+    coordinates[i] = n > 1 ? min + (max - min) * i / (n - 1) : min + resolution * i;
+  }
+  return coordinates;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  if (argc < 3 || (argc - 3) % 2 != 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " <recording> <binary map file> [--option value]..."
+              << std::endl;
+    return 1;
+  }
+
+  Options options;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 3; i < argc; i += 2)
+  {
+    const std::string option = argv[i];
+    const std::string value = argv[i + 1];
+    bool valid = true;
+    try
+    {
+      if (option == "--exponents")
+      {
+        valid = parseScalars(value, options.exponents);
+      }
+      else if (option == "--elasticity")
+      {
+        options.elasticity = std::stod(value);
+      }
+      else if (option == "--viscosity")
+      {
+        options.viscosity = std::stod(value);
+      }
+      else if (option == "--mass")
+      {
+        options.mass = std::stod(value);
+        valid = options.mass > 0.0;
+      }
+      else if (option == "--contact_force")
+      {
+        options.contact_force = std::stod(value);
+      }
+      else if (option == "--resolution")
+      {
+        options.resolution = std::stod(value);
+        valid = options.resolution > 0.0;
+      }
+      else if (option == "--threads")
+      {
+        threads = static_cast<unsigned>(std::max(1, std::stoi(value)));
+      }
+      else
+      {
+        std::cerr << "Unknown option " << option << std::endl;
+        return 1;
+      }
+    }
+    catch (const std::exception &)
+    {
+      valid = false;
+    }
+    if (!valid)
+    {
+      std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Site> sites;
+  std::string error;
+  if (!readRecording(argv[1], sites, error))
+  {
+    std::cerr << "Invalid recording: " << error << std::endl;
+    return 1;
+  }
+  threads = std::min<unsigned>(threads, sites.size());
+  std::cerr << "Fitting " << sites.size() << " sites on " << threads << " threads" << std::endl;
+
+  // Each worker takes the next open site
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    workers.emplace_back(
+      [&]()
+      {
+        for (size_t i = next++; i < sites.size(); i = next++)
+        {
+          fit(sites[i], options);
+        }
+      });
+  }
+  for (std::thread & worker : workers)
+  {
+    worker.join();
+  }
+  const double duration =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Finished in " << duration << " s" << std::endl;
+
+  std::cout << "palpation x y height elasticity viscosity exponent" << std::endl;
+  std::vector<const Site *> fitted;
+  for (const Site & site : sites)
+  {
+    if (!site.valid)
+    {
+      std::cerr << "Cannot fit site " << site.number << ", e.g. for lack of contact" << std::endl;
+      continue;
+    }
+    fitted.push_back(&site);
+    std::cout << site.number << " " << site.x << " " << site.y << " " << site.height << " "
+              << site.elasticity << " " << site.viscosity << " " << site.exponent << std::endl;
+  }
+  if (fitted.empty())
+  {
+    std::cerr << "No site to build a map from" << std::endl;
+    return 1;
+  }
+
+  // Grid over all sites, each point with the values of the nearest one
+  const auto [min_x, max_x] = std::minmax_element(
+    fitted.begin(), fitted.end(), [](const Site * a, const Site * b) { return a->x < b->x; });
+  const auto [min_y, max_y] = std::minmax_element(
+    fitted.begin(), fitted.end(), [](const Site * a, const Site * b) { return a->y < b->y; });
+  const std::vector<double> x = axis((*min_x)->x, (*max_x)->x, options.resolution);
+  const std::vector<double> y = axis((*min_y)->y, (*max_y)->y, options.resolution);
+  std::vector<double> z, stiffness, damping;
+  for (const double xi : x)
+  {
+    for (const double yj : y)
+    {
+      const Site * nearest = *std::min_element(
+        fitted.begin(), fitted.end(),
+        [xi, yj](const Site * a, const Site * b)
+        {
+          return std::hypot(a->x - xi, a->y - yj) < std::hypot(b->x - xi, b->y - yj);
+        });
+      z.push_back(nearest->height);
+      stiffness.push_back(nearest->elasticity);
+      damping.push_back(nearest->viscosity);
+    }
+  }
+
+  SurfaceMap map;
+  if (!map.init(x, y, z, stiffness, damping, error) || !map.save(argv[2], error))
+  {
+    std::cerr << "Cannot write the map: " << error << std::endl;
+    return 1;
+  }
+  std::cerr << "Wrote " << map.sizeX() << " x " << map.sizeY() << " map to " << argv[2]
+            << std::endl;
+  return 0;
+}
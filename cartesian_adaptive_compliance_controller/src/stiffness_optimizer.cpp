@@ -0,0 +1,252 @@
+#include <cartesian_adaptive_compliance_controller/stiffness_optimizer.h>
+#include <cartesian_adaptive_compliance_controller/stiffness_qp.h>
+
+#include <cmath>
+
+namespace cartesian_adaptive_compliance_controller
+{
+USING_NAMESPACE_QPOASES
+
+StiffnessOptimizer::StiffnessOptimizer()
+: m_surface_map(nullptr),
+  m_qp(3, 5),
+  m_qp_initialized(false),
+  m_qp_failures(0)
+{
+  Options options;
+  options.printLevel = PL_NONE;
+  m_qp.setOptions(options);
+}
+
+bool StiffnessOptimizer::reset(const StiffnessParameters & parameters,
+                               const SurfaceMap * surface_map)
+{
+  m_parameters = parameters;
+  m_surface_map = surface_map;
+  m_qp_failures = 0;
+
+  // Without any position error, the optimal stiffness is the minimal one
+  const ctrl::Vector3D & R = m_parameters.R;
+  const ctrl::Vector3D & kd_min = m_parameters.kd_min;
+  const ctrl::Vector3D & kd_max = m_parameters.kd_max;
+  real_t H[3 * 3] = {R(0), 0, 0, 0, R(1), 0, 0, 0, R(2)};
+  real_t g[3] = {-kd_min(0) * R(0), -kd_min(1) * R(1), -kd_min(2) * R(2)};
+  real_t A[5 * 3] = {0};
+  real_t lb[3] = {kd_min(0), kd_min(1), kd_min(2)};
+  real_t ub[3] = {kd_max(0), kd_max(1), kd_max(2)};
+  real_t lbA[5] = {-1e9, -1e9, -1e9, -1e9, -1e9};
+  real_t ubA[5] = {1e9, 1e9, 1e9, 1e9, 1e9};
+
+  m_qp.reset();
+  int_t nWSR = m_qp_max_nwsr;
+  m_qp_initialized = m_qp.init(H, g, A, lb, ub, lbA, ubA, nWSR) == SUCCESSFUL_RETURN;
+  return m_qp_initialized;
+}
+
+void StiffnessOptimizer::solve(const StiffnessState & state, StiffnessSolution & solution)
+{
+  const ctrl::Vector3D & Q = m_parameters.Q;
+  const ctrl::Vector3D & R = m_parameters.R;
+  const ctrl::Vector3D & kd_min = m_parameters.kd_min;
+  const ctrl::Vector3D & kd_max = m_parameters.kd_max;
+  const ctrl::Vector3D & F_max = m_parameters.F_max;
+  const ctrl::Vector3D & x = state.x;
+  const ctrl::Vector3D & x_d = state.x_d;
+  const ctrl::Vector3D velocity_error = -state.x_dot;
+  const ctrl::Vector3D position_error = x_d - x;
+
+  // Get the z, stiffness and damping values corresponding to the current position
+  m_surface_map->sample(x(0), x(1), solution.surface);
+  double stiffness_value = solution.surface.stiffness;
+  double damping_value = solution.surface.damping;
+
+  // The surface moves under the end-effector with the map gradient along its path
+  double surf_vel =
+    solution.surface.dz_dx * state.x_dot(0) + solution.surface.dz_dy * state.x_dot(1);
+  solution.surf_vel = surf_vel;
+
+  ctrl::Vector3D F_ref = {0.0, 0.0, 0.0};
+  ctrl::Vector3D f_min = -F_max;
+
+  if (state.ft_z < -0.5)
+  {
+    // penetrating material
+    const double pen_pow = std::pow(m_parameters.max_pen, 1.35);
+    F_ref(2) =
+      -(stiffness_value * pen_pow - damping_value * pen_pow * (state.x_dot(2) - surf_vel));
+    f_min(2) = -9;
+  }
+  else
+  {
+    // free motion
+    F_ref(2) = 0.0;
+    f_min(2) = -F_max(2);
+  }
+
+  solution.F_ref = F_ref(2);
+  solution.F_min = f_min(2);
+  solution.qp_status = SUCCESSFUL_RETURN;
+  solution.qp_nwsr = 0;
+  solution.qp_cputime = 0.0;
+  solution.qp_failures = m_qp_failures;
+
+  if (state.tank_energy < m_parameters.tank_energy_threshold)
+  {
+    // The control loop uses the minimal stiffness until the tank recovers
+    solution.kd = kd_min;
+    solution.success = false;
+    return;
+  }
+
+  real_t H[3 * 3] = {R(0) + Q(0) * std::pow(position_error(0), 2), 0, 0, 0,
+                     R(1) + Q(1) * std::pow(position_error(1), 2), 0, 0, 0,
+                     R(2) + Q(2) * std::pow(position_error(2), 2)};
+
+  // -Kmin1 R1 - Fdx Q1 x1 + kd1 (R1 + Q1 x1^2)
+  real_t g[3] = {
+    -kd_min(0) * R(0) +
+      (-F_ref(0) + state.damping(0) * velocity_error(0)) * position_error(0) * Q(0),
+    -kd_min(1) * R(1) +
+      (-F_ref(1) + state.damping(1) * velocity_error(1)) * position_error(1) * Q(1),
+    -kd_min(2) * R(2) +
+      (-F_ref(2) + state.damping(2) * velocity_error(2)) * position_error(2) * Q(2)};
+
+  // Constraints on  K2
+  real_t lb[3] = {kd_min(0), kd_min(1), kd_min(2)};
+  real_t ub[3] = {kd_max(0), kd_max(1), kd_max(2)};
+
+  // Tank equation
+  //  T = Xt^2/2 + x_tilde_x*x_tilde_dot_x*(kd_x - kd_x_min)
+  //             + x_tilde_y*x_tilde_dot_y*(kd_y - kd_y_min)
+  //             + x_tilde_z*x_tilde_dot_z*(kd_z - kd_z_min)
+  //
+  // The terms with kd go into A, the others into the bounds.
+  // Constraints with the state's tank and damping power
+  real_t T_constr_min = -state.energy_var_damping +
+                        position_error.transpose() * kd_min.asDiagonal() * velocity_error +
+                        (m_parameters.tank_energy_threshold - state.tank_energy) / state.deltaT;
+  real_t T_dot_min = -state.energy_var_damping +
+                     position_error.transpose() * kd_min.asDiagonal() * velocity_error -
+                     m_parameters.power_limit;
+
+  real_t A[5 * 3] = {position_error(0),
+                     0,
+                     0,
+                     0,
+                     position_error(1),
+                     0,
+                     0,
+                     0,
+                     position_error(2),
+                     position_error(0) * velocity_error(0),
+                     position_error(1) * velocity_error(1),
+                     position_error(2) * velocity_error(2),
+                     position_error(0) * velocity_error(0),
+                     position_error(1) * velocity_error(1),
+                     position_error(2) * velocity_error(2)};
+
+  real_t ubA[5] = {F_max(0) - state.damping(0) * velocity_error(0),
+                   F_max(1) - state.damping(1) * velocity_error(1),
+                   F_max(2) - state.damping(2) * velocity_error(2), 1e9, 1e9};
+
+  real_t lbA[5] = {f_min(0) - state.damping(0) * velocity_error(0),
+                   f_min(1) - state.damping(1) * velocity_error(1),
+                   f_min(2) - state.damping(2) * velocity_error(2), T_constr_min, T_dot_min};
+
+  returnValue qp_status;
+  int_t nwsr;
+  real_t cputime;
+  real_t xOpt[3];
+  if (m_parameters.explicit_qp)
+  {
+    const real_t start = getCPUtime();
+    const StiffnessQP::Status status = StiffnessQP::solve(H, g, A, lb, ub, lbA, ubA, xOpt);
+    cputime = getCPUtime() - start;
+    nwsr = 0;
+    qp_status = status == StiffnessQP::Status::Success      ? SUCCESSFUL_RETURN
+                : status == StiffnessQP::Status::Infeasible ? RET_QP_INFEASIBLE
+                                                            : RET_INVALID_ARGUMENTS;
+  }
+  else
+  {
+    // Hot-start from the previous active set.
+    // Start from scratch after failures.
+    nwsr = m_qp_max_nwsr;
+    cputime = m_qp_max_cputime;
+    qp_status = m_qp_initialized ? m_qp.hotstart(H, g, A, lb, ub, lbA, ubA, nwsr, &cputime)
+                                 : m_qp.init(H, g, A, lb, ub, lbA, ubA, nwsr, &cputime);
+    m_qp.getPrimalSolution(xOpt);
+    m_qp_initialized = getSimpleStatus(qp_status) == SUCCESSFUL_RETURN;
+  }
+
+  if (getSimpleStatus(qp_status) != SUCCESSFUL_RETURN)
+  {
+    ++m_qp_failures;
+    solution.kd = kd_min;
+    solution.success = false;
+  }
+  else
+  {
+    solution.kd << xOpt[0], xOpt[1], xOpt[2];
+    solution.success = true;
+  }
+  solution.qp_status = qp_status;
+  solution.qp_nwsr = nwsr;
+  solution.qp_cputime = cputime;
+  solution.qp_failures = m_qp_failures;
+}
+
+EnergyTank::EnergyTank() : m_energy(0.5) {}
+
+void EnergyTank::reset(const StiffnessParameters & parameters, double energy)
+{
+  m_parameters = parameters;
+  m_energy = energy;
+}
+
+double EnergyTank::dampingPower(const ctrl::Vector3D & x_dot,
+                                const ctrl::Vector3D & damping) const
+{
+  const double sigma = m_energy >= 1.0 ? 0.0 : 1.0;
+  return sigma * x_dot.transpose() * damping.asDiagonal() * x_dot;
+}
+
+EnergyTank::Step EnergyTank::step(const StiffnessState & state, const StiffnessSolution & solution,
+                                  bool validate)
+{
+  const ctrl::Vector3D & kd_min = m_parameters.kd_min;
+  const ctrl::Vector3D position_error = state.x_d - state.x;
+  const ctrl::Vector3D velocity_error = -state.x_dot;
+
+  Step step;
+  step.damping_power = state.energy_var_damping;
+
+  if (m_energy < m_parameters.tank_energy_threshold)
+  {
+    // empty tank
+    step.kd = kd_min;
+    step.stiffness_power = 0.0;
+    step.depleted = true;
+    m_energy = m_parameters.tank_energy_threshold + step.damping_power * state.deltaT;
+    return step;
+  }
+
+  step.kd = solution.success ? solution.kd : kd_min;
+  step.stiffness_power =
+    position_error.transpose() * (step.kd - kd_min).asDiagonal() * velocity_error;
+  step.depleted = false;
+
+  const double tank_dot = step.stiffness_power + step.damping_power;
+  if (validate && (m_energy + tank_dot * state.deltaT < m_parameters.tank_energy_threshold ||
+                   tank_dot < -m_parameters.power_limit))
+  {
+    step.kd = kd_min;
+    step.stiffness_power = 0.0;
+  }
+
+  // compute energy tank (previous + derivative of current*delta_T) -> EQUATION 16
+  m_energy += (step.stiffness_power + step.damping_power) * state.deltaT;
+  return step;
+}
+
+}  // namespace cartesian_adaptive_compliance_controller
@@ -0,0 +1,192 @@
+#include <cartesian_adaptive_compliance_controller/stiffness_qp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cartesian_adaptive_compliance_controller
+{
+namespace
+{
+constexpr int n = 3;
+
+// Relative tolerance for bounds that cross due to rounding
+constexpr double feasibility_tolerance = 1e-9;
+
+struct Box
+{
+  double h[n];
+  double g[n];
+  double c[n];
+  double l[n];
+  double u[n];
+
+  double at(int i, double lambda) const
+  {
+    return std::min(std::max((lambda * c[i] - g[i]) / h[i], l[i]), u[i]);
+  }
+
+  double coupling(double lambda) const
+  {
+    double s = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+      s += c[i] * at(i, lambda);
+    }
+    return s;
+  }
+};
+
+/**
+ * @brief Find the multiplier for which the coupling constraint holds with equality
+ *
+ * The coupling `c' k(lambda)` is piecewise linear and monotonically
+ * increasing in `lambda`. It changes slope only where a stiffness hits a
+ * bound. Walk these points away from zero in `direction` until the target is
+ * crossed and interpolate linearly within that segment.
+ */
+double findMultiplier(const Box & box, double target, double direction)
+{
+  double breakpoints[2 * n];
+  int count = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    if (box.c[i] == 0.0)
+    {
+      continue;
+    }
+    for (double bound : {box.l[i], box.u[i]})
+    {
+      const double lambda = (box.h[i] * bound + box.g[i]) / box.c[i];
+      if (lambda * direction > 0.0)
+      {
+        breakpoints[count++] = lambda;
+      }
+    }
+  }
+  // Insertion sort by distance from zero, which is fastest for so few points
+  for (int k = 1; k < count; ++k)
+  {
+    const double value = breakpoints[k];
+    int j = k;
+    for (; j > 0 && std::abs(breakpoints[j - 1]) > std::abs(value); --j)
+    {
+      breakpoints[j] = breakpoints[j - 1];
+    }
+    breakpoints[j] = value;
+  }
+
+  double lambda_prev = 0.0;
+  double s_prev = box.coupling(0.0);
+  for (int k = 0; k < count; ++k)
+  {
+    const double lambda = breakpoints[k];
+    const double s = box.coupling(lambda);
+    if ((s - target) * direction >= 0.0)
+    {
+      if (s == s_prev)
+      {
+        return lambda;
+      }
+      return lambda_prev + (target - s_prev) * (lambda - lambda_prev) / (s - s_prev);
+    }
+    lambda_prev = lambda;
+    s_prev = s;
+  }
+  return lambda_prev;
+}
+}  // namespace
+
+StiffnessQP::Status StiffnessQP::solve(const double * H, const double * g, const double * A,
+                                       const double * lb, const double * ub, const double * lbA,
+                                       const double * ubA, double * x)
+{
+  // Check the structure
+  for (int i = 0; i < n; ++i)
+  {
+    for (int j = 0; j < n; ++j)
+    {
+      if (i != j && (H[i * n + j] != 0.0 || A[i * n + j] != 0.0))
+      {
+        return Status::Unsupported;
+      }
+    }
+    if (!(H[i * n + i] > 0.0) || A[3 * n + i] != A[4 * n + i])
+    {
+      return Status::Unsupported;
+    }
+  }
+
+  // Merge the force constraints into the bounds
+  Box box;
+  for (int i = 0; i < n; ++i)
+  {
+    box.h[i] = H[i * n + i];
+    box.g[i] = g[i];
+    box.c[i] = A[3 * n + i];
+    box.l[i] = lb[i];
+    box.u[i] = ub[i];
+
+    const double a = A[i * n + i];
+    if (a > 0.0)
+    {
+      box.l[i] = std::max(box.l[i], lbA[i] / a);
+      box.u[i] = std::min(box.u[i], ubA[i] / a);
+    }
+    else if (a < 0.0)
+    {
+      box.l[i] = std::max(box.l[i], ubA[i] / a);
+      box.u[i] = std::min(box.u[i], lbA[i] / a);
+    }
+    else if (lbA[i] > 0.0 || ubA[i] < 0.0)
+    {
+      return Status::Infeasible;
+    }
+
+    const double tolerance = feasibility_tolerance * (1.0 + std::abs(box.u[i]));
+    if (box.l[i] > box.u[i] + tolerance)
+    {
+      return Status::Infeasible;
+    }
+    box.u[i] = std::max(box.u[i], box.l[i]);
+  }
+
+  // Merge the tank constraints
+  const double lower = std::max(lbA[3], lbA[4]);
+  const double upper = std::min(ubA[3], ubA[4]);
+
+  double s_min = 0.0;
+  double s_max = 0.0;
+  for (int i = 0; i < n; ++i)
+  {
+    s_min += std::min(box.c[i] * box.l[i], box.c[i] * box.u[i]);
+    s_max += std::max(box.c[i] * box.l[i], box.c[i] * box.u[i]);
+  }
+  const double lower_tolerance = feasibility_tolerance * (1.0 + std::abs(lower));
+  const double upper_tolerance = feasibility_tolerance * (1.0 + std::abs(upper));
+  if (lower > upper + std::min(lower_tolerance, upper_tolerance) ||
+      lower > s_max + lower_tolerance || upper < s_min - upper_tolerance)
+  {
+    return Status::Infeasible;
+  }
+
+  // Without active coupling, each stiffness is clamped individually
+  double lambda = 0.0;
+  const double s = box.coupling(0.0);
+  if (s < lower)
+  {
+    lambda = findMultiplier(box, lower, 1.0);
+  }
+  else if (s > upper)
+  {
+    lambda = findMultiplier(box, upper, -1.0);
+  }
+
+  for (int i = 0; i < n; ++i)
+  {
+    x[i] = box.at(i, lambda);
+  }
+  return Status::Success;
+}
+
+}  // namespace cartesian_adaptive_compliance_controller
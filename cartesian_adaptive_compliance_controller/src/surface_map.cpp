@@ -0,0 +1,382 @@
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace cartesian_adaptive_compliance_controller
+{
+namespace
+{
+// Relative deviation from the mean spacing up to which an axis counts as uniform
+constexpr double uniform_tolerance = 1e-6;
+
+constexpr char file_magic[8] = "SURFMAP";
+constexpr uint32_t file_layers = 3;  // Version 1
+static_assert(sizeof(SurfaceMap::FileHeader) == 64, "Binary map header must stay 64 bytes");
+static_assert(sizeof(SurfaceMap::Cell) == 64, "Cell records must fill one cache line");
+
+void reverseRows(std::vector<double>::iterator layer, size_t rows, size_t cols)
+{
+  for (size_t i = 0; i < rows / 2; ++i)
+  {
+    std::swap_ranges(layer + i * cols, layer + (i + 1) * cols, layer + (rows - 1 - i) * cols);
+  }
+}
+
+void reverseCols(std::vector<double>::iterator layer, size_t rows, size_t cols)
+{
+  for (size_t i = 0; i < rows; ++i)
+  {
+    std::reverse(layer + i * cols, layer + (i + 1) * cols);
+  }
+}
+
+template <typename T>
+void coefficients(const double * layer, size_t i00, size_t i10, size_t i01, size_t i11, T * c)
+{
+  c[0] = static_cast<T>(layer[i00]);
+  c[1] = static_cast<T>(layer[i10] - layer[i00]);
+  c[2] = static_cast<T>(layer[i01] - layer[i00]);
+  c[3] = static_cast<T>(layer[i11] - layer[i10] - layer[i01] + layer[i00]);
+}
+
+template <typename T>
+double bilinear(const T * c, double tx, double ty)
+{
+  return c[0] + c[1] * tx + (c[2] + c[3] * tx) * ty;
+}
+}  // namespace
+
+SurfaceMap::SurfaceMap() : m_cells(nullptr) {}
+
+bool SurfaceMap::init(std::vector<double> x, std::vector<double> y, const std::vector<double> & z,
+                      const std::vector<double> & stiffness, const std::vector<double> & damping,
+                      std::string & error)
+{
+  if (x.empty() || y.empty())
+  {
+    error = "empty axis";
+    return false;
+  }
+  const size_t size = x.size() * y.size();
+  if (z.size() != size || stiffness.size() != size || damping.size() != size)
+  {
+    error = "expected " + std::to_string(size) + " values per layer for a " +
+            std::to_string(x.size()) + " x " + std::to_string(y.size()) + " grid";
+    return false;
+  }
+
+  Axis x_axis;
+  Axis y_axis;
+  bool x_reversed = false;
+  bool y_reversed = false;
+  if (!initAxis(x, x_reversed, x_axis, error) || !initAxis(y, y_reversed, y_axis, error))
+  {
+    return false;
+  }
+
+  // Bring the layers into ascending axis order
+  std::vector<double> layers;
+  layers.reserve(file_layers * size);
+  for (const auto * layer : {&z, &stiffness, &damping})
+  {
+    layers.insert(layers.end(), layer->begin(), layer->end());
+    auto begin = layers.end() - size;
+    if (x_reversed)
+    {
+      reverseRows(begin, x.size(), y.size());
+    }
+    if (y_reversed)
+    {
+      reverseCols(begin, x.size(), y.size());
+    }
+  }
+
+  m_x = std::move(x_axis);
+  m_y = std::move(y_axis);
+  m_mapping.reset();
+  buildCells(layers.data(), layers.data() + size, layers.data() + 2 * size);
+  return true;
+}
+
+void SurfaceMap::buildCells(const double * z, const double * stiffness, const double * damping)
+{
+  const size_t cols = sizeY();
+  const size_t di = sizeX() > 1 ? cols : 0;
+  const size_t dj = sizeY() > 1 ? 1 : 0;
+
+  m_storage.resize(cellsX() * cellsY());
+  for (size_t i = 0; i < cellsX(); ++i)
+  {
+    for (size_t j = 0; j < cellsY(); ++j)
+    {
+      const size_t i00 = i * cols + j;
+      Cell & cell = m_storage[i * cellsY() + j];
+      coefficients(z, i00, i00 + di, i00 + dj, i00 + di + dj, cell.z);
+      coefficients(stiffness, i00, i00 + di, i00 + dj, i00 + di + dj, cell.stiffness);
+      coefficients(damping, i00, i00 + di, i00 + dj, i00 + di + dj, cell.damping);
+    }
+  }
+  m_cells = m_storage.data();
+}
+
+bool SurfaceMap::load(const std::string & filename, std::string & error)
+{
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    error = "cannot open " + filename + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader))
+  {
+    ::close(fd);
+    error = filename + " is too small for a surface map";
+    return false;
+  }
+  const size_t length = static_cast<size_t>(info.st_size);
+
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  flags |= MAP_POPULATE;  // Prefault to avoid page faults in the control loop
+#endif
+  void * address = ::mmap(nullptr, length, PROT_READ, flags, fd, 0);
+  ::close(fd);  // The mapping stays valid
+  if (address == MAP_FAILED)
+  {
+    error = "cannot map " + filename + ": " + std::strerror(errno);
+    return false;
+  }
+  std::shared_ptr<const void> mapping(address,
+                                      [length](const void * a)
+                                      { ::munmap(const_cast<void *>(a), length); });
+
+  FileHeader header;
+  std::memcpy(&header, address, sizeof(header));
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+  {
+    error = filename + " is not a surface map";
+    return false;
+  }
+  if (header.version != 1 && header.version != file_version)
+  {
+    error = "unsupported surface map version " + std::to_string(header.version) +
+            ", expected 1 or " + std::to_string(file_version);
+    return false;
+  }
+  const uint32_t layout = header.version == 1 ? file_layers : sizeof(Cell);
+  if (header.layout != layout || header.size_x == 0 || header.size_y == 0 ||
+      !(header.spacing_x > 0.0) || !(header.spacing_y > 0.0) || !std::isfinite(header.origin_x) ||
+      !std::isfinite(header.origin_y))
+  {
+    error = "invalid surface map header in " + filename;
+    return false;
+  }
+
+  auto make_axis = [](size_t n, double origin, double spacing)
+  {
+    Axis axis;
+    axis.coordinates.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      axis.coordinates[i] = origin + static_cast<double>(i) * spacing;
+    }
+    axis.uniform = n > 1;
+    axis.inv_spacing = 1.0 / spacing;
+    return axis;
+  };
+  Axis x_axis = make_axis(header.size_x, header.origin_x, header.spacing_x);
+  Axis y_axis = make_axis(header.size_y, header.origin_y, header.spacing_y);
+
+  const size_t nodes = header.size_x * header.size_y;
+  const size_t cells = (header.size_x > 1 ? header.size_x - 1 : 1) *
+                       (header.size_y > 1 ? header.size_y - 1 : 1);
+  const size_t payload =
+    header.version == 1 ? file_layers * nodes * sizeof(double) : cells * sizeof(Cell);
+  if (nodes / header.size_x != header.size_y || length != sizeof(FileHeader) + payload)
+  {
+    error = filename + " is truncated or has trailing data";
+    return false;
+  }
+
+  const char * data = static_cast<const char *>(address) + sizeof(FileHeader);
+  m_x = std::move(x_axis);
+  m_y = std::move(y_axis);
+  if (header.version == 1)
+  {
+    // Convert the separate layers
+    const double * layers = reinterpret_cast<const double *>(data);
+    m_mapping.reset();
+    buildCells(layers, layers + nodes, layers + 2 * nodes);
+    return true;
+  }
+
+  // Use the records in place
+  m_storage.clear();
+  m_storage.shrink_to_fit();
+  m_mapping = std::move(mapping);
+  m_cells = reinterpret_cast<const Cell *>(data);
+  return true;
+}
+
+bool SurfaceMap::save(const std::string & filename, std::string & error) const
+{
+  if (empty())
+  {
+    error = "empty map";
+    return false;
+  }
+  if ((sizeX() > 1 && !m_x.uniform) || (sizeY() > 1 && !m_y.uniform))
+  {
+    error = "binary maps need uniformly spaced axes";
+    return false;
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.layout = sizeof(Cell);
+  header.size_x = sizeX();
+  header.size_y = sizeY();
+  header.origin_x = m_x.coordinates.front();
+  header.origin_y = m_y.coordinates.front();
+  header.spacing_x = sizeX() > 1 ? 1.0 / m_x.inv_spacing : 1.0;
+  header.spacing_y = sizeY() > 1 ? 1.0 / m_y.inv_spacing : 1.0;
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(m_cells), cellsX() * cellsY() * sizeof(Cell));
+  if (!file)
+  {
+    error = "cannot write " + filename;
+    return false;
+  }
+  return true;
+}
+
+bool SurfaceMap::initAxis(std::vector<double> & coordinates, bool & reversed, Axis & axis,
+                          std::string & error)
+{
+  for (const auto & c : coordinates)
+  {
+    if (!std::isfinite(c))
+    {
+      error = "non-finite axis coordinate";
+      return false;
+    }
+  }
+
+  reversed = coordinates.size() > 1 && coordinates.back() < coordinates.front();
+  if (reversed)
+  {
+    std::reverse(coordinates.begin(), coordinates.end());
+  }
+  for (size_t i = 1; i < coordinates.size(); ++i)
+  {
+    if (!(coordinates[i] > coordinates[i - 1]))
+    {
+      error = "axis coordinates must be strictly monotonic";
+      return false;
+    }
+  }
+
+  axis.coordinates = coordinates;
+  axis.uniform = false;
+  axis.inv_spacing = 0.0;
+  if (coordinates.size() < 2)
+  {
+    return true;
+  }
+
+  const double spacing =
+    (coordinates.back() - coordinates.front()) / static_cast<double>(coordinates.size() - 1);
+  axis.uniform = true;
+  for (size_t i = 0; i < coordinates.size(); ++i)
+  {
+    const double expected = coordinates.front() + static_cast<double>(i) * spacing;
+    if (std::abs(coordinates[i] - expected) > uniform_tolerance * spacing)
+    {
+      axis.uniform = false;
+      break;
+    }
+  }
+  axis.inv_spacing = 1.0 / spacing;
+  return true;
+}
+
+bool SurfaceMap::Axis::locate(double value, size_t & index, double & t) const
+{
+  const size_t n = coordinates.size();
+  if (n < 2)
+  {
+    index = 0;
+    t = 0.0;
+    return true;
+  }
+
+  // Written such that NaN ends up in the first cell
+  if (!(value > coordinates.front()))
+  {
+    index = 0;
+    t = 0.0;
+    return value == coordinates.front();
+  }
+  if (value >= coordinates.back())
+  {
+    index = n - 2;
+    t = 1.0;
+    return value == coordinates.back();
+  }
+
+  if (uniform)
+  {
+    index = std::min(static_cast<size_t>((value - coordinates.front()) * inv_spacing), n - 2);
+  }
+  else
+  {
+    index = std::upper_bound(coordinates.begin(), coordinates.end(), value) -
+            coordinates.begin() - 1;
+  }
+  t = (value - coordinates[index]) / (coordinates[index + 1] - coordinates[index]);
+  t = std::min(std::max(t, 0.0), 1.0);
+  return true;
+}
+
+void SurfaceMap::sample(double x, double y, Sample & sample) const
+{
+  size_t i = 0;
+  size_t j = 0;
+  double tx = 0.0;
+  double ty = 0.0;
+  const bool inside_x = m_x.locate(x, i, tx);
+  const bool inside_y = m_y.locate(y, j, ty);
+
+  const Cell & cell = m_cells[i * cellsY() + j];
+  sample.z = bilinear(cell.z, tx, ty);
+  sample.stiffness = bilinear(cell.stiffness, tx, ty);
+  sample.damping = bilinear(cell.damping, tx, ty);
+
+  // The surface is unknown outside the grid, so assume it flat there
+  sample.dz_dx = 0.0;
+  sample.dz_dy = 0.0;
+  if (inside_x && sizeX() > 1)
+  {
+    sample.dz_dx = (cell.z[1] + cell.z[3] * ty) / (m_x.coordinates[i + 1] - m_x.coordinates[i]);
+  }
+  if (inside_y && sizeY() > 1)
+  {
+    sample.dz_dy = (cell.z[2] + cell.z[3] * tx) / (m_y.coordinates[j + 1] - m_y.coordinates[j]);
+  }
+}
+
+}  // namespace cartesian_adaptive_compliance_controller
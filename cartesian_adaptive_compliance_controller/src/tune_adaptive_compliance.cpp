@@ -0,0 +1,397 @@
+/*
+ * Replay a recorded trajectory through the stiffness optimization and the
+ * energy tank of the adaptive compliance controller for a grid of
+ * parameters, in parallel on all cores.
+ *
+ * Usage: tune_adaptive_compliance <recording> <surface map> [options]
+ *
+ * The recording is a text table with one header line of column names and
+ * one control cycle per line, separated by commas or whitespace. It needs the
+ * data log's columns time, x, y, z, x_d, y_d, z_d, xdot_x, xdot_y, xdot_z and F_ft_z.
+ * The replay is open loop, i.e. the recorded motion doesn't react to the
+ * stiffness.
+ *
+ * Options:
+ *   --map_format text|binary  The surface map format (default binary)
+ *   --qp_solver qpoases|explicit  (default qpoases)
+ *   --threads <n>  (default all cores)
+ *   --Q, --R, --kd_min, --kd_max, --F_max <values>
+ *     Comma-separated grid values. Each is either one value for all axes or
+ *     three values x:y:z.
+ *   --max_pen, --power_limit, --tank_threshold <values>
+ *     Comma-separated grid values.
+ *
+ * Parameters without grid values keep the controller's defaults.
+ * Prints one line per configuration, ordered by the RMS force tracking error.
+ */
+
+#include <cartesian_adaptive_compliance_controller/data_reader.h>
+#include <cartesian_adaptive_compliance_controller/stiffness_optimizer.h>
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace cartesian_adaptive_compliance_controller;
+
+namespace
+{
+struct Sample
+{
+  double time;
+  ctrl::Vector3D x;
+  ctrl::Vector3D x_d;
+  ctrl::Vector3D x_dot;
+  double ft_z;
+};
+
+struct Result
+{
+  double force_rms;
+  double force_max;
+  unsigned long depletions;  // Cycles that start with an empty tank after a non-empty one
+  unsigned long qp_failures;
+  double min_tank;
+  double mean_qp_time;  // seconds
+};
+
+std::vector<std::string> split(const std::string & text, const std::string & separators)
+{
+  std::vector<std::string> tokens;
+  size_t begin = text.find_first_not_of(separators);
+  while (begin != std::string::npos)
+  {
+    const size_t end = text.find_first_of(separators, begin);
+    tokens.push_back(text.substr(begin, end - begin));
+    begin = text.find_first_not_of(separators, end);
+  }
+  return tokens;
+}
+
+bool readRecording(const std::string & path, std::vector<Sample> & samples, std::string & error)
+{
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+
+  const std::vector<std::string> header = split(line, ", \t\r");
+  const std::vector<std::string> names = {"time",   "x",      "y",      "z",
+                                          "x_d",    "y_d",    "z_d",    "xdot_x",
+                                          "xdot_y", "xdot_z", "F_ft_z"};
+  std::vector<size_t> columns;
+  for (const std::string & name : names)
+  {
+    const auto it = std::find(header.begin(), header.end(), name);
+    if (it == header.end())
+    {
+      error = "missing column " + name;
+      return false;
+    }
+    columns.push_back(static_cast<size_t>(it - header.begin()));
+  }
+
+  while (std::getline(file, line))
+  {
+    const std::vector<std::string> tokens = split(line, ", \t\r");
+    if (tokens.empty())
+    {
+      continue;
+    }
+    if (tokens.size() != header.size())
+    {
+      error = "line " + std::to_string(samples.size() + 2) + " has " +
+              std::to_string(tokens.size()) + " instead of " + std::to_string(header.size()) +
+              " values";
+      return false;
+    }
+    double v[11];
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+      v[i] = std::stod(tokens[columns[i]]);
+    }
+    samples.push_back({v[0], {v[1], v[2], v[3]}, {v[4], v[5], v[6]}, {v[7], v[8], v[9]}, v[10]});
+  }
+
+  if (samples.size() < 2)
+  {
+    error = "need at least two samples";
+    return false;
+  }
+  return true;
+}
+
+bool parseVectors(const std::string & text, std::vector<ctrl::Vector3D> & values)
+{
+  values.clear();
+  for (const std::string & value : split(text, ","))
+  {
+    const std::vector<std::string> axes = split(value, ":");
+    if (axes.size() == 1)
+    {
+      values.push_back(ctrl::Vector3D::Constant(std::stod(axes[0])));
+    }
+    else if (axes.size() == 3)
+    {
+      values.push_back({std::stod(axes[0]), std::stod(axes[1]), std::stod(axes[2])});
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return !values.empty();
+}
+
+bool parseScalars(const std::string & text, std::vector<double> & values)
+{
+  values.clear();
+  for (const std::string & value : split(text, ","))
+  {
+    values.push_back(std::stod(value));
+  }
+  return !values.empty();
+}
+
+Result replay(const std::vector<Sample> & samples, const SurfaceMap & map,
+              const StiffnessParameters & parameters)
+{
+  StiffnessOptimizer optimizer;
+  EnergyTank tank;
+  optimizer.reset(parameters, &map);
+  tank.reset(parameters);
+
+  Result result = {0.0, 0.0, 0, 0, tank.energy(), 0.0};
+  ctrl::Vector3D damping = 2.0 * 0.707 * parameters.kd_min.cwiseSqrt();
+  StiffnessState state;
+  StiffnessSolution solution;
+  bool depleted = false;
+  double squared_error = 0.0;
+  double qp_time = 0.0;
+  for (size_t i = 1; i < samples.size(); ++i)
+  {
+    const Sample & sample = samples[i];
+    state.time = sample.time;
+    state.deltaT = sample.time - samples[i - 1].time;
+    state.x = sample.x;
+    state.x_d = sample.x_d;
+    state.x_dot = sample.x_dot;
+    state.damping = damping;
+    state.ft_z = sample.ft_z;
+    state.tank_energy = tank.energy();
+    state.energy_var_damping = tank.dampingPower(sample.x_dot, damping);
+
+    optimizer.solve(state, solution);
+    const EnergyTank::Step step = tank.step(state, solution, false);
+    damping = 2.0 * 0.707 * step.kd.cwiseSqrt();
+
+    // The force the stiffness commands along z, as in the data log
+    const double force =
+      step.kd(2) * (state.x_d(2) - state.x(2)) - damping(2) * state.x_dot(2);
+    const double error = force - solution.F_ref;
+    squared_error += error * error;
+    result.force_max = std::max(result.force_max, std::abs(error));
+    result.depletions += step.depleted && !depleted;
+    depleted = step.depleted;
+    result.min_tank = std::min(result.min_tank, tank.energy());
+    qp_time += solution.qp_cputime;
+  }
+  result.force_rms = std::sqrt(squared_error / (samples.size() - 1));
+  result.qp_failures = solution.qp_failures;
+  result.mean_qp_time = qp_time / (samples.size() - 1);
+  return result;
+}
+
+std::string format(const ctrl::Vector3D & v)
+{
+  std::ostringstream text;
+  text << v(0) << ":" << v(1) << ":" << v(2);
+  return text.str();
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  if (argc < 3 || (argc - 3) % 2 != 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " <recording> <surface map> [--option values]..."
+              << std::endl;
+    return 1;
+  }
+
+  const StiffnessParameters defaults;
+  std::map<std::string, std::vector<ctrl::Vector3D>> vectors = {
+    {"--Q", {defaults.Q}},
+    {"--R", {defaults.R}},
+    {"--kd_min", {defaults.kd_min}},
+    {"--kd_max", {defaults.kd_max}},
+    {"--F_max", {defaults.F_max}}};
+  std::map<std::string, std::vector<double>> scalars = {
+    {"--max_pen", {defaults.max_pen}},
+    {"--power_limit", {defaults.power_limit}},
+    {"--tank_threshold", {defaults.tank_energy_threshold}}};
+  std::string map_format = "binary";
+  std::string qp_solver = "qpoases";
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 3; i < argc; i += 2)
+  {
+    const std::string option = argv[i];
+    const std::string value = argv[i + 1];
+    bool valid = true;
+    try
+    {
+      if (vectors.count(option))
+      {
+        valid = parseVectors(value, vectors[option]);
+      }
+      else if (scalars.count(option))
+      {
+        valid = parseScalars(value, scalars[option]);
+      }
+      else if (option == "--map_format")
+      {
+        map_format = value;
+        valid = value == "text" || value == "binary";
+      }
+      else if (option == "--qp_solver")
+      {
+        qp_solver = value;
+        valid = value == "qpoases" || value == "explicit";
+      }
+      else if (option == "--threads")
+      {
+        threads = static_cast<unsigned>(std::max(1, std::stoi(value)));
+      }
+      else
+      {
+        std::cerr << "Unknown option " << option << std::endl;
+        return 1;
+      }
+    }
+    catch (const std::exception &)
+    {
+      valid = false;
+    }
+    if (!valid)
+    {
+      std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Sample> samples;
+  std::string error;
+  if (!readRecording(argv[1], samples, error))
+  {
+    std::cerr << "Invalid recording: " << error << std::endl;
+    return 1;
+  }
+
+  SurfaceMap map;
+  bool loaded;
+  if (map_format == "binary")
+  {
+    loaded = map.load(argv[2], error);
+  }
+  else
+  {
+    std::vector<double> x, y, z, stiffness, damping;
+    dataReader(argv[2], x, y, z, stiffness, damping);
+    loaded = map.init(x, y, z, stiffness, damping, error);
+  }
+  if (!loaded)
+  {
+    std::cerr << "Invalid surface map: " << error << std::endl;
+    return 1;
+  }
+
+  // The full parameter grid
+  std::vector<StiffnessParameters> configurations;
+  for (const auto & Q : vectors["--Q"])
+    for (const auto & R : vectors["--R"])
+      for (const auto & kd_min : vectors["--kd_min"])
+        for (const auto & kd_max : vectors["--kd_max"])
+          for (const auto & F_max : vectors["--F_max"])
+            for (const double max_pen : scalars["--max_pen"])
+              for (const double power_limit : scalars["--power_limit"])
+                for (const double threshold : scalars["--tank_threshold"])
+                {
+                  if ((kd_min.array() > kd_max.array()).any())
+                  {
+                    continue;
+                  }
+                  StiffnessParameters p;
+                  p.Q = Q;
+                  p.R = R;
+                  p.kd_min = kd_min;
+                  p.kd_max = kd_max;
+                  p.F_max = F_max;
+                  p.max_pen = max_pen;
+                  p.power_limit = power_limit;
+                  p.tank_energy_threshold = threshold;
+                  p.explicit_qp = qp_solver == "explicit";
+                  configurations.push_back(p);
+                }
+  threads = std::min<unsigned>(threads, std::max<size_t>(configurations.size(), 1));
+  std::cerr << "Replaying " << samples.size() << " samples for " << configurations.size()
+            << " configurations on " << threads << " threads" << std::endl;
+
+  // Each worker takes the next open configuration
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Result> results(configurations.size());
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    workers.emplace_back(
+      [&]()
+      {
+        for (size_t i = next++; i < configurations.size(); i = next++)
+        {
+          results[i] = replay(samples, map, configurations[i]);
+        }
+      });
+  }
+  for (std::thread & worker : workers)
+  {
+    worker.join();
+  }
+  const double duration =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Finished in " << duration << " s" << std::endl;
+
+  std::vector<size_t> order(configurations.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                   { return results[a].force_rms < results[b].force_rms; });
+
+  std::cout << "Q R kd_min kd_max F_max max_pen power_limit tank_threshold "
+               "force_rms force_max depletions qp_failures min_tank mean_qp_time"
+            << std::endl;
+  for (const size_t i : order)
+  {
+    const StiffnessParameters & p = configurations[i];
+    const Result & r = results[i];
+    std::cout << format(p.Q) << " " << format(p.R) << " " << format(p.kd_min) << " "
+              << format(p.kd_max) << " " << format(p.F_max) << " " << p.max_pen << " "
+              << p.power_limit << " " << p.tank_energy_threshold << " " << r.force_rms << " "
+              << r.force_max << " " << r.depletions << " " << r.qp_failures << " "
+              << r.min_tank << " " << r.mean_qp_time << std::endl;
+  }
+  return 0;
+}
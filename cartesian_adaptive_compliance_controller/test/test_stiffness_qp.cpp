@@ -0,0 +1,144 @@
+#include <cartesian_adaptive_compliance_controller/qpOASES.hpp>
+#include <cartesian_adaptive_compliance_controller/stiffness_qp.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using cartesian_adaptive_compliance_controller::StiffnessQP;
+
+namespace
+{
+struct Problem
+{
+  double H[9];
+  double g[3];
+  double A[15];
+  double lb[3];
+  double ub[3];
+  double lbA[5];
+  double ubA[5];
+};
+
+// Mimics CartesianAdaptiveComplianceController::computeStiffness
+Problem randomProblem(std::mt19937 & rng)
+{
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  auto uniform = [&](double a, double b) { return a + (b - a) * unit(rng); };
+
+  const double Q = 3200;
+  const double R = 0.00001;
+  const double kd_min[3] = {300, 300, 100};
+  const double kd_max[3] = {1000, 1000, 1000};
+  const double F_max = 15;
+  const double delta_t = 0.002;
+  const double power_limit = 0.1;
+  const double threshold = 0.4;
+
+  double e[3], v[3], d[3], F_ref[3] = {0, 0, 0};
+  for (int i = 0; i < 3; ++i)
+  {
+    e[i] = uniform(-0.01, 0.01);
+    v[i] = uniform(-0.05, 0.05);
+    d[i] = 2.0 * 0.707 * std::sqrt(uniform(kd_min[i], kd_max[i]));
+  }
+  const bool contact = unit(rng) < 0.5;
+  F_ref[2] = contact ? uniform(-12, 0) : 0.0;
+  const double F_min_z = contact ? -9 : -F_max;
+
+  // Near the threshold, the tank constraints become active. Below, they are often infeasible.
+  const double mode = unit(rng);
+  const double tank = mode < 0.4   ? uniform(threshold, 1.2)
+                      : mode < 0.8 ? threshold + uniform(0, 1e-5)
+                                   : threshold - uniform(0, 0.01);
+  const double sigma = tank >= 1.0 ? 0.0 : 1.0;
+
+  double damping_power = 0.0;
+  double min_stiffness_power = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    damping_power += sigma * d[i] * v[i] * v[i];
+    min_stiffness_power += e[i] * kd_min[i] * v[i];
+  }
+
+  Problem p = {};
+  for (int i = 0; i < 3; ++i)
+  {
+    p.H[i * 3 + i] = R + Q * e[i] * e[i];
+    p.g[i] = -kd_min[i] * R + (-F_ref[i] + d[i] * v[i]) * e[i] * Q;
+    p.lb[i] = kd_min[i];
+    p.ub[i] = kd_max[i];
+    p.A[i * 3 + i] = e[i];
+    p.A[9 + i] = e[i] * v[i];
+    p.A[12 + i] = e[i] * v[i];
+    p.lbA[i] = (i == 2 ? F_min_z : -F_max) - d[i] * v[i];
+    p.ubA[i] = F_max - d[i] * v[i];
+  }
+  p.lbA[3] = -damping_power + min_stiffness_power + (threshold - tank) / delta_t;
+  p.lbA[4] = -damping_power + min_stiffness_power - power_limit;
+  p.ubA[3] = 1e9;
+  p.ubA[4] = 1e9;
+  return p;
+}
+}  // namespace
+
+TEST(StiffnessQP, AgreesWithQpOASES)
+{
+  USING_NAMESPACE_QPOASES
+
+  Options options;
+  options.printLevel = PL_NONE;
+  QProblem qp(3, 5);
+  qp.setOptions(options);
+
+  std::mt19937 rng(42);
+  int solved = 0;
+  int tank_active = 0;
+  for (int k = 0; k < 5000; ++k)
+  {
+    const Problem p = randomProblem(rng);
+
+    double x_explicit[3];
+    const StiffnessQP::Status status =
+      StiffnessQP::solve(p.H, p.g, p.A, p.lb, p.ub, p.lbA, p.ubA, x_explicit);
+    ASSERT_NE(status, StiffnessQP::Status::Unsupported);
+
+    double x_qpoases[3];
+    int_t nWSR = 100;
+    qp.reset();
+    if (qp.init(p.H, p.g, p.A, p.lb, p.ub, p.lbA, p.ubA, nWSR) != SUCCESSFUL_RETURN)
+    {
+      // qpOASES may fail for numerical reasons on feasible problems
+      continue;
+    }
+    qp.getPrimalSolution(x_qpoases);
+
+    ASSERT_EQ(status, StiffnessQP::Status::Success) << "problem " << k;
+    double power = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+      EXPECT_NEAR(x_explicit[i], x_qpoases[i], 1e-6 * std::max(1.0, std::abs(x_qpoases[i])))
+        << "problem " << k << ", stiffness " << i;
+      power += p.A[9 + i] * x_explicit[i];
+    }
+    const double bound = std::max(p.lbA[3], p.lbA[4]);
+    tank_active += std::abs(power - bound) <= 1e-9 * (1.0 + std::abs(bound));
+    ++solved;
+  }
+
+  // Most problems are feasible, and the tank constraint matters in some of them
+  EXPECT_GT(solved, 2500);
+  EXPECT_GT(tank_active, 100);
+}
+
+TEST(StiffnessQP, RejectsOtherStructures)
+{
+  std::mt19937 rng(7);
+  Problem p = randomProblem(rng);
+  p.H[1] = 1.0;
+
+  double x[3];
+  EXPECT_EQ(StiffnessQP::solve(p.H, p.g, p.A, p.lb, p.ub, p.lbA, p.ubA, x),
+            StiffnessQP::Status::Unsupported);
+}
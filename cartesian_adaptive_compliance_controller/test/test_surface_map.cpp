@@ -0,0 +1,114 @@
+#include <cartesian_adaptive_compliance_controller/surface_map.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using cartesian_adaptive_compliance_controller::SurfaceMap;
+
+namespace
+{
+// Bilinear in x and y, so that the interpolation reproduces it exactly
+double height(double x, double y) { return 0.01 + 0.2 * x - 0.1 * y + 3.0 * x * y; }
+double stiffness(double x, double y) { return 500.0 + 1000.0 * x + 2000.0 * y; }
+double damping(double x, double y) { return 20.0 - 100.0 * x; }
+
+bool build(SurfaceMap & map, const std::vector<double> & x, const std::vector<double> & y)
+{
+  std::vector<double> z, k, d;
+  for (double xi : x)
+  {
+    for (double yj : y)
+    {
+      z.push_back(height(xi, yj));
+      k.push_back(stiffness(xi, yj));
+      d.push_back(damping(xi, yj));
+    }
+  }
+  std::string error;
+  return map.init(x, y, z, k, d, error);
+}
+
+void expectSample(const SurfaceMap & map, double x, double y)
+{
+  SurfaceMap::Sample sample;
+  map.sample(x, y, sample);
+  EXPECT_NEAR(sample.z, height(x, y), 1e-12) << "at " << x << ", " << y;
+  EXPECT_NEAR(sample.stiffness, stiffness(x, y), 1e-3) << "at " << x << ", " << y;
+  EXPECT_NEAR(sample.damping, damping(x, y), 1e-4) << "at " << x << ", " << y;
+  EXPECT_NEAR(sample.dz_dx, 0.2 + 3.0 * y, 1e-9) << "at " << x << ", " << y;
+  EXPECT_NEAR(sample.dz_dy, -0.1 + 3.0 * x, 1e-9) << "at " << x << ", " << y;
+}
+}  // namespace
+
+TEST(SurfaceMap, InterpolatesUniformGrids)
+{
+  SurfaceMap map;
+  ASSERT_TRUE(build(map, {0.0, 0.01, 0.02, 0.03}, {0.0, 0.01, 0.02}));
+  EXPECT_TRUE(map.uniform());
+  EXPECT_EQ(map.sizeX(), 4u);
+  EXPECT_EQ(map.sizeY(), 3u);
+
+  expectSample(map, 0.0, 0.0);
+  expectSample(map, 0.01, 0.02);
+  expectSample(map, 0.0125, 0.0031);
+  expectSample(map, 0.029, 0.0199);
+}
+
+TEST(SurfaceMap, InterpolatesNonUniformAndDescendingGrids)
+{
+  SurfaceMap map;
+  ASSERT_TRUE(build(map, {0.03, 0.01, 0.005, 0.0}, {0.0, 0.002, 0.02}));
+  EXPECT_FALSE(map.uniform());
+
+  expectSample(map, 0.004, 0.001);
+  expectSample(map, 0.02, 0.015);
+  expectSample(map, 0.007, 0.002);
+}
+
+TEST(SurfaceMap, HoldsTheBorderOutsideTheGrid)
+{
+  SurfaceMap map;
+  ASSERT_TRUE(build(map, {0.0, 0.01, 0.02}, {0.0, 0.01, 0.02}));
+
+  // Beyond x, with the gradient along the border in y
+  SurfaceMap::Sample sample;
+  map.sample(0.05, 0.005, sample);
+  EXPECT_NEAR(sample.z, height(0.02, 0.005), 1e-12);
+  EXPECT_NEAR(sample.stiffness, stiffness(0.02, 0.005), 1e-3);
+  EXPECT_DOUBLE_EQ(sample.dz_dx, 0.0);
+  EXPECT_NEAR(sample.dz_dy, -0.1 + 3.0 * 0.02, 1e-9);
+
+  // Beyond both
+  map.sample(-1.0, -1.0, sample);
+  EXPECT_NEAR(sample.z, height(0.0, 0.0), 1e-12);
+  EXPECT_DOUBLE_EQ(sample.dz_dx, 0.0);
+  EXPECT_DOUBLE_EQ(sample.dz_dy, 0.0);
+}
+
+TEST(SurfaceMap, RejectsInconsistentLayers)
+{
+  SurfaceMap map;
+  std::string error;
+  EXPECT_FALSE(map.init({0.0, 0.01}, {0.0, 0.01}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0, 1.0},
+                        {1.0, 1.0, 1.0, 1.0}, error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(SurfaceMap, LoadsWhatItSaves)
+{
+  SurfaceMap saved;
+  ASSERT_TRUE(build(saved, {0.0, 0.01, 0.02, 0.03}, {0.0, 0.01, 0.02}));
+
+  const std::string filename = testing::TempDir() + "test_surface_map.bin";
+  std::string error;
+  ASSERT_TRUE(saved.save(filename, error)) << error;
+
+  SurfaceMap loaded;
+  ASSERT_TRUE(loaded.load(filename, error)) << error;
+  EXPECT_EQ(loaded.sizeX(), 4u);
+  EXPECT_EQ(loaded.sizeY(), 3u);
+  expectSample(loaded, 0.0125, 0.0031);
+  std::remove(filename.c_str());
+}
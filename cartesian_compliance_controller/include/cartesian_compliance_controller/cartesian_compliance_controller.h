@@ -40,15 +40,30 @@
 #ifndef CARTESIAN_COMPLIANCE_CONTROLLER_H_INCLUDED
 #define CARTESIAN_COMPLIANCE_CONTROLLER_H_INCLUDED
 
+#include <cartesian_controller_base/ImpedanceSchedule.h>
 #include <cartesian_controller_base/ROS2VersionConfig.h>
 #include <cartesian_controller_base/cartesian_controller_base.h>
 #include <cartesian_force_controller/cartesian_force_controller.h>
 #include <cartesian_motion_controller/cartesian_motion_controller.h>
 
 #include <controller_interface/controller_interface.hpp>
+#include <realtime_tools/realtime_buffer.h>
+
+#include "std_msgs/msg/float64_multi_array.hpp"
 
 namespace cartesian_compliance_controller
 {
+/**
+ * @brief Stiffness and damping of the virtual spring-damper system
+ *
+ * Both are symmetric 6x6 tensors, given w.r.t. the compliance_ref_link.
+ */
+struct Impedance
+{
+  ctrl::Matrix6D stiffness;
+  ctrl::Matrix6D damping;
+};
+
 /**
  * @brief A ROS2-control controller for Cartesian compliance control
  *
@@ -68,6 +83,13 @@ namespace cartesian_compliance_controller
  * To compensate for bigger offsets, users can set a low stiffness for the axes
  * where the additional forces are applied.
  *
+ * Besides the diagonal `stiffness` parameters, users can specify full
+ * symmetric 6x6 stiffness and damping matrices, either via parameters or via
+ * the `target_impedance` topic.  Both are only processed on change.
+ * For deterministic transitions along a task, users can upload a
+ * time-parameterized impedance schedule once via the `impedance_schedule`
+ * topic, which the controller interpolates in each control cycle.
+ *
  */
 class CartesianComplianceController : public cartesian_motion_controller::CartesianMotionController,
                                       public cartesian_force_controller::CartesianForceController
@@ -111,9 +133,46 @@ private:
      */
   ctrl::Vector6D computeComplianceError();
 
+  /**
+     * @brief Compute stiffness and damping from the given user input
+     *
+     * The damping defaults to critical damping of unit masses, i.e. \f$ D =
+     * 2\sqrt{K} \f$ with the matrix square root of the stiffness, if not
+     * given explicitly.
+     *
+     * @param stiffness Row-major 6x6 stiffness
+     * @param damping Row-major 6x6 damping. Leave empty for the default.
+     * @param impedance The resulting impedance
+     * @param error A description of what's wrong with the input
+     *
+     * @return False if the input is not symmetric and positive semi-definite
+     */
+  static bool computeImpedance(const std::vector<double> & stiffness,
+                               const std::vector<double> & damping, Impedance & impedance,
+                               std::string & error);
+
+  /**
+     * @brief Recompute the impedance when users change relevant parameters
+     */
+  rcl_interfaces::msg::SetParametersResult parametersCallback(
+    const std::vector<rclcpp::Parameter> & parameters);
+
+  void targetImpedanceCallback(const std_msgs::msg::Float64MultiArray::SharedPtr impedance);
+  void impedanceScheduleCallback(const std_msgs::msg::Float64MultiArray::SharedPtr schedule);
+
+  rclcpp::Subscription<std_msgs::msg::Float64MultiArray>::SharedPtr
+    m_target_impedance_subscriber;
+  rclcpp::Subscription<std_msgs::msg::Float64MultiArray>::SharedPtr
+    m_impedance_schedule_subscriber;
+  cartesian_controller_base::ImpedanceSchedule m_impedance_schedule;
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr m_parameters_callback;
+  realtime_tools::RealtimeBuffer<Impedance> m_impedance_buffer;
+
   ctrl::Matrix6D m_stiffness;
   ctrl::Matrix6D m_damping;
   std::string m_compliance_ref_link;
+  KDL::Frame m_compliance_ref_offset;
+  bool m_compliance_ref_is_static;
 };
 
 }  // namespace cartesian_compliance_controller
@@ -39,17 +39,29 @@
 
 #include <cartesian_compliance_controller/cartesian_compliance_controller.h>
 
+#include <Eigen/Eigenvalues>
+#include <array>
+#include <cmath>
+
 #include "cartesian_controller_base/Utility.h"
 #include "controller_interface/controller_interface.hpp"
 
 namespace cartesian_compliance_controller
 {
+namespace
+{
+const std::array<std::string, 6> stiffness_names = {
+  "stiffness.trans_x", "stiffness.trans_y", "stiffness.trans_z",
+  "stiffness.rot_x",   "stiffness.rot_y",   "stiffness.rot_z"};
+}
+
 CartesianComplianceController::CartesianComplianceController()
 // Base constructor won't be called in diamond inheritance, so call that
 // explicitly
 : Base::CartesianControllerBase(),
   MotionBase::CartesianMotionController(),
-  ForceBase::CartesianForceController()
+  ForceBase::CartesianForceController(),
+  m_compliance_ref_is_static(false)
 {
 }
 
@@ -75,6 +87,10 @@ CartesianComplianceController::on_init()
   auto_declare<double>("stiffness.rot_y", default_rot_stiff);
   auto_declare<double>("stiffness.rot_z", default_rot_stiff);
 
+  // Full 6x6 tensors in row-major order. Empty means unused.
+  auto_declare<std::vector<double>>("stiffness.matrix", std::vector<double>());
+  auto_declare<std::vector<double>>("damping.matrix", std::vector<double>());
+
   return TYPE::SUCCESS;
 }
 #elif defined CARTESIAN_CONTROLLERS_FOXY
@@ -88,6 +104,8 @@ controller_interface::return_type CartesianComplianceController::init(
   }
 
   auto_declare<std::string>("compliance_ref_link", "");
+  auto_declare<std::vector<double>>("stiffness.matrix", std::vector<double>());
+  auto_declare<std::vector<double>>("damping.matrix", std::vector<double>());
 
   return TYPE::OK;
 }
@@ -116,6 +134,28 @@ CartesianComplianceController::on_configure(const rclcpp_lifecycle::State & prev
 
   // Make sure sensor wrenches are interpreted correctly
   ForceBase::setFtSensorReferenceFrame(m_compliance_ref_link);
+  m_compliance_ref_is_static =
+    Base::getStaticOffset(m_compliance_ref_link, m_compliance_ref_offset);
+
+  // Initial impedance. Later changes are handled in the callbacks.
+  if (parametersCallback({}).successful == false)
+  {
+    return TYPE::ERROR;
+  }
+  m_parameters_callback = get_node()->add_on_set_parameters_callback(std::bind(
+    &CartesianComplianceController::parametersCallback, this, std::placeholders::_1));
+
+  m_target_impedance_subscriber =
+    get_node()->create_subscription<std_msgs::msg::Float64MultiArray>(
+      get_node()->get_name() + std::string("/target_impedance"), 3,
+      std::bind(&CartesianComplianceController::targetImpedanceCallback, this,
+                std::placeholders::_1));
+
+  m_impedance_schedule_subscriber =
+    get_node()->create_subscription<std_msgs::msg::Float64MultiArray>(
+      get_node()->get_name() + std::string("/impedance_schedule"), 3,
+      std::bind(&CartesianComplianceController::impedanceScheduleCallback, this,
+                std::placeholders::_1));
 
   return TYPE::SUCCESS;
 }
@@ -157,6 +197,17 @@ controller_interface::return_type CartesianComplianceController::update()
   // Synchronize the internal model and the real robot
   Base::m_ik_solver->synchronizeJointPositions(Base::m_joint_state_pos_handles);
 
+  // An impedance schedule has precedence over parameters and topic
+#if defined CARTESIAN_CONTROLLERS_FOXY
+  const rclcpp::Time time = get_node()->now();
+#endif
+  if (!m_impedance_schedule.sample(time, m_stiffness, m_damping))
+  {
+    const Impedance & impedance = *m_impedance_buffer.readFromRT();
+    m_stiffness = impedance.stiffness;
+    m_damping = impedance.damping;
+  }
+
   // Control the robot motion in such a way that the resulting net force
   // vanishes. This internal control needs some simulation time steps.
   for (int i = 0; i < Base::m_iterations; ++i)
@@ -180,29 +231,197 @@ controller_interface::return_type CartesianComplianceController::update()
 
 ctrl::Vector6D CartesianComplianceController::computeComplianceError()
 {
-  ctrl::Vector6D tmp;
-  tmp[0] = get_node()->get_parameter("stiffness.trans_x").as_double();
-  tmp[1] = get_node()->get_parameter("stiffness.trans_y").as_double();
-  tmp[2] = get_node()->get_parameter("stiffness.trans_z").as_double();
-  tmp[3] = get_node()->get_parameter("stiffness.rot_x").as_double();
-  tmp[4] = get_node()->get_parameter("stiffness.rot_y").as_double();
-  tmp[5] = get_node()->get_parameter("stiffness.rot_z").as_double();
-
-  m_stiffness = tmp.asDiagonal();
-  m_damping = 2.0 * m_stiffness.cwiseSqrt();
-  
+  // Share one forward kinematics pass between the tensors and the wrenches
+  const KDL::Rotation & last_joint = Base::computeLastJointFrame().M;
+
+  ctrl::Matrix6D stiffness;
+  ctrl::Matrix6D damping;
+  if (m_compliance_ref_is_static)
+  {
+    const KDL::Rotation compliance_ref = last_joint * m_compliance_ref_offset.M;
+    stiffness = Base::displayInBaseLink(m_stiffness, compliance_ref);
+    damping = Base::displayInBaseLink(m_damping, compliance_ref);
+  }
+  else
+  {
+    stiffness = Base::displayInBaseLink(m_stiffness, m_compliance_ref_link);
+    damping = Base::displayInBaseLink(m_damping, m_compliance_ref_link);
+  }
+
   ctrl::Vector6D net_force =
     // Spring force in base orientation
-    Base::displayInBaseLink(m_stiffness, m_compliance_ref_link) * MotionBase::computeMotionError()
+    stiffness * MotionBase::computeMotionError()
     // Damping force in base orientation
-    - Base::displayInBaseLink(m_damping, m_compliance_ref_link) *
-        Base::m_ik_solver->getEndEffectorVel()
+    - damping * Base::m_ik_solver->getEndEffectorVel()
     // Sensor and target force in base orientation
-    + ForceBase::computeForceError();
+    + ForceBase::computeForceError(last_joint);
 
   return net_force;
 }
 
+bool CartesianComplianceController::computeImpedance(const std::vector<double> & stiffness,
+                                                     const std::vector<double> & damping,
+                                                     Impedance & impedance, std::string & error)
+{
+  using RowMajorMap = Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>>;
+  auto symmetric = [](const ctrl::Matrix6D & m) { return m.isApprox(m.transpose(), 1e-9); };
+
+  if (stiffness.size() != 36)
+  {
+    error = "Stiffness needs 36 entries, got " + std::to_string(stiffness.size());
+    return false;
+  }
+  impedance.stiffness = RowMajorMap(stiffness.data());
+  if (!symmetric(impedance.stiffness))
+  {
+    error = "Stiffness is not symmetric";
+    return false;
+  }
+
+  // The eigenvalues of symmetric matrices are real.  Use them to check for
+  // positive semi-definiteness and to compute the matrix square root.
+  Eigen::SelfAdjointEigenSolver<ctrl::Matrix6D> eigen(impedance.stiffness);
+  if (eigen.eigenvalues().minCoeff() < 0.0)
+  {
+    error = "Stiffness is not positive semi-definite";
+    return false;
+  }
+
+  if (damping.empty())
+  {
+    impedance.damping = 2.0 * eigen.operatorSqrt();
+    return true;
+  }
+
+  if (damping.size() != 36)
+  {
+    error = "Damping needs 36 entries, got " + std::to_string(damping.size());
+    return false;
+  }
+  impedance.damping = RowMajorMap(damping.data());
+  if (!symmetric(impedance.damping))
+  {
+    error = "Damping is not symmetric";
+    return false;
+  }
+  if (Eigen::SelfAdjointEigenSolver<ctrl::Matrix6D>(impedance.damping, Eigen::EigenvaluesOnly)
+        .eigenvalues()
+        .minCoeff() < 0.0)
+  {
+    error = "Damping is not positive semi-definite";
+    return false;
+  }
+  return true;
+}
+
+rcl_interfaces::msg::SetParametersResult CartesianComplianceController::parametersCallback(
+  const std::vector<rclcpp::Parameter> & parameters)
+{
+  rcl_interfaces::msg::SetParametersResult result;
+  result.successful = true;
+
+  // Parameters are not yet set when this callback is called.
+  // Combine the current ones with those about to change.
+  ctrl::Vector6D diagonal;
+  for (size_t i = 0; i < stiffness_names.size(); ++i)
+  {
+    diagonal[i] = get_node()->get_parameter(stiffness_names[i]).as_double();
+  }
+  std::vector<double> stiffness = get_node()->get_parameter("stiffness.matrix").as_double_array();
+  std::vector<double> damping = get_node()->get_parameter("damping.matrix").as_double_array();
+
+  bool relevant = parameters.empty();
+  for (const auto & parameter : parameters)
+  {
+    for (size_t i = 0; i < stiffness_names.size(); ++i)
+    {
+      if (parameter.get_name() == stiffness_names[i])
+      {
+        diagonal[i] = parameter.as_double();
+        relevant = true;
+      }
+    }
+    if (parameter.get_name() == "stiffness.matrix")
+    {
+      stiffness = parameter.as_double_array();
+      relevant = true;
+    }
+    if (parameter.get_name() == "damping.matrix")
+    {
+      damping = parameter.as_double_array();
+      relevant = true;
+    }
+  }
+
+  if (!relevant)
+  {
+    return result;
+  }
+
+  // The full matrix has precedence over the diagonal entries.
+  if (stiffness.empty())
+  {
+    ctrl::Matrix6D tmp = diagonal.asDiagonal();
+    stiffness.assign(tmp.data(), tmp.data() + tmp.size());
+  }
+
+  Impedance impedance;
+  if (!computeImpedance(stiffness, damping, impedance, result.reason))
+  {
+    RCLCPP_ERROR(get_node()->get_logger(), "Rejecting impedance: %s", result.reason.c_str());
+    result.successful = false;
+    return result;
+  }
+  m_impedance_buffer.writeFromNonRT(impedance);
+  return result;
+}
+
+void CartesianComplianceController::targetImpedanceCallback(
+  const std_msgs::msg::Float64MultiArray::SharedPtr impedance)
+{
+  if (!this->isActive())
+  {
+    return;
+  }
+
+  // Stiffness, optionally followed by damping.
+  const auto & data = impedance->data;
+  if (data.size() != 36 && data.size() != 72)
+  {
+    auto & clock = *get_node()->get_clock();
+    RCLCPP_WARN_STREAM_THROTTLE(get_node()->get_logger(), clock, 3000,
+                                "Target impedance needs 36 or 72 entries. Ignoring input.");
+    return;
+  }
+  std::vector<double> stiffness(data.begin(), data.begin() + 36);
+  std::vector<double> damping(data.begin() + 36, data.end());
+
+  Impedance tmp;
+  std::string error;
+  if (!computeImpedance(stiffness, damping, tmp, error))
+  {
+    auto & clock = *get_node()->get_clock();
+    RCLCPP_WARN_STREAM_THROTTLE(get_node()->get_logger(), clock, 3000,
+                                "Invalid target impedance: " << error << ". Ignoring input.");
+    return;
+  }
+  m_impedance_buffer.writeFromNonRT(tmp);
+}
+
+void CartesianComplianceController::impedanceScheduleCallback(
+  const std_msgs::msg::Float64MultiArray::SharedPtr schedule)
+{
+  std::string error;
+  if (!m_impedance_schedule.set(*schedule, error))
+  {
+    RCLCPP_WARN_STREAM(get_node()->get_logger(),
+                       "Invalid impedance schedule: " << error << ". Ignoring input.");
+    return;
+  }
+  RCLCPP_INFO(get_node()->get_logger(), schedule->data.empty() ? "Cleared impedance schedule"
+                                                                 : "Started impedance schedule");
+}
+
 }  // namespace cartesian_compliance_controller
 
 // Pluginlib
@@ -0,0 +1,110 @@
+#ifndef IMPEDANCE_SCHEDULE_H_INCLUDED
+#define IMPEDANCE_SCHEDULE_H_INCLUDED
+
+#include <cartesian_controller_base/Utility.h>
+#include <realtime_tools/realtime_buffer.h>
+
+#include <cstdint>
+#include <rclcpp/time.hpp>
+#include <string>
+#include <vector>
+
+#include "std_msgs/msg/float64_multi_array.hpp"
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief A time-parameterized sequence of stiffness and damping setpoints
+ *
+ * Users upload the whole sequence once, e.g. via topic, and the controller
+ * samples it in each control cycle.  Stiffness and damping are linearly
+ * interpolated between neighboring setpoints, which keeps symmetric, positive
+ * semi-definite tensors in that class.  Before the first setpoint, the first
+ * one applies.  After the last setpoint, the last one is held until a new
+ * schedule arrives or the schedule is cleared.
+ *
+ * Uploading is not realtime-safe and validates the input.  Sampling is
+ * realtime-safe. It neither allocates memory nor blocks.
+ */
+class ImpedanceSchedule
+{
+public:
+  struct Setpoint
+  {
+    double time;  //!< Seconds since the schedule's start
+    ctrl::Matrix6D stiffness;
+    ctrl::Matrix6D damping;
+  };
+
+  /**
+     * @brief Create an empty schedule
+     *
+     * @param damping_ratio Scales the default damping of setpoints without damping
+     */
+  explicit ImpedanceSchedule(double damping_ratio = 1.0);
+
+  /**
+     * @brief Replace the current schedule
+     *
+     * Call this from non-realtime threads. The new schedule starts on the next
+     * call to \ref sample.  An empty sequence clears the schedule.
+     *
+     * @param setpoints Setpoints with strictly increasing, non-negative times
+     * @param error A description of what's wrong with the input
+     *
+     * @return False if the setpoints are invalid. The current schedule is kept.
+     */
+  bool set(const std::vector<Setpoint> & setpoints, std::string & error);
+
+  /**
+     * @brief Replace the current schedule with the content of a message
+     *
+     * Each row holds the time, the row-major 6x6 stiffness and, optionally,
+     * the row-major 6x6 damping, i.e. 37 or 73 entries.  The first layout
+     * dimension gives the number of rows, the second the row's size.
+     * Without damping, unit masses get the schedule's damping ratio
+     * \f$ \zeta \f$, i.e. \f$ D = 2\zeta\sqrt{K} \f$ with the matrix square
+     * root of the stiffness.  That's critical damping by default.
+     *
+     * @param msg The message with the setpoints
+     * @param error A description of what's wrong with the input
+     *
+     * @return False if the message is invalid. The current schedule is kept.
+     */
+  bool set(const std_msgs::msg::Float64MultiArray & msg, std::string & error);
+
+  /**
+     * @brief Sample the schedule in the control cycle
+     *
+     * Realtime-safe.
+     *
+     * @param time The current time
+     * @param stiffness The interpolated stiffness. Unchanged without schedule.
+     * @param damping The interpolated damping. Unchanged without schedule.
+     *
+     * @return False if there's no schedule
+     */
+  bool sample(const rclcpp::Time & time, ctrl::Matrix6D & stiffness, ctrl::Matrix6D & damping);
+
+private:
+  struct Sequence
+  {
+    std::vector<Setpoint> setpoints;
+    uint64_t id = 0;
+  };
+
+  realtime_tools::RealtimeBuffer<Sequence> m_buffer;
+
+  // Non-realtime side
+  double m_damping_ratio;
+  uint64_t m_next_id;
+
+  // Realtime side
+  uint64_t m_active_id;
+  rclcpp::Time m_start;
+  size_t m_cursor;
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef MEASURED_STATE_KINEMATICS_H_INCLUDED
+#define MEASURED_STATE_KINEMATICS_H_INCLUDED
+
+#include <functional>
+#include <hardware_interface/loaned_state_interface.hpp>
+#include <kdl/chain.hpp>
+#include <kdl/chainfksolvervel_recursive.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/jntarrayvel.hpp>
+#include <memory>
+#include <vector>
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief Forward kinematics of the robot's measured joint state
+ *
+ * The IK solvers keep a simulated joint state. Controllers that need the
+ * measured end-effector pose and twist get them from here, computed once per
+ * control cycle into buffers that are allocated on initialization.
+ */
+class MeasuredStateKinematics
+{
+public:
+  using StateHandles =
+    std::vector<std::reference_wrapper<hardware_interface::LoanedStateInterface>>;
+
+  MeasuredStateKinematics();
+
+  /**
+     * @brief Allocate the solver and buffers for the given chain
+     *
+     * Not realtime-safe. Call on configuration.
+     *
+     * @param chain The robot chain from base link to end-effector
+     */
+  void init(const KDL::Chain & chain);
+
+  /**
+     * @brief Compute pose and twist from the joint state interfaces
+     *
+     * Realtime-safe. Call once per control cycle.
+     *
+     * @param positions The joints' position state interfaces in chain order
+     * @param velocities The joints' velocity state interfaces in chain order.
+     * Leave empty to compute the pose only. The twist is then zero.
+     *
+     * @return False if the interfaces don't match the chain. Pose and twist stay unchanged.
+     */
+  bool update(const StateHandles & positions, const StateHandles & velocities = StateHandles());
+
+  /**
+     * @brief The end-effector pose w.r.t. the chain's base link
+     */
+  const KDL::Frame & pose() const { return m_pose; }
+
+  /**
+     * @brief The end-effector twist w.r.t. the chain's base link
+     *
+     * The reference point is the end-effector's origin.
+     */
+  const KDL::Twist & twist() const { return m_twist; }
+
+  const KDL::JntArray & positions() const { return m_joint_state.q; }
+  const KDL::JntArray & velocities() const { return m_joint_state.qdot; }
+
+private:
+  std::shared_ptr<KDL::ChainFkSolverVel_recursive> m_fk_solver;
+  KDL::JntArrayVel m_joint_state;
+  KDL::FrameVel m_frame;
+  KDL::Frame m_pose;
+  KDL::Twist m_twist;
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef RING_BUFFER_H_INCLUDED
+#define RING_BUFFER_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief A fixed-capacity FIFO buffer that never allocates
+ *
+ * Pushing into a full buffer overwrites the oldest element.
+ *
+ * @tparam T Copy-assignable element type
+ * @tparam N Capacity
+ */
+template <typename T, size_t N>
+class RingBuffer
+{
+  static_assert(N > 0, "RingBuffer needs a capacity greater than zero");
+
+public:
+  RingBuffer() : m_begin(0), m_size(0) {}
+
+  /**
+   * @brief Append a value. Overwrites the oldest one when full.
+   */
+  void push(const T & value)
+  {
+    if (m_size < N)
+    {
+      m_data[index(m_size)] = value;
+      ++m_size;
+    }
+    else
+    {
+      m_data[m_begin] = value;
+      m_begin = index(1);
+    }
+  }
+
+  /**
+   * @brief Remove the oldest value. The buffer must not be empty.
+   */
+  void pop()
+  {
+    m_begin = index(1);
+    --m_size;
+  }
+
+  void clear()
+  {
+    m_begin = 0;
+    m_size = 0;
+  }
+
+  /**
+   * @brief Access by age, with 0 for the oldest value
+   */
+  T & operator[](size_t i) { return m_data[index(i)]; }
+  const T & operator[](size_t i) const { return m_data[index(i)]; }
+
+  T & front() { return m_data[m_begin]; }
+  const T & front() const { return m_data[m_begin]; }
+  T & back() { return m_data[index(m_size - 1)]; }
+  const T & back() const { return m_data[index(m_size - 1)]; }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  bool full() const { return m_size == N; }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  size_t index(size_t i) const
+  {
+    const size_t j = m_begin + i;
+    return j < N ? j : j - N;
+  }
+
+  std::array<T, N> m_data;
+  size_t m_begin;
+  size_t m_size;
+};
+
+/**
+ * @brief A \ref RingBuffer of numbers that keeps their sum up to date
+ *
+ * Useful for moving averages. The sum is updated in constant time and
+ * recomputed from scratch once per N values, so rounding errors don't
+ * accumulate.
+ *
+ * @tparam T Arithmetic element type
+ * @tparam N Capacity
+ */
+template <typename T, size_t N>
+class RunningSumBuffer
+{
+  static_assert(std::is_arithmetic<T>::value, "RunningSumBuffer needs an arithmetic type");
+
+public:
+  RunningSumBuffer() : m_sum(0), m_pushes(0) {}
+
+  /**
+   * @brief Append a value. Drops the oldest one when full.
+   */
+  void push(T value)
+  {
+    if (m_buffer.full())
+    {
+      m_sum -= m_buffer.front();
+    }
+    m_buffer.push(value);
+    m_sum += value;
+
+    if (++m_pushes == N)
+    {
+      m_pushes = 0;
+      m_sum = 0;
+      for (size_t i = 0; i < m_buffer.size(); ++i)
+      {
+        m_sum += m_buffer[i];
+      }
+    }
+  }
+
+  /**
+   * @brief Fill the whole buffer with the given value
+   */
+  void fill(T value)
+  {
+    m_buffer.clear();
+    for (size_t i = 0; i < N; ++i)
+    {
+      m_buffer.push(value);
+    }
+    m_sum = value * static_cast<T>(N);
+    m_pushes = 0;
+  }
+
+  void clear()
+  {
+    m_buffer.clear();
+    m_sum = 0;
+    m_pushes = 0;
+  }
+
+  T sum() const { return m_sum; }
+
+  /**
+   * @brief The mean of the buffered values. The buffer must not be empty.
+   */
+  T mean() const { return m_sum / static_cast<T>(m_buffer.size()); }
+
+  const RingBuffer<T, N> & values() const { return m_buffer; }
+  size_t size() const { return m_buffer.size(); }
+  bool empty() const { return m_buffer.empty(); }
+  bool full() const { return m_buffer.full(); }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  RingBuffer<T, N> m_buffer;
+  T m_sum;
+  size_t m_pushes;
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
@@ -41,6 +41,7 @@
 #define SPATIAL_PD_CONTROLLER_H_INCLUDED
 
 #include <cartesian_controller_base/PDController.h>
+#include <cartesian_controller_base/StaticVector.h>
 #include <cartesian_controller_base/Utility.h>
 
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
@@ -76,7 +77,7 @@ public:
 
 private:
   ctrl::Vector6D m_cmd;
-  std::vector<PDController> m_pd_controllers;
+  StaticVector<PDController, 6> m_pd_controllers;
 };
 
 }  // namespace cartesian_controller_base
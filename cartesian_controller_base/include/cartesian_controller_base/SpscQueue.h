@@ -0,0 +1,92 @@
+#ifndef SPSC_QUEUE_H_INCLUDED
+#define SPSC_QUEUE_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief A lock-free queue between one producer and one consumer thread
+ *
+ * The capacity is allocated once with \ref reset, outside the real-time
+ * context. Afterwards, push() and pop() never block or allocate.
+ *
+ * @tparam T Default-constructible and copy-assignable element type
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+  SpscQueue() : m_head(0), m_tail(0) {}
+
+  /**
+   * @brief Allocate the given capacity and drop all elements
+   *
+   * Not thread-safe. Call before the producer and the consumer start.
+   */
+  void reset(size_t capacity)
+  {
+    // One slot stays empty to tell a full queue from an empty one
+    m_data.assign(capacity + 1, T());
+    m_head = 0;
+    m_tail = 0;
+  }
+
+  /**
+   * @brief Append a value. Only call from the producer.
+   *
+   * @return False if the queue is full, true otherwise
+   */
+  bool push(const T & value)
+  {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    const size_t next = increment(head);
+    if (m_data.empty() || next == m_tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    m_data[head] = value;
+    m_head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Take the oldest value. Only call from the consumer.
+   *
+   * @return False if the queue is empty, true otherwise
+   */
+  bool pop(T & value)
+  {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    value = m_data[tail];
+    m_tail.store(increment(tail), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Whether the queue is empty. Exact only for the consumer.
+   */
+  bool empty() const
+  {
+    return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return m_data.empty() ? 0 : m_data.size() - 1; }
+
+private:
+  size_t increment(size_t i) const { return i + 1 < m_data.size() ? i + 1 : 0; }
+
+  std::vector<T> m_data;
+  alignas(64) std::atomic<size_t> m_head;  // Next write, owned by the producer
+  alignas(64) std::atomic<size_t> m_tail;  // Next read, owned by the consumer
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
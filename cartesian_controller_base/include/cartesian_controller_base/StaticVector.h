@@ -0,0 +1,72 @@
+#ifndef STATIC_VECTOR_H_INCLUDED
+#define STATIC_VECTOR_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief A vector with fixed capacity in place, which never allocates
+ *
+ * All N elements are default-constructed with the vector and live as long as
+ * the vector does. Size changes only assign to them.
+ *
+ * @tparam T Default-constructible and copy-assignable element type
+ * @tparam N Capacity
+ */
+template <typename T, size_t N>
+class StaticVector
+{
+public:
+  using iterator = typename std::array<T, N>::iterator;
+  using const_iterator = typename std::array<T, N>::const_iterator;
+
+  StaticVector() : m_size(0) {}
+
+  /**
+   * @brief Append a value
+   *
+   * @return False if the vector is full, true otherwise
+   */
+  bool push_back(const T & value)
+  {
+    if (m_size == N)
+    {
+      return false;
+    }
+    m_data[m_size++] = value;
+    return true;
+  }
+
+  /**
+   * @brief Remove the last value. The vector must not be empty.
+   */
+  void pop_back() { --m_size; }
+
+  void clear() { m_size = 0; }
+
+  T & operator[](size_t i) { return m_data[i]; }
+  const T & operator[](size_t i) const { return m_data[i]; }
+
+  T & back() { return m_data[m_size - 1]; }
+  const T & back() const { return m_data[m_size - 1]; }
+
+  iterator begin() { return m_data.begin(); }
+  iterator end() { return m_data.begin() + m_size; }
+  const_iterator begin() const { return m_data.begin(); }
+  const_iterator end() const { return m_data.begin() + m_size; }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  bool full() const { return m_size == N; }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  std::array<T, N> m_data;
+  size_t m_size;
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TRIPLE_BUFFER_H_INCLUDED
+#define TRIPLE_BUFFER_H_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace cartesian_controller_base
+{
+/**
+ * @brief Lock-free handoff of the latest value from one writer to one reader
+ *
+ * The writer and the reader each own one of three slots. The third slot is
+ * exchanged atomically when writing or reading, so neither side ever waits
+ * for the other. The reader only sees the newest value and skips older ones.
+ *
+ * @tparam T Copy-assignable value type
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : m_back(0), m_middle(1), m_front(2) {}
+
+  /**
+   * @brief Publish a new value. Only call from the writer thread.
+   */
+  void write(const T & value)
+  {
+    m_slots[m_back] = value;
+    m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & index;
+  }
+
+  /**
+   * @brief Get the newest value if there is one. Only call from the reader thread.
+   *
+   * @param value Gets the newest value. Unchanged if there's nothing new since the last read.
+   *
+   * @return True if there was a new value, false otherwise
+   */
+  bool read(T & value)
+  {
+    if (!(m_middle.load(std::memory_order_relaxed) & fresh))
+    {
+      return false;
+    }
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index;
+    value = m_slots[m_front];
+    return true;
+  }
+
+  /**
+   * @brief Forget any unread value. Not thread-safe.
+   */
+  void reset()
+  {
+    m_back = 0;
+    m_middle = 1;
+    m_front = 2;
+  }
+
+private:
+  static constexpr uint8_t index = 0x3;
+  static constexpr uint8_t fresh = 0x4;
+
+  std::array<T, 3> m_slots;
+  uint8_t m_back;  // Owned by the writer
+  alignas(64) std::atomic<uint8_t> m_middle;
+  alignas(64) uint8_t m_front;  // Owned by the reader
+};
+
+}  // namespace cartesian_controller_base
+
+#endif
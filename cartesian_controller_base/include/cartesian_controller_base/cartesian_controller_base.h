@@ -41,10 +41,12 @@
 #define CARTESIAN_CONTROLLER_BASE_H_INCLUDED
 
 #include <cartesian_controller_base/IKSolver.h>
+#include <cartesian_controller_base/MeasuredStateKinematics.h>
 #include <cartesian_controller_base/SpatialPDController.h>
 #include <cartesian_controller_base/Utility.h>
 #include <realtime_tools/realtime_publisher.h>
 
+#include <atomic>
 #include <controller_interface/controller_interface.hpp>
 #include <functional>
 #include <geometry_msgs/msg/pose_stamped.hpp>
@@ -52,10 +54,13 @@
 #include <geometry_msgs/msg/wrench_stamped.hpp>
 #include <hardware_interface/loaned_command_interface.hpp>
 #include <hardware_interface/loaned_state_interface.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
 #include <kdl/treefksolverpos_recursive.hpp>
+#include <map>
 #include <memory>
 #include <pluginlib/class_loader.hpp>
 #include <rclcpp/rclcpp.hpp>
+#include <std_msgs/msg/float64_multi_array.hpp>
 #include <string>
 #include <trajectory_msgs/msg/joint_trajectory_point.hpp>
 #include <vector>
@@ -125,6 +130,13 @@ protected:
      */
   void computeJointControlCmds(const ctrl::Vector6D & error, const rclcpp::Duration & period);
 
+  /**
+     * @brief Compute the end-effector pose and twist of the measured joint state
+     *
+     * Call this once per control cycle and read the result from \ref m_measured_state.
+     */
+  void updateMeasuredState();
+
   /**
      * @brief Display the given vector in the given robot base link
      *
@@ -157,6 +169,54 @@ protected:
      */
   ctrl::Vector6D displayInTipLink(const ctrl::Vector6D & vector, const std::string & to);
 
+  /**
+     * @brief Display the given vector in the robot base link
+     *
+     * Use this with \ref computeLastJointFrame and \ref getStaticOffset to
+     * share a single forward kinematics pass between several quantities.
+     *
+     * @param vector The quantity to transform
+     * @param rotation The orientation of the quantity's frame w.r.t. the robot base link
+     *
+     * @return The quantity in the robot base frame
+     */
+  ctrl::Vector6D displayInBaseLink(const ctrl::Vector6D & vector, const KDL::Rotation & rotation);
+
+  /**
+     * @brief Display the given tensor in the robot base link
+     *
+     * @param tensor The quantity to transform
+     * @param rotation The orientation of the quantity's frame w.r.t. the robot base link
+     *
+     * @return The quantity in the robot base frame
+     */
+  ctrl::Matrix6D displayInBaseLink(const ctrl::Matrix6D & tensor, const KDL::Rotation & rotation);
+
+  /**
+     * @brief Compute the frame of the last actuated joint in the robot base link
+     *
+     * All fixed joints of the robot chain are folded into static offsets on
+     * configuration, so that this forward kinematics pass only iterates over
+     * the actuated joints of the internal model.
+     *
+     * @return The last actuated joint's tip frame w.r.t. the robot base link
+     */
+  const KDL::Frame & computeLastJointFrame();
+
+  /**
+     * @brief Get the static transform from the last actuated joint to the given link
+     *
+     * Links behind the last actuated joint move rigidly with it.  Their
+     * transforms are computed once on configuration and combine with \ref
+     * computeLastJointFrame to the link's pose in the robot base link.
+     *
+     * @param link The link of interest
+     * @param offset The link's frame w.r.t. the last actuated joint's tip frame
+     *
+     * @return False if the link's pose depends on actuated joints
+     */
+  bool getStaticOffset(const std::string & link, KDL::Frame & offset) const;
+
   /**
      * @brief Check if specified links are part of the robot chain
      *
@@ -187,6 +247,26 @@ protected:
 
   std::shared_ptr<KDL::TreeFkSolverPos_recursive> m_forward_kinematics_solver;
 
+  /**
+     * @brief Kinematics of the real robot, in contrast to the IK solver's simulated state
+     */
+  MeasuredStateKinematics m_measured_state;
+
+  /**
+     * @brief The robot chain with all fixed joints folded into their parent segments
+     */
+  KDL::Chain m_actuated_chain;
+  std::shared_ptr<KDL::ChainFkSolverPos_recursive> m_actuated_chain_fk_solver;
+  KDL::Frame m_actuated_chain_root;
+  KDL::Frame m_last_joint_frame;
+
+  /**
+     * @brief The wrench that derived controllers report in the state feedback
+     *
+     * W.r.t. the robot base link. Stays zero for controllers without force input.
+     */
+  ctrl::Vector6D m_feedback_wrench = ctrl::Vector6D::Zero();
+
   /**
      * @brief Allow users to choose the IK solver type on startup
      */
@@ -223,13 +303,44 @@ private:
      * been called, then the controller's internal state represents the state
      * right after the error computation, and corresponds to the new target
      * state that will be send to the actuators in this control cycle.
+     *
+     * With `solver.state_feedback.combined`, pose, twist, \ref
+     * m_feedback_wrench and the joint commands go out in one message
+     * instead. Its layout is
+     * [stamp, position (3), quaternion xyzw (4), twist (6), wrench (6), joint positions (n)].
      */
   void publishStateFeedback();
 
+  /**
+     * @brief Cache the state feedback parameters on change
+     *
+     * Keeps parameter lookups out of the control loop.
+     */
+  rcl_interfaces::msg::SetParametersResult feedbackParametersCallback(
+    const std::vector<rclcpp::Parameter> & parameters);
+
+  /**
+     * @brief Fold fixed joints of the robot chain into static offsets
+     *
+     * Builds \ref m_actuated_chain and the static transforms of all links
+     * behind the last actuated joint.
+     */
+  void initStaticOffsets();
+
+  std::map<std::string, KDL::Frame> m_static_offsets;
+
   realtime_tools::RealtimePublisherSharedPtr<geometry_msgs::msg::PoseStamped>
     m_feedback_pose_publisher;
   realtime_tools::RealtimePublisherSharedPtr<geometry_msgs::msg::TwistStamped>
     m_feedback_twist_publisher;
+  realtime_tools::RealtimePublisherSharedPtr<std_msgs::msg::Float64MultiArray>
+    m_feedback_combined_publisher;
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr
+    m_feedback_parameters_callback;
+  std::atomic<bool> m_publish_state_feedback = {false};
+  std::atomic<bool> m_combined_state_feedback = {false};
+  std::atomic<int> m_state_feedback_divider = {1};
+  int m_state_feedback_cycle = {0};
 
   std::vector<std::string> m_cmd_interface_types;
   std::vector<std::string> m_state_interface_types;
@@ -0,0 +1,150 @@
+#include <cartesian_controller_base/ImpedanceSchedule.h>
+
+#include <Eigen/Eigenvalues>
+#include <cmath>
+
+namespace cartesian_controller_base
+{
+namespace
+{
+bool isSymmetricPositiveSemiDefinite(const ctrl::Matrix6D & m)
+{
+  if (!m.allFinite() || !m.isApprox(m.transpose(), 1e-9))
+  {
+    return false;
+  }
+  return Eigen::SelfAdjointEigenSolver<ctrl::Matrix6D>(m, Eigen::EigenvaluesOnly)
+           .eigenvalues()
+           .minCoeff() >= 0.0;
+}
+}  // namespace
+
+ImpedanceSchedule::ImpedanceSchedule(double damping_ratio)
+: m_damping_ratio(damping_ratio), m_next_id(1), m_active_id(0), m_cursor(0)
+{
+}
+
+bool ImpedanceSchedule::set(const std::vector<Setpoint> & setpoints, std::string & error)
+{
+  for (size_t i = 0; i < setpoints.size(); ++i)
+  {
+    const std::string where = "Setpoint " + std::to_string(i) + ": ";
+    if (!std::isfinite(setpoints[i].time) || setpoints[i].time < 0.0)
+    {
+      error = where + "time must be finite and non-negative";
+      return false;
+    }
+    if (i > 0 && setpoints[i].time <= setpoints[i - 1].time)
+    {
+      error = where + "times must be strictly increasing";
+      return false;
+    }
+    if (!isSymmetricPositiveSemiDefinite(setpoints[i].stiffness))
+    {
+      error = where + "stiffness is not symmetric and positive semi-definite";
+      return false;
+    }
+    if (!isSymmetricPositiveSemiDefinite(setpoints[i].damping))
+    {
+      error = where + "damping is not symmetric and positive semi-definite";
+      return false;
+    }
+  }
+
+  Sequence sequence;
+  sequence.setpoints = setpoints;
+  sequence.id = m_next_id++;
+  m_buffer.writeFromNonRT(sequence);
+  return true;
+}
+
+bool ImpedanceSchedule::set(const std_msgs::msg::Float64MultiArray & msg, std::string & error)
+{
+  if (msg.data.empty())
+  {
+    return set(std::vector<Setpoint>(), error);
+  }
+  if (msg.layout.dim.size() != 2)
+  {
+    error = "Expected a two-dimensional layout of setpoints";
+    return false;
+  }
+  const size_t rows = msg.layout.dim[0].size;
+  const size_t stride = msg.layout.dim[1].size;
+  if (stride != 37 && stride != 73)
+  {
+    error = "Expected 37 or 73 entries per setpoint, got " + std::to_string(stride);
+    return false;
+  }
+  if (msg.layout.data_offset + rows * stride > msg.data.size())
+  {
+    error = "Layout exceeds the message's data";
+    return false;
+  }
+
+  using RowMajorMap = Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>>;
+  std::vector<Setpoint> setpoints(rows);
+  for (size_t i = 0; i < rows; ++i)
+  {
+    const double * row = msg.data.data() + msg.layout.data_offset + i * stride;
+    setpoints[i].time = row[0];
+    setpoints[i].stiffness = RowMajorMap(row + 1);
+    if (stride == 73)
+    {
+      setpoints[i].damping = RowMajorMap(row + 37);
+    }
+    else
+    {
+      // Symmetrize against round-off before taking the square root.
+      const ctrl::Matrix6D stiffness =
+        0.5 * (setpoints[i].stiffness + setpoints[i].stiffness.transpose());
+      setpoints[i].damping =
+        2.0 * m_damping_ratio *
+        Eigen::SelfAdjointEigenSolver<ctrl::Matrix6D>(stiffness).operatorSqrt();
+    }
+  }
+  return set(setpoints, error);
+}
+
+bool ImpedanceSchedule::sample(const rclcpp::Time & time, ctrl::Matrix6D & stiffness,
+                               ctrl::Matrix6D & damping)
+{
+  const Sequence & sequence = *m_buffer.readFromRT();
+  const std::vector<Setpoint> & setpoints = sequence.setpoints;
+  if (setpoints.empty())
+  {
+    return false;
+  }
+
+  // A new schedule starts now
+  if (sequence.id != m_active_id)
+  {
+    m_active_id = sequence.id;
+    m_start = time;
+    m_cursor = 0;
+  }
+  const double t = (time - m_start).seconds();
+
+  // Time only moves forward in the control loop, so that the search for the
+  // current segment continues where it left off.
+  while (m_cursor + 1 < setpoints.size() && setpoints[m_cursor + 1].time <= t)
+  {
+    ++m_cursor;
+  }
+
+  const Setpoint & from = setpoints[m_cursor];
+  if (t <= from.time || m_cursor + 1 == setpoints.size())
+  {
+    stiffness = from.stiffness;
+    damping = from.damping;
+    return true;
+  }
+
+  const Setpoint & to = setpoints[m_cursor + 1];
+  const double alpha = (t - from.time) / (to.time - from.time);
+  stiffness = from.stiffness + alpha * (to.stiffness - from.stiffness);
+  damping = from.damping + alpha * (to.damping - from.damping);
+  return true;
+}
+
+}  // namespace cartesian_controller_base
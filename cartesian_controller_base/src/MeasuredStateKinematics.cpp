@@ -0,0 +1,46 @@
+#include <cartesian_controller_base/MeasuredStateKinematics.h>
+
+namespace cartesian_controller_base
+{
+MeasuredStateKinematics::MeasuredStateKinematics()
+: m_pose(KDL::Frame::Identity()), m_twist(KDL::Twist::Zero())
+{
+}
+
+void MeasuredStateKinematics::init(const KDL::Chain & chain)
+{
+  m_fk_solver.reset(new KDL::ChainFkSolverVel_recursive(chain));
+  m_joint_state.resize(chain.getNrOfJoints());
+  KDL::SetToZero(m_joint_state);
+  m_pose = KDL::Frame::Identity();
+  m_twist = KDL::Twist::Zero();
+}
+
+bool MeasuredStateKinematics::update(const StateHandles & positions,
+                                     const StateHandles & velocities)
+{
+  if (!m_fk_solver || positions.size() != m_joint_state.q.rows() ||
+      (!velocities.empty() && velocities.size() != m_joint_state.qdot.rows()))
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < positions.size(); ++i)
+  {
+    m_joint_state.q(i) = positions[i].get().get_value();
+  }
+  for (size_t i = 0; i < velocities.size(); ++i)
+  {
+    m_joint_state.qdot(i) = velocities[i].get().get_value();
+  }
+
+  if (m_fk_solver->JntToCart(m_joint_state, m_frame) < 0)
+  {
+    return false;
+  }
+  m_pose = m_frame.GetFrame();
+  m_twist = m_frame.GetTwist();
+  return true;
+}
+
+}  // namespace cartesian_controller_base
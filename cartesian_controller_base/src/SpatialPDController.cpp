@@ -62,7 +62,9 @@ bool SpatialPDController::init(std::shared_ptr<rclcpp_lifecycle::LifecycleNode>
 bool SpatialPDController::init(std::shared_ptr<rclcpp::Node> handle)
 #endif
 {
-  // Create pd controllers for each Cartesian dimension
+  // Create pd controllers for each Cartesian dimension.
+  // Controllers with diamond inheritance call this more than once.
+  m_pd_controllers.clear();
   for (int i = 0; i < 6; ++i)  // 3 transition, 3 rotation
   {
     m_pd_controllers.push_back(PDController());
@@ -41,6 +41,7 @@
 #include <urdf/model.h>
 #include <urdf_model/joint.h>
 
+#include <algorithm>
 #include <cmath>
 #include <kdl/jntarray.hpp>
 #include <kdl/tree.hpp>
@@ -105,6 +106,8 @@ CartesianControllerBase::on_init()
     auto_declare<double>("solver.error_scale", 1.0);
     auto_declare<int>("solver.iterations", 1);
     auto_declare<bool>("solver.publish_state_feedback", false);
+    auto_declare<int>("solver.state_feedback.divider", 1);
+    auto_declare<bool>("solver.state_feedback.combined", false);
     m_initialized = true;
   }
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -131,6 +134,8 @@ controller_interface::return_type CartesianControllerBase::init(const std::strin
     auto_declare<double>("solver.error_scale", 1.0);
     auto_declare<int>("solver.iterations", 1);
     auto_declare<bool>("solver.publish_state_feedback", false);
+    auto_declare<int>("solver.state_feedback.divider", 1);
+    auto_declare<bool>("solver.state_feedback.combined", false);
 
     m_initialized = true;
   }
@@ -244,6 +249,8 @@ CartesianControllerBase::on_configure(const rclcpp_lifecycle::State & previous_s
   KDL::Tree tmp("not_relevant");
   tmp.addChain(m_robot_chain, "not_relevant");
   m_forward_kinematics_solver.reset(new KDL::TreeFkSolverPos_recursive(tmp));
+  m_measured_state.init(m_robot_chain);
+  initStaticOffsets();
   m_iterations = get_node()->get_parameter("solver.iterations").as_int();
   m_error_scale = get_node()->get_parameter("solver.error_scale").as_double();
 
@@ -279,6 +286,25 @@ CartesianControllerBase::on_configure(const rclcpp_lifecycle::State & previous_s
       get_node()->create_publisher<geometry_msgs::msg::TwistStamped>(
         std::string(get_node()->get_name()) + "/current_twist", 3));
 
+  m_feedback_combined_publisher =
+    std::make_shared<realtime_tools::RealtimePublisher<std_msgs::msg::Float64MultiArray>>(
+      get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
+        std::string(get_node()->get_name()) + "/state_feedback", 3));
+
+  // Preallocate the combined message once
+  m_feedback_combined_publisher->lock();
+  auto & feedback = m_feedback_combined_publisher->msg_;
+  feedback.layout.dim.resize(1);
+  feedback.layout.dim[0].label = "stamp_pose_twist_wrench_joints";
+  feedback.layout.dim[0].size = 20 + m_joint_names.size();
+  feedback.layout.dim[0].stride = 20 + m_joint_names.size();
+  feedback.data.resize(20 + m_joint_names.size(), 0.0);
+  m_feedback_combined_publisher->unlock();
+
+  feedbackParametersCallback({});
+  m_feedback_parameters_callback = get_node()->add_on_set_parameters_callback(std::bind(
+    &CartesianControllerBase::feedbackParametersCallback, this, std::placeholders::_1));
+
   m_configured = true;
 
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -385,8 +411,10 @@ CartesianControllerBase::on_shutdown(const rclcpp_lifecycle::State & previous_st
 
 void CartesianControllerBase::writeJointControlCmds()
 {
-  if (get_node()->get_parameter("solver.publish_state_feedback").as_bool())
+  if (m_publish_state_feedback &&
+      ++m_state_feedback_cycle >= std::max(1, m_state_feedback_divider.load()))
   {
+    m_state_feedback_cycle = 0;
     publishStateFeedback();
   }
 
@@ -436,6 +464,11 @@ void CartesianControllerBase::writeJointControlCmds()
   }
 }
 
+void CartesianControllerBase::updateMeasuredState()
+{
+  m_measured_state.update(m_joint_state_pos_handles, m_joint_state_vel_handles);
+}
+
 void CartesianControllerBase::computeJointControlCmds(const ctrl::Vector6D & error,
                                                       const rclcpp::Duration & period)
 {
@@ -451,6 +484,15 @@ void CartesianControllerBase::computeJointControlCmds(const ctrl::Vector6D & err
 
 ctrl::Vector6D CartesianControllerBase::displayInBaseLink(const ctrl::Vector6D & vector,
                                                           const std::string & from)
+{
+  KDL::Frame transform_kdl;
+  m_forward_kinematics_solver->JntToCart(m_ik_solver->getPositions(), transform_kdl, from);
+
+  return displayInBaseLink(vector, transform_kdl.M);
+}
+
+ctrl::Vector6D CartesianControllerBase::displayInBaseLink(const ctrl::Vector6D & vector,
+                                                          const KDL::Rotation & rotation)
 {
   // Adjust format
   KDL::Wrench wrench_kdl;
@@ -459,11 +501,8 @@ ctrl::Vector6D CartesianControllerBase::displayInBaseLink(const ctrl::Vector6D &
     wrench_kdl(i) = vector[i];
   }
 
-  KDL::Frame transform_kdl;
-  m_forward_kinematics_solver->JntToCart(m_ik_solver->getPositions(), transform_kdl, from);
-
   // Rotate into new reference frame
-  wrench_kdl = transform_kdl.M * wrench_kdl;
+  wrench_kdl = rotation * wrench_kdl;
 
   // Reassign
   ctrl::Vector6D out;
@@ -482,15 +521,23 @@ ctrl::Matrix6D CartesianControllerBase::displayInBaseLink(const ctrl::Matrix6D &
   KDL::Frame R_kdl;
   m_forward_kinematics_solver->JntToCart(m_ik_solver->getPositions(), R_kdl, from);
 
+  return displayInBaseLink(tensor, R_kdl.M);
+}
+
+ctrl::Matrix6D CartesianControllerBase::displayInBaseLink(const ctrl::Matrix6D & tensor,
+                                                          const KDL::Rotation & rotation)
+{
   // Adjust format
   ctrl::Matrix3D R;
-  R << R_kdl.M.data[0], R_kdl.M.data[1], R_kdl.M.data[2], R_kdl.M.data[3], R_kdl.M.data[4],
-    R_kdl.M.data[5], R_kdl.M.data[6], R_kdl.M.data[7], R_kdl.M.data[8];
+  R << rotation.data[0], rotation.data[1], rotation.data[2], rotation.data[3], rotation.data[4],
+    rotation.data[5], rotation.data[6], rotation.data[7], rotation.data[8];
 
-  // Treat diagonal blocks as individual 2nd rank tensors.
+  // Treat the 3x3 blocks as individual 2nd rank tensors.
   // Display in base frame.
-  ctrl::Matrix6D tmp = ctrl::Matrix6D::Zero();
+  ctrl::Matrix6D tmp;
   tmp.topLeftCorner<3, 3>() = R * tensor.topLeftCorner<3, 3>() * R.transpose();
+  tmp.topRightCorner<3, 3>() = R * tensor.topRightCorner<3, 3>() * R.transpose();
+  tmp.bottomLeftCorner<3, 3>() = R * tensor.bottomLeftCorner<3, 3>() * R.transpose();
   tmp.bottomRightCorner<3, 3>() = R * tensor.bottomRightCorner<3, 3>() * R.transpose();
 
   return tmp;
@@ -522,13 +569,106 @@ ctrl::Vector6D CartesianControllerBase::displayInTipLink(const ctrl::Vector6D &
   return out;
 }
 
+const KDL::Frame & CartesianControllerBase::computeLastJointFrame()
+{
+  m_actuated_chain_fk_solver->JntToCart(m_ik_solver->getPositions(), m_last_joint_frame);
+  m_last_joint_frame = m_actuated_chain_root * m_last_joint_frame;
+  return m_last_joint_frame;
+}
+
+bool CartesianControllerBase::getStaticOffset(const std::string & link, KDL::Frame & offset) const
+{
+  auto it = m_static_offsets.find(link);
+  if (it == m_static_offsets.end())
+  {
+    return false;
+  }
+  offset = it->second;
+  return true;
+}
+
+void CartesianControllerBase::initStaticOffsets()
+{
+  // Fixed joints don't depend on the robot's configuration.  Accumulate them
+  // and append the result to the preceding actuated segment.  Fixed joints
+  // in front of the first actuated joint form a static root transform.
+  std::vector<KDL::Segment> segments;
+  KDL::Frame offset = KDL::Frame::Identity();
+  m_actuated_chain_root = KDL::Frame::Identity();
+  m_static_offsets.clear();
+
+  for (const auto & segment : m_robot_chain.segments)
+  {
+    if (segment.getJoint().getType() == KDL::Joint::None)
+    {
+      offset = offset * segment.getFrameToTip();
+      m_static_offsets[segment.getName()] = offset;
+      continue;
+    }
+
+    if (segments.empty())
+    {
+      m_actuated_chain_root = offset;
+    }
+    else
+    {
+      const KDL::Segment & parent = segments.back();
+      segments.back() = KDL::Segment(parent.getName(), parent.getJoint(),
+                                     parent.getFrameToTip() * offset, parent.getInertia());
+    }
+    segments.push_back(segment);
+
+    // Only links behind the last actuated joint are static w.r.t. it.
+    offset = KDL::Frame::Identity();
+    m_static_offsets.clear();
+    m_static_offsets[segment.getName()] = offset;
+  }
+
+  m_actuated_chain = KDL::Chain();
+  for (const auto & segment : segments)
+  {
+    m_actuated_chain.addSegment(segment);
+  }
+  m_actuated_chain_fk_solver.reset(new KDL::ChainFkSolverPos_recursive(m_actuated_chain));
+}
+
 void CartesianControllerBase::publishStateFeedback()
 {
+  const rclcpp::Time now = get_node()->now();
+  const auto & pose = m_ik_solver->getEndEffectorPose();
+  const auto & twist = m_ik_solver->getEndEffectorVel();
+
+  // Everything in one message
+  if (m_combined_state_feedback)
+  {
+    if (m_feedback_combined_publisher->trylock())
+    {
+      auto & data = m_feedback_combined_publisher->msg_.data;
+      data[0] = now.seconds();
+      data[1] = pose.p.x();
+      data[2] = pose.p.y();
+      data[3] = pose.p.z();
+      pose.M.GetQuaternion(data[4], data[5], data[6], data[7]);
+      for (int i = 0; i < 6; ++i)
+      {
+        data[8 + i] = twist[i];
+        data[14 + i] = m_feedback_wrench[i];
+      }
+      for (size_t i = 0; i < m_simulated_joint_motion.positions.size() && 20 + i < data.size();
+           ++i)
+      {
+        data[20 + i] = m_simulated_joint_motion.positions[i];
+      }
+
+      m_feedback_combined_publisher->unlockAndPublish();
+    }
+    return;
+  }
+
   // End-effector pose
-  auto pose = m_ik_solver->getEndEffectorPose();
   if (m_feedback_pose_publisher->trylock())
   {
-    m_feedback_pose_publisher->msg_.header.stamp = get_node()->now();
+    m_feedback_pose_publisher->msg_.header.stamp = now;
     m_feedback_pose_publisher->msg_.header.frame_id = m_robot_base_link;
     m_feedback_pose_publisher->msg_.pose.position.x = pose.p.x();
     m_feedback_pose_publisher->msg_.pose.position.y = pose.p.y();
@@ -543,10 +683,9 @@ void CartesianControllerBase::publishStateFeedback()
   }
 
   // End-effector twist
-  auto twist = m_ik_solver->getEndEffectorVel();
   if (m_feedback_twist_publisher->trylock())
   {
-    m_feedback_twist_publisher->msg_.header.stamp = get_node()->now();
+    m_feedback_twist_publisher->msg_.header.stamp = now;
     m_feedback_twist_publisher->msg_.header.frame_id = m_robot_base_link;
     m_feedback_twist_publisher->msg_.twist.linear.x = twist[0];
     m_feedback_twist_publisher->msg_.twist.linear.y = twist[1];
@@ -559,4 +698,44 @@ void CartesianControllerBase::publishStateFeedback()
   }
 }
 
+rcl_interfaces::msg::SetParametersResult CartesianControllerBase::feedbackParametersCallback(
+  const std::vector<rclcpp::Parameter> & parameters)
+{
+  rcl_interfaces::msg::SetParametersResult result;
+  result.successful = true;
+
+  // Parameters are not yet set when this callback is called.
+  bool publish = get_node()->get_parameter("solver.publish_state_feedback").as_bool();
+  int divider = get_node()->get_parameter("solver.state_feedback.divider").as_int();
+  bool combined = get_node()->get_parameter("solver.state_feedback.combined").as_bool();
+
+  for (const auto & parameter : parameters)
+  {
+    if (parameter.get_name() == "solver.publish_state_feedback")
+    {
+      publish = parameter.as_bool();
+    }
+    else if (parameter.get_name() == "solver.state_feedback.divider")
+    {
+      divider = parameter.as_int();
+    }
+    else if (parameter.get_name() == "solver.state_feedback.combined")
+    {
+      combined = parameter.as_bool();
+    }
+  }
+
+  if (divider < 1)
+  {
+    result.successful = false;
+    result.reason = "solver.state_feedback.divider must be at least 1";
+    return result;
+  }
+
+  m_publish_state_feedback = publish;
+  m_state_feedback_divider = divider;
+  m_combined_state_feedback = combined;
+  return result;
+}
+
 }  // namespace cartesian_controller_base
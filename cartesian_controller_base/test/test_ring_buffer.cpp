@@ -0,0 +1,87 @@
+#include <cartesian_controller_base/RingBuffer.h>
+#include <gtest/gtest.h>
+
+using cartesian_controller_base::RingBuffer;
+using cartesian_controller_base::RunningSumBuffer;
+
+TEST(RingBuffer, KeepsInsertionOrder)
+{
+  RingBuffer<int, 4> buffer;
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(buffer.capacity(), 4u);
+
+  buffer.push(1);
+  buffer.push(2);
+  buffer.push(3);
+  EXPECT_EQ(buffer.size(), 3u);
+  EXPECT_FALSE(buffer.full());
+  EXPECT_EQ(buffer.front(), 1);
+  EXPECT_EQ(buffer.back(), 3);
+  EXPECT_EQ(buffer[1], 2);
+
+  buffer.pop();
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_EQ(buffer.size(), 2u);
+}
+
+TEST(RingBuffer, OverwritesTheOldestWhenFull)
+{
+  RingBuffer<int, 4> buffer;
+  for (int i = 0; i < 10; ++i)
+  {
+    buffer.push(i);
+  }
+  EXPECT_TRUE(buffer.full());
+  for (size_t i = 0; i < buffer.size(); ++i)
+  {
+    EXPECT_EQ(buffer[i], static_cast<int>(6 + i));
+  }
+  EXPECT_EQ(buffer.front(), 6);
+  EXPECT_EQ(buffer.back(), 9);
+}
+
+TEST(RingBuffer, WrapsAroundWhilePopping)
+{
+  // Interleaved pushes and pops move the oldest element around the storage
+  RingBuffer<int, 3> buffer;
+  int next = 0;
+  int expected = 0;
+  for (int cycle = 0; cycle < 20; ++cycle)
+  {
+    buffer.push(next++);
+    buffer.push(next++);
+    ASSERT_EQ(buffer.front(), expected);
+    buffer.pop();
+    ++expected;
+    ASSERT_EQ(buffer.front(), expected);
+    buffer.pop();
+    ++expected;
+  }
+  EXPECT_TRUE(buffer.empty());
+
+  buffer.push(1);
+  buffer.clear();
+  EXPECT_TRUE(buffer.empty());
+  buffer.push(2);
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_EQ(buffer.back(), 2);
+}
+
+TEST(RunningSumBuffer, KeepsTheSumOfTheNewestValues)
+{
+  RunningSumBuffer<double, 4> buffer;
+  for (int i = 1; i <= 10; ++i)
+  {
+    buffer.push(i);
+  }
+  EXPECT_DOUBLE_EQ(buffer.sum(), 7 + 8 + 9 + 10);
+  EXPECT_DOUBLE_EQ(buffer.mean(), 8.5);
+
+  buffer.fill(2.0);
+  EXPECT_TRUE(buffer.full());
+  EXPECT_DOUBLE_EQ(buffer.sum(), 8.0);
+
+  buffer.clear();
+  buffer.push(3.0);
+  EXPECT_DOUBLE_EQ(buffer.mean(), 3.0);
+}
@@ -0,0 +1,78 @@
+#include <cartesian_controller_base/SpscQueue.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using cartesian_controller_base::SpscQueue;
+
+TEST(SpscQueue, RejectsPushesBeforeReset)
+{
+  SpscQueue<int> queue;
+  int value;
+  EXPECT_EQ(queue.capacity(), 0u);
+  EXPECT_FALSE(queue.push(1));
+  EXPECT_FALSE(queue.pop(value));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(SpscQueue, RejectsPushesWhenFull)
+{
+  SpscQueue<int> queue;
+  queue.reset(3);
+  EXPECT_EQ(queue.capacity(), 3u);
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_TRUE(queue.push(2));
+  EXPECT_TRUE(queue.push(3));
+  EXPECT_FALSE(queue.push(4));
+
+  int value;
+  ASSERT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(queue.push(5));
+
+  // The rest in order, across the end of the storage
+  ASSERT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 2);
+  ASSERT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 3);
+  ASSERT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 5);
+  EXPECT_FALSE(queue.pop(value));
+  EXPECT_TRUE(queue.empty());
+
+  queue.push(6);
+  queue.reset(3);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(SpscQueue, PassesEveryValueInOrderBetweenThreads)
+{
+  const int count = 1000000;
+  SpscQueue<int> queue;
+  queue.reset(64);
+
+  std::thread producer(
+    [&queue]()
+    {
+      for (int i = 0; i < count;)
+      {
+        if (queue.push(i))
+        {
+          ++i;
+        }
+      }
+    });
+
+  int expected = 0;
+  int value;
+  while (expected < count)
+  {
+    if (queue.pop(value))
+    {
+      ASSERT_EQ(value, expected);
+      ++expected;
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,38 @@
+#include <cartesian_controller_base/StaticVector.h>
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+using cartesian_controller_base::StaticVector;
+
+TEST(StaticVector, RejectsValuesBeyondItsCapacity)
+{
+  StaticVector<int, 3> vector;
+  EXPECT_TRUE(vector.empty());
+  EXPECT_TRUE(vector.push_back(1));
+  EXPECT_TRUE(vector.push_back(2));
+  EXPECT_TRUE(vector.push_back(3));
+  EXPECT_TRUE(vector.full());
+  EXPECT_FALSE(vector.push_back(4));
+  EXPECT_EQ(vector.size(), 3u);
+  EXPECT_EQ(vector.back(), 3);
+  EXPECT_EQ(std::accumulate(vector.begin(), vector.end(), 0), 6);
+}
+
+TEST(StaticVector, IteratesOnlyOverItsElements)
+{
+  StaticVector<int, 8> vector;
+  EXPECT_EQ(vector.begin(), vector.end());
+
+  vector.push_back(5);
+  vector.push_back(6);
+  vector.pop_back();
+  EXPECT_EQ(vector.size(), 1u);
+  EXPECT_EQ(vector.end() - vector.begin(), 1);
+  EXPECT_EQ(vector[0], 5);
+
+  vector.clear();
+  EXPECT_TRUE(vector.empty());
+  EXPECT_TRUE(vector.push_back(7));
+  EXPECT_EQ(vector.back(), 7);
+}
@@ -0,0 +1,82 @@
+#include <cartesian_controller_base/TripleBuffer.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+using cartesian_controller_base::TripleBuffer;
+
+TEST(TripleBuffer, ReadsOnlyTheNewestValue)
+{
+  TripleBuffer<int> buffer;
+  int value = -1;
+  EXPECT_FALSE(buffer.read(value));
+  EXPECT_EQ(value, -1);
+
+  buffer.write(1);
+  buffer.write(2);
+  buffer.write(3);
+  ASSERT_TRUE(buffer.read(value));
+  EXPECT_EQ(value, 3);
+
+  // Nothing new leaves the value unchanged
+  value = -1;
+  EXPECT_FALSE(buffer.read(value));
+  EXPECT_EQ(value, -1);
+
+  buffer.write(4);
+  ASSERT_TRUE(buffer.read(value));
+  EXPECT_EQ(value, 4);
+}
+
+TEST(TripleBuffer, ForgetsUnreadValuesOnReset)
+{
+  TripleBuffer<int> buffer;
+  buffer.write(1);
+  buffer.reset();
+
+  int value = -1;
+  EXPECT_FALSE(buffer.read(value));
+  buffer.write(2);
+  ASSERT_TRUE(buffer.read(value));
+  EXPECT_EQ(value, 2);
+}
+
+TEST(TripleBuffer, ReadsConsistentAndIncreasingValuesBetweenThreads)
+{
+  struct Pair
+  {
+    long a;
+    long b;
+  };
+  const long count = 1000000;
+  TripleBuffer<Pair> buffer;
+  std::atomic<bool> done(false);
+
+  std::thread writer(
+    [&]()
+    {
+      for (long i = 1; i <= count; ++i)
+      {
+        buffer.write({i, -i});
+      }
+      done = true;
+    });
+
+  // Torn values would mix two writes
+  Pair value = {0, 0};
+  long last = 0;
+  bool finished = false;
+  while (!finished)
+  {
+    finished = done;
+    if (buffer.read(value))
+    {
+      ASSERT_EQ(value.b, -value.a);
+      ASSERT_GT(value.a, last);
+      last = value.a;
+    }
+  }
+  writer.join();
+  EXPECT_EQ(last, count);
+}
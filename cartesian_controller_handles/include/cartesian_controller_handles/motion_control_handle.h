@@ -45,10 +45,10 @@
 #include <hardware_interface/loaned_state_interface.hpp>
 #include <interactive_markers/interactive_marker_server.hpp>
 #include <kdl/chain.hpp>
-#include <kdl/chainfksolverpos_recursive.hpp>
 #include <memory>
 #include <rclcpp/rclcpp.hpp>
 
+#include "cartesian_controller_base/MeasuredStateKinematics.h"
 #include "cartesian_controller_base/ROS2VersionConfig.h"
 #include "geometry_msgs/msg/detail/pose_stamped__struct.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
@@ -171,7 +171,7 @@ private:
   std::string m_end_effector_link;
   std::string m_target_frame_topic;
   KDL::Chain m_robot_chain;
-  std::shared_ptr<KDL::ChainFkSolverPos_recursive> m_fk_solver;
+  cartesian_controller_base::MeasuredStateKinematics m_measured_state;
 
   geometry_msgs::msg::PoseStamped m_current_pose;
   rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr m_pose_publisher;
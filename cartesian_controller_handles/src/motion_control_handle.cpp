@@ -208,7 +208,7 @@ MotionControlHandle::on_configure(const rclcpp_lifecycle::State & previous_state
     get_node()->get_name() + std::string("/target_frame"), 10);
 
   // Initialize kinematics
-  m_fk_solver.reset(new KDL::ChainFkSolverPos_recursive(m_robot_chain));
+  m_measured_state.init(m_robot_chain);
   m_current_pose = getEndEffectorPose();
 
   // Configure the interactive marker for usage in RViz
@@ -319,21 +319,16 @@ void MotionControlHandle::addAxisControl(visualization_msgs::msg::InteractiveMar
 
 geometry_msgs::msg::PoseStamped MotionControlHandle::getEndEffectorPose()
 {
-  KDL::JntArray positions(m_joint_handles.size());
-  for (size_t i = 0; i < m_joint_handles.size(); ++i)
-  {
-    positions(i) = m_joint_handles[i].get().get_value();
-  }
-
-  KDL::Frame tmp;
-  m_fk_solver->JntToCart(positions, tmp);
+  // Position interfaces only
+  m_measured_state.update(m_joint_handles);
+  const KDL::Frame & pose = m_measured_state.pose();
 
   geometry_msgs::msg::PoseStamped current;
-  current.pose.position.x = tmp.p.x();
-  current.pose.position.y = tmp.p.y();
-  current.pose.position.z = tmp.p.z();
-  tmp.M.GetQuaternion(current.pose.orientation.x, current.pose.orientation.y,
-                      current.pose.orientation.z, current.pose.orientation.w);
+  current.pose.position.x = pose.p.x();
+  current.pose.position.y = pose.p.y();
+  current.pose.position.z = pose.p.z();
+  pose.M.GetQuaternion(current.pose.orientation.x, current.pose.orientation.y,
+                       current.pose.orientation.z, current.pose.orientation.w);
 
   return current;
 }
@@ -109,6 +109,18 @@ protected:
      * @return The remaining error wrench, given in robot base frame
      */
   ctrl::Vector6D computeForceError();
+
+  /**
+     * @brief Compute the net force with a given orientation of the last actuated joint
+     *
+     * Lets derived controllers share their forward kinematics pass for this
+     * control step, see \ref Base::computeLastJointFrame.
+     *
+     * @param last_joint The last actuated joint's orientation w.r.t. the robot base link
+     *
+     * @return The remaining error wrench, given in robot base frame
+     */
+  ctrl::Vector6D computeForceError(const KDL::Rotation & last_joint);
   std::string m_new_ft_sensor_ref;
   void setFtSensorReferenceFrame(const std::string & new_ref);
 
@@ -123,6 +135,11 @@ private:
   std::string m_ft_sensor_ref_link;
   KDL::Frame m_ft_sensor_transform;
 
+  // Static transforms w.r.t. the last actuated joint
+  KDL::Frame m_end_effector_offset;
+  KDL::Frame m_new_ft_sensor_ref_offset;
+  bool m_new_ft_sensor_ref_is_static;
+
   /**
      * Allow users to choose whether to specify their target wrenches in the
      * end-effector frame (= True) or the base frame (= False). The first one
@@ -47,7 +47,7 @@
 namespace cartesian_force_controller
 {
 CartesianForceController::CartesianForceController()
-: Base::CartesianControllerBase(), m_hand_frame_control(true)
+: Base::CartesianControllerBase(), m_new_ft_sensor_ref_is_static(false), m_hand_frame_control(true)
 {
 }
 
@@ -104,6 +104,10 @@ CartesianForceController::on_configure(const rclcpp_lifecycle::State & previous_
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
   }
 
+  // The end effector is the chain's tip and always rigidly attached to the
+  // last actuated joint.
+  Base::getStaticOffset(Base::m_end_effector_link, m_end_effector_offset);
+
   // Make sure sensor wrenches are interpreted correctly
   setFtSensorReferenceFrame(Base::m_end_effector_link);
 
@@ -165,13 +169,20 @@ controller_interface::return_type CartesianForceController::update()
 }
 
 ctrl::Vector6D CartesianForceController::computeForceError()
+{
+  // One forward kinematics pass for both wrenches. Everything behind the last
+  // actuated joint is static and has been precomputed.
+  return computeForceError(Base::computeLastJointFrame().M);
+}
+
+ctrl::Vector6D CartesianForceController::computeForceError(const KDL::Rotation & last_joint)
 {
   ctrl::Vector6D target_wrench;
   m_hand_frame_control = get_node()->get_parameter("hand_frame_control").as_bool();
 
   if (m_hand_frame_control)  // Assume end-effector frame by convention
   {
-    target_wrench = Base::displayInBaseLink(m_target_wrench, Base::m_end_effector_link);
+    target_wrench = Base::displayInBaseLink(m_target_wrench, last_joint * m_end_effector_offset.M);
   }
   else  // Default to robot base frame
   {
@@ -181,10 +192,19 @@ ctrl::Vector6D CartesianForceController::computeForceError()
   // Superimpose target wrench and sensor wrench in base frame
 #if defined CARTESIAN_CONTROLLERS_GALACTIC || defined CARTESIAN_CONTROLLERS_HUMBLE || \
   defined CARTESIAN_CONTROLLERS_IRON
-  return Base::displayInBaseLink(m_ft_sensor_wrench, m_new_ft_sensor_ref) + target_wrench;
+  if (!m_new_ft_sensor_ref_is_static)
+  {
+    Base::m_feedback_wrench = Base::displayInBaseLink(m_ft_sensor_wrench, m_new_ft_sensor_ref);
+  }
+  else
+  {
+    Base::m_feedback_wrench =
+      Base::displayInBaseLink(m_ft_sensor_wrench, last_joint * m_new_ft_sensor_ref_offset.M);
+  }
 #elif defined CARTESIAN_CONTROLLERS_FOXY
-  return m_ft_sensor_wrench + target_wrench;
+  Base::m_feedback_wrench = m_ft_sensor_wrench;
 #endif
+  return Base::m_feedback_wrench + target_wrench;
 }
 
 void CartesianForceController::setFtSensorReferenceFrame(const std::string & new_ref)
@@ -204,6 +224,11 @@ void CartesianForceController::setFtSensorReferenceFrame(const std::string & new
   Base::m_forward_kinematics_solver->JntToCart(jnts, new_sensor_ref, m_new_ft_sensor_ref);
 
   m_ft_sensor_transform = new_sensor_ref.Inverse() * sensor_ref;
+
+  // Reference frames in front of the last actuated joint need a full forward
+  // kinematics pass in each cycle.
+  m_new_ft_sensor_ref_is_static =
+    Base::getStaticOffset(m_new_ft_sensor_ref, m_new_ft_sensor_ref_offset);
 }
 
 void CartesianForceController::targetWrenchCallback(
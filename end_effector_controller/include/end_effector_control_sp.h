@@ -40,6 +40,7 @@
 #ifndef END_EFFECTOR_CONTROL_H_INCLUDED
 #define END_EFFECTOR_CONTROL_H_INCLUDED
 
+#include "cartesian_controller_base/MeasuredStateKinematics.h"
 #include "cartesian_controller_base/ROS2VersionConfig.h"
 #include "geometry_msgs/msg/wrench_stamped.hpp"
 #include "geometry_msgs/msg/detail/pose_stamped__struct.hpp"
@@ -53,10 +54,8 @@
 #include <hardware_interface/loaned_state_interface.hpp>
 #include <interactive_markers/interactive_marker_server.hpp>
 #include <kdl/chain.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
 #include <memory>
 #include <rclcpp/rclcpp.hpp>
-#include <queue>
 
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -171,14 +170,15 @@ class EndEffectorControl : public controller_interface::ControllerInterface
     std::string   m_end_effector_link;
     std::string   m_target_frame_topic;
     KDL::Chain    m_robot_chain;
-    std::shared_ptr<
-      KDL::ChainFkSolverVel_recursive>  m_fk_solver;
+    cartesian_controller_base::MeasuredStateKinematics m_measured_state;
 
     geometry_msgs::msg::PoseStamped  m_current_pose;
     geometry_msgs::msg::WrenchStamped  m_sinusoidal_force;
     rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr  m_pose_publisher;
     rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr  m_data_publisher;
     rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr  m_estimator_publisher;
+    std_msgs::msg::Float64MultiArray m_data_msg;
+    std_msgs::msg::Float64MultiArray m_estimator_msg;
     // rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr  m_elasticity_publisher;
     // rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr  m_position_publisher;
     // rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr  m_force_publisher;
@@ -215,8 +215,6 @@ class EndEffectorControl : public controller_interface::ControllerInterface
     rclcpp::Time initial_time;
     rclcpp::Time prec_time;
 
-    std::queue<std_msgs::msg::Float64MultiArray> msgs_queue;
-
 };
 
 } // cartesian_controller_handles
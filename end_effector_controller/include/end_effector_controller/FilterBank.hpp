@@ -0,0 +1,354 @@
+#ifndef KALMAN_VISCOELASTIC_ESTIMATION_FILTERBANK_HPP_
+#define KALMAN_VISCOELASTIC_ESTIMATION_FILTERBANK_HPP_
+
+#include <end_effector_controller/SystemModelF.hpp>
+
+#include <Eigen/Dense>
+
+#include <cmath>
+#include <limits>
+
+namespace KalmanExamples2
+{
+namespace Estimation
+{
+
+/**
+ * @brief Bank of extended Kalman filters for the viscoelastic contact model
+ *
+ * Runs one EKF per hypothesis, each with its own Hunt-Crossley exponent and
+ * prior, for the system model of \ref SystemModel and the velocity measurement
+ * of \ref ForceMeasurementModel. All filters share the model data and the
+ * force input.
+ *
+ * The filters are stored as structure of arrays, i.e. one array per state and
+ * covariance entry with one element per filter. Each step is a sequence of
+ * element-wise Eigen array operations that vectorize across the filters. Since
+ * the Jacobians of the model are sparse, only the affected entries of the
+ * (symmetric) covariance are propagated. Per filter, that's several times
+ * cheaper than \ref ExtendedKalmanFilter with its dense matrix products.
+ *
+ * Each update weighs the filters with the likelihood of the measurement's
+ * innovation. The log-likelihoods fade with a forgetting factor, so that a
+ * hypothesis whose prior was far off can still take over once it has
+ * converged. The filter with the highest weight selects the exponent. The
+ * bank's estimate is the weighted mean of the filters with that exponent,
+ * since the units of elasticity and viscosity depend on it. Filters without a
+ * finite likelihood, e.g. with a negative innovation variance, have diverged
+ * and drop out. With the estimator's small measurement noise, that happens
+ * early for float, so prefer double.
+ *
+ * Adding hypotheses allocates. Predictions and updates don't.
+ *
+ * @param T Numeric scalar type
+ */
+template<typename T>
+class FilterBank
+{
+public:
+    //! State type shortcut definition
+    typedef KalmanExamples2::Estimation::State<T> S;
+
+    //! One value per filter
+    typedef Eigen::Array<T, Eigen::Dynamic, 1> Array;
+
+    /**
+     * @brief Set the model data shared by all filters
+     *
+     * @param mass The moving mass
+     * @param timeStep The time between two predictions
+     */
+    void setModelData( T mass, T timeStep )
+    {
+        this->mass = mass;
+        this->dT = timeStep;
+    }
+
+    /**
+     * @brief Set the time between two predictions, e.g. from measurement stamps
+     */
+    void setTimeStep( T timeStep )
+    {
+        this->dT = timeStep;
+    }
+
+    /**
+     * @brief Set the variance of the velocity's process noise
+     *
+     * The default matches the process noise of \ref SystemModel.
+     */
+    void setProcessNoise( T variance )
+    {
+        this->q = variance;
+    }
+
+    /**
+     * @brief Set the variance of the velocity measurement
+     *
+     * The default matches the noise of \ref ForceMeasurementModel.
+     */
+    void setMeasurementNoise( T variance )
+    {
+        this->r = variance;
+    }
+
+    /**
+     * @brief Set the factor by which the log-likelihoods fade per update
+     *
+     * One keeps the whole history. The default of 0.999 forgets with a time
+     * constant of 1000 updates.
+     */
+    void setForgetting( T factor )
+    {
+        this->forgetting = factor;
+    }
+
+    /**
+     * @brief Remove all filters
+     */
+    void clear()
+    {
+        resize( 0 );
+    }
+
+    /**
+     * @brief Add a filter with equal weight to the bank's current estimate
+     *
+     * @param [in] n The Hunt-Crossley exponent of the filter's model
+     * @param [in] x The initial state
+     * @param [in] P The initial state covariance
+     */
+    void addHypothesis( T n, const S& x, const Kalman::Covariance<S>& P )
+    {
+        const Eigen::Index i = size();
+        const T logWeight = i > 0 ? this->logWeight.maxCoeff() : T(0);
+        resize( i + 1 );
+        this->n( i ) = n;
+        this->x1( i ) = x.x1();
+        this->x2( i ) = x.x2();
+        this->x3( i ) = x.x3();
+        this->x4( i ) = x.x4();
+        this->p00( i ) = P( S::POSITION, S::POSITION );
+        this->p01( i ) = P( S::POSITION, S::VELOCITY );
+        this->p02( i ) = P( S::POSITION, S::ELASTICITY );
+        this->p03( i ) = P( S::POSITION, S::VISCOSITY );
+        this->p11( i ) = P( S::VELOCITY, S::VELOCITY );
+        this->p12( i ) = P( S::VELOCITY, S::ELASTICITY );
+        this->p13( i ) = P( S::VELOCITY, S::VISCOSITY );
+        this->p22( i ) = P( S::ELASTICITY, S::ELASTICITY );
+        this->p23( i ) = P( S::ELASTICITY, S::VISCOSITY );
+        this->p33( i ) = P( S::VISCOSITY, S::VISCOSITY );
+        this->logWeight( i ) = logWeight;
+        this->weights = ( this->logWeight > kMinLogWeight ).select( this->logWeight.exp(), T(0) );
+        this->weights /= this->weights.sum();
+    }
+
+    //! The number of filters
+    Eigen::Index size() const
+    {
+        return n.size();
+    }
+
+    /**
+     * @brief Predict all filters with the measured contact force
+     *
+     * Same as predicting each filter with \ref SystemModel.
+     */
+    void predict( T force_z )
+    {
+        const T dTm = this->dT / this->mass;
+
+        // Contact power terms |x1|^n and n |x1|^(n-1)
+        a = x1.abs();
+        power = a.pow( n );
+        powerDerivative = ( a > T(0) ).select( n * power / a, T(0) );
+
+        // Non-trivial row of the Jacobian, which is the identity apart from
+        // F(POSITION, VELOCITY) = dT
+        a = -dTm * ( x4 * x2 + x3 ) * powerDerivative;
+        b = T(1) - dTm * x4 * power;
+        c = -dTm * power;
+        d = -dTm * x2 * power;
+
+        // State transition
+        x1 += this->dT * x2;
+        x2 += dTm * ( force_z - power * ( x3 + x2 * x4 ) );
+
+        // Covariance prediction F P F^T + Q with G = F P, row by row
+        g00 = p00 + this->dT * p01;
+        g01 = p01 + this->dT * p11;
+        g02 = p02 + this->dT * p12;
+        g03 = p03 + this->dT * p13;
+        g10 = a * p00 + b * p01 + c * p02 + d * p03;
+        g11 = a * p01 + b * p11 + c * p12 + d * p13;
+        g12 = a * p02 + b * p12 + c * p22 + d * p23;
+        g13 = a * p03 + b * p13 + c * p23 + d * p33;
+
+        p00 = g00 + this->dT * g01;
+        p01 = a * g00 + b * g01 + c * g02 + d * g03;
+        p02 = g02;
+        p03 = g03;
+        p11 = a * g10 + b * g11 + c * g12 + d * g13 + this->q;
+        p12 = g12;
+        p13 = g13;
+    }
+
+    /**
+     * @brief Update all filters with the measured velocity and reweigh them
+     *
+     * Same as updating each filter with \ref ForceMeasurementModel.
+     */
+    void update( T velocity )
+    {
+        // Innovation and its inverse variance
+        a = velocity - x2;
+        b = T(1) / ( p11 + this->r );
+
+        // Log-likelihood of the innovation, up to a shared constant
+        c = T(0.5) * ( b.log() - a * a * b );
+        logWeight *= this->forgetting;
+        logWeight += c.isFinite().select( c, -std::numeric_limits<T>::infinity() );
+        logWeight -= logWeight.maxCoeff();
+        weights = ( logWeight > kMinLogWeight ).select( logWeight.exp(), T(0) );
+        weights /= weights.sum();
+
+        // Kalman gain P(:, VELOCITY) / s
+        c = a * b;
+        x1 += p01 * c;
+        x2 += p11 * c;
+        x3 += p12 * c;
+        x4 += p13 * c;
+
+        // P - k s k^T, with the velocity column last
+        p00 -= p01 * p01 * b;
+        p02 -= p01 * p12 * b;
+        p03 -= p01 * p13 * b;
+        p22 -= p12 * p12 * b;
+        p23 -= p12 * p13 * b;
+        p33 -= p13 * p13 * b;
+        d = this->r * b;
+        p01 *= d;
+        p12 *= d;
+        p13 *= d;
+        p11 *= d;
+    }
+
+    //! The normalized weight of a filter
+    T weight( Eigen::Index i ) const
+    {
+        return weights( i );
+    }
+
+    //! The filter with the highest weight
+    Eigen::Index best() const
+    {
+        Eigen::Index i = 0;
+        if( size() > 0 )
+        {
+            weights.maxCoeff( &i );
+        }
+        return i;
+    }
+
+    //! The Hunt-Crossley exponent of a filter
+    T exponent( Eigen::Index i ) const
+    {
+        return n( i );
+    }
+
+    //! The state estimate of a filter
+    S getState( Eigen::Index i ) const
+    {
+        S x;
+        x.x1() = x1( i );
+        x.x2() = x2( i );
+        x.x3() = x3( i );
+        x.x4() = x4( i );
+        return x;
+    }
+
+    //! The state covariance of a filter
+    Kalman::Covariance<S> getCovariance( Eigen::Index i ) const
+    {
+        Kalman::Covariance<S> P;
+        P << p00( i ), p01( i ), p02( i ), p03( i ),
+             p01( i ), p11( i ), p12( i ), p13( i ),
+             p02( i ), p12( i ), p22( i ), p23( i ),
+             p03( i ), p13( i ), p23( i ), p33( i );
+        return P;
+    }
+
+    /**
+     * @brief The weighted mean of the states of the filters with the best filter's exponent
+     *
+     * Requires at least one filter.
+     */
+    S getState() const
+    {
+        const T exponent = this->exponent();
+        S x;
+        x.x1() = weightedMean( x1, exponent );
+        x.x2() = weightedMean( x2, exponent );
+        x.x3() = weightedMean( x3, exponent );
+        x.x4() = weightedMean( x4, exponent );
+        return x;
+    }
+
+    /**
+     * @brief The Hunt-Crossley exponent of the filter with the highest weight
+     *
+     * Requires at least one filter.
+     */
+    T exponent() const
+    {
+        return n( best() );
+    }
+
+protected:
+    T mass = 1;
+    T dT = 0;
+    T q = 1e-10;
+    T r = 2.5e-11;
+    T forgetting = 0.999;
+
+    //! Below, a filter's weight is negligible compared to the best one's
+    static constexpr T kMinLogWeight = -50;
+
+    // Exponents, states and upper triangles of the covariances
+    Array n;
+    Array x1, x2, x3, x4;
+    Array p00, p01, p02, p03, p11, p12, p13, p22, p23, p33;
+    Array logWeight;
+    Array weights;
+
+    // Intermediate results
+    Array power, powerDerivative;
+    Array a, b, c, d;
+    Array g00, g01, g02, g03, g10, g11, g12, g13;
+
+    //! Diverged filters have zero weight, but may not have finite states
+    T weightedMean( const Array& values, T exponent ) const
+    {
+        const auto selected = ( weights > T(0) && n == exponent );
+        return selected.select( weights * values, T(0) ).sum() / selected.select( weights, T(0) ).sum();
+    }
+
+    void resize( Eigen::Index size )
+    {
+        for( Array* array : { &n, &x1, &x2, &x3, &x4, &p00, &p01, &p02, &p03, &p11, &p12, &p13,
+                              &p22, &p23, &p33, &logWeight, &weights } )
+        {
+            array->conservativeResize( size );
+        }
+        for( Array* array : { &power, &powerDerivative, &a, &b, &c, &d, &g00, &g01, &g02, &g03,
+                              &g10, &g11, &g12, &g13 } )
+        {
+            array->resize( size );
+        }
+    }
+};
+
+} // namespace Estimation
+} // namespace KalmanExamples2
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef KALMAN_VISCOELASTIC_ESTIMATION_FORCEMEASUREMENTMODEL_HPP_
 #define KALMAN_VISCOELASTIC_ESTIMATION_FORCEMEASUREMENTMODEL_HPP_
 
+#include <end_effector_controller/SystemModelF.hpp>
 #include <end_effector_controller/kalman/LinearizedMeasurementModel.hpp>
 
 namespace KalmanExamples2
@@ -53,11 +54,14 @@ public:
     
     /**
      * @brief Constructor
+     *
+     * The noise is part of the noise covariance rather than of the Jacobian V,
+     * since the unscented filters only use the former.
      */
     ForceMeasurementModel()
     {
         this->V.setIdentity();
-        this->V *= 0.000005;
+        this->setCovarianceSquareRoot( Kalman::Covariance<M>::Identity() * 0.000005 );
     }
     
     /**
@@ -3,6 +3,9 @@
 
 #include <end_effector_controller/kalman/LinearizedSystemModel.hpp>
 
+#include <cmath>
+#include <limits>
+
 namespace KalmanExamples2
 {
 namespace Estimation
@@ -77,6 +80,21 @@ public:
     //! Control type shortcut definition
     typedef KalmanExamples2::Estimation::Control<T> C;
     
+    /**
+     * @brief Constructor
+     *
+     * The process noise acts on the velocity only. It's part of the noise
+     * covariance rather than of the Jacobian W, since the unscented filters
+     * only use the former.
+     */
+    SystemModel()
+    {
+        Kalman::Covariance<S> noise;
+        noise.setZero();
+        noise( S::VELOCITY, S::VELOCITY ) = 1e-5;
+        this->setCovarianceSquareRoot( noise );
+    }
+    
     /**
      * @brief Definition of (non-linear) state transition function
      *
@@ -94,11 +112,14 @@ public:
         //! Predicted state vector after transition
         S x_;
         
+        // Hunt-Crossley contact force of the penetration x1
+        const T p = contactPower( x.x1() );
+        
         // New x-position given by old x-position plus change in x-direction
         // Change in x-direction is given by the cosine of the (new) orientation
         // times the velocity
         x_.x1() = x.x1() + this->dT * x.x2();
-        x_.x2() = x.x2() + this->dT / this->mass * ( this->force_z - pow(abs(x.x1()),this->n) * x.x3() - pow(abs(x.x1()),this->n) * x.x2() * x.x4() );
+        x_.x2() = x.x2() + this->dT / this->mass * ( this->force_z - p * x.x3() - p * x.x2() * x.x4() );
         x_.x3() = x.x3();
         x_.x4() = x.x4();
         
@@ -106,37 +127,68 @@ public:
         return x_;
     }
 
-    void setModelData( double mass, double timeStep, int n)
+    void setModelData( T mass, T timeStep, T n )
     {
         this->mass  =   mass;
         this->dT    =   timeStep;
         this->n     =   n;
+        this->cachedPosition = std::numeric_limits<T>::quiet_NaN();
     }
 
-    void setForce( double force_z ) 
+    void setForce( T force_z ) 
     {
         this->force_z = force_z;
     }
 
 protected:
-    double mass;
-    double dT;    
-    double force_z;
-    double n;
+    T mass = 1;
+    T dT = 0;
+    T force_z = 0;
+    T n = 1;
+
+    // The power terms of the last penetration.
+    // Filters linearize the model at the state they transition next, so that
+    // f() reuses what updateJacobians() computed.
+    mutable T cachedPosition = std::numeric_limits<T>::quiet_NaN();
+    mutable T cachedPower;  // |x1|^n
+    mutable T cachedPowerDerivative;  // n |x1|^(n-1)
+
+    /**
+     * @brief Compute |x1|^n and n |x1|^(n-1) with one power evaluation
+     */
+    void updateContactPower( T x1 ) const
+    {
+        if( x1 == this->cachedPosition )
+        {
+            return;
+        }
+        const T a = std::abs( x1 );
+        this->cachedPosition = x1;
+        this->cachedPower = a == T(0) ? T(0) : std::pow( a, this->n );
+        this->cachedPowerDerivative = a == T(0) ? T(0) : this->n * this->cachedPower / a;
+    }
+
+    T contactPower( T x1 ) const
+    {
+        updateContactPower( x1 );
+        return this->cachedPower;
+    }
 
     void updateJacobians( const S& x, const C& c)
     {   
+        updateContactPower( x.x1() );
+        const T p = this->cachedPower;
+        const T dp = this->cachedPowerDerivative;
+        
         // partial derivative of x.theta() w.r.t. x.theta()
         this->F.setIdentity();
         this->F( S::POSITION, S::VELOCITY ) = this->dT;
-        this->F( S::VELOCITY, S::POSITION ) = (this->dT * (-x.x4() * this->n * x.x2() * pow(abs(x.x1()), this->n - 1) - x.x3() * this->n * pow(abs(x.x1()), this->n - 1))) / this->mass;
-        this->F( S::VELOCITY, S::VELOCITY ) = 1 - (x.x4() * this->dT * pow(abs(x.x1()), this->n)) / this->mass;
-        this->F( S::VELOCITY, S::ELASTICITY ) = -this->dT * pow(abs(x.x1()), this->n) / this->mass;
-        this->F( S::VELOCITY, S::VISCOSITY ) = -this->dT * x.x2() * pow(abs(x.x1()), this->n) / this->mass; 
+        this->F( S::VELOCITY, S::POSITION ) = (this->dT * (-x.x4() * x.x2() * dp - x.x3() * dp)) / this->mass;
+        this->F( S::VELOCITY, S::VELOCITY ) = 1 - (x.x4() * this->dT * p) / this->mass;
+        this->F( S::VELOCITY, S::ELASTICITY ) = -this->dT * p / this->mass;
+        this->F( S::VELOCITY, S::VISCOSITY ) = -this->dT * x.x2() * p / this->mass; 
         
-        // set W to zero
-        this->W.setZero();
-        this->W( S::VELOCITY , S::VELOCITY ) = 1e-5;
+        // W stays the identity, see the constructor
     }
 };
 
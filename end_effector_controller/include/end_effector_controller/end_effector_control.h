@@ -45,11 +45,16 @@
 #include <hardware_interface/loaned_state_interface.hpp>
 #include <interactive_markers/interactive_marker_server.hpp>
 #include <kdl/chain.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
 #include <memory>
-#include <queue>
 
+#include "cartesian_controller_base/MeasuredStateKinematics.h"
 #include "cartesian_controller_base/ROS2VersionConfig.h"
+#include "cartesian_controller_base/SpscQueue.h"
+#include "end_effector_controller/measurement_buffer.h"
+#include "end_effector_controller/motion_profile.h"
+#include "end_effector_controller/palpation_estimator.h"
+#include "end_effector_controller/palpation_planner.h"
+#include "end_effector_controller/triggered_capture.h"
 #include "geometry_msgs/msg/detail/pose_stamped__struct.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
 #include "geometry_msgs/msg/wrench_stamped.hpp"
@@ -61,27 +66,11 @@
 #define _USE_MATH_DEFINES
 #include <Eigen/Dense>
 
-#include "SystemModelF.hpp"
-#include "ForceMeasurementModel.hpp"
-
-#include <end_effector_controller/kalman/ExtendedKalmanFilter.hpp>
-#include <end_effector_controller/kalman/UnscentedKalmanFilter.hpp>
+#include <atomic>
 #include <iostream>
 #include <random>
 #include <chrono>
 
-using namespace KalmanExamples2;
-
-typedef float T;
-
-// Some type shortcuts
-typedef Estimation::State<T> State;
-typedef Estimation::SystemModel<T> SystemModel;
-typedef Estimation::Control<T> Control;
-
-typedef Estimation::VelocityMeasurement<T> VelocityMeasurement;
-typedef Estimation::ForceMeasurementModel<T> ForceModel;
-
 namespace end_effector_controller
 {
 
@@ -151,10 +140,11 @@ private:
      */
   geometry_msgs::msg::Quaternion setEndEffectorOrientation(geometry_msgs::msg::Quaternion pos);
 
-  void gridPosition();
-  void surfaceApproach();
+  void gridPosition(const rclcpp::Duration & period);
+  void startApproach();
+  void surfaceApproach(const rclcpp::Duration & period);
   void tissuePalpation(const rclcpp::Time & time);
-  void startingHigh();
+  void startingHigh(const rclcpp::Duration & period);
   void newStartingPosition();
   void publishDataEE(const rclcpp::Time & time);
 
@@ -175,7 +165,7 @@ private:
   std::string m_end_effector_link;
   std::string m_target_frame_topic;
   KDL::Chain m_robot_chain;
-  std::shared_ptr<KDL::ChainFkSolverVel_recursive> m_fk_solver;
+  cartesian_controller_base::MeasuredStateKinematics m_measured_state;
 
   geometry_msgs::msg::PoseStamped m_current_pose;
   geometry_msgs::msg::PoseStamped m_target_pose;
@@ -194,36 +184,48 @@ private:
   Eigen::Vector3d cartVel;
   geometry_msgs::msg::Point m_starting_position;
   geometry_msgs::msg::Point m_grid_position;
+  PalpationPlanner m_planner;
+  double m_retract_height;  // Of phase 4, and to move to the next site at
+  LinearMotion m_motion;     // Of the target in phases 1, 2 and 4
+  MotionLimits m_free_space;
+  MotionLimits m_near_contact;
+  double m_approach_distance;
+  bool m_leaving_tissue;  // Phase 4 retracts at near contact limits until clear of the surface
   uint m_phase;
   uint m_palpation_number;
   double m_surface;
   double m_prev_force;
   double m_sin_bias;
   bool m_contact;
-  double m_force_bias;
-  uint m_force_sample;
-  bool m_force_sample_flag;
+  // The sensor's callback averages the force bias and hands it over to the control loop
+  std::atomic<double> m_force_bias;
+  std::atomic<bool> m_force_bias_reset;  // Requests a new average from the sensor's callback
+  double m_force_sum;                    // Only used by the sensor's callback
+  uint m_force_sample;                   // Only used by the sensor's callback
+  bool m_force_sample_flag;              // Only used by the sensor's callback
+  bool m_palpation_start;  // The next palpation sample starts a new estimation
 
 public:
-  // Simulated (true) system state
-  State x;
-
-  // System
-  SystemModel sys;
-
-  // Measurement models
-  ForceModel fm;
-
-  Kalman::ExtendedKalmanFilter<State> ekf;
-
-  Kalman::Covariance<State> cov;
+  // Tissue parameters, estimated in a background thread during each palpation
+  PalpationEstimator m_estimator;
+  TissueEstimate m_estimate;
+  std_msgs::msg::Float64MultiArray m_estimator_msg;  // Only used by the estimator thread
 
   // Previos position
   float prev_pos;
   rclcpp::Time initial_time;
   rclcpp::Time prec_time;
 
-  std::queue<std_msgs::msg::Float64MultiArray> msgs_queue;
+  // Published state, matched to the delayed force measurements by their stamps
+  typedef std::array<double, 9> DataRecord;
+  cartesian_controller_base::SpscQueue<ForceSample> m_force_samples;
+  MeasurementBuffer<DataRecord, 128> m_data_buffer;
+
+  // Only the windows around contacts and palpations get published, as records x fields
+  TriggeredCapture<DataRecord, 1024> m_capture;
+  size_t m_capture_batch;
+  double m_capture_force;
+  std_msgs::msg::Float64MultiArray m_data_msg;
 };
 
 }  // namespace end_effector_controller
@@ -131,6 +131,11 @@ namespace Kalman {
         {
             m.updateJacobians( x );
             
+            if constexpr ( DiagonalMeasurementNoise<Measurement>::value )
+            {
+                return sequentialUpdate( m, z );
+            }
+            
             // COMPUTE KALMAN GAIN
             // compute innovation covariance
             Covariance<Measurement> S = ( m.H * P * m.H.transpose() ) + ( m.V * m.getCovariance() * m.V.transpose() );
@@ -145,6 +150,55 @@ namespace Kalman {
             // Update covariance
             P -= K * m.H * P;
             
+            // return updated state estimate
+            return this->getState();
+        }
+        
+    protected:
+        /**
+         * @brief Update with one measurement component at a time
+         *
+         * Equivalent to the batch update for uncorrelated measurement noise, since all
+         * components use the same linearization. Each step only needs the scalar innovation
+         * variance \f$ s = hPh^T + r \f$ for the Jacobian row \f$ h \f$, and updates the
+         * covariance in Joseph form
+         *
+         *     \f[ P \leftarrow (I - kh) P (I - kh)^T + k r k^T \f]
+         *
+         * with three rank-1 updates instead of matrix products. Unlike \f$ P - kh P \f$,
+         * this stays positive semi-definite under rounding.
+         *
+         * @param [in] m The Measurement model with updated Jacobians
+         * @param [in] z The measurement vector
+         * @return The updated state estimate
+         */
+        template<class Measurement, template<class> class CovarianceBase>
+        const State& sequentialUpdate( MeasurementModelType<Measurement, CovarianceBase>& m, const Measurement& z )
+        {
+            typedef Matrix<T, State::RowsAtCompileTime, 1> Column;
+            typedef Matrix<T, 1, State::RowsAtCompileTime> Row;
+            
+            // Innovation and noise w.r.t. the prior estimate
+            const Measurement innovation = z - m.h( x );
+            const Covariance<Measurement> R = m.V * m.getCovariance() * m.V.transpose();
+            
+            Column dx = Column::Zero();
+            for( int i = 0; i < Measurement::RowsAtCompileTime; ++i )
+            {
+                const Column PHt = P * m.H.row(i).transpose();
+                const T s = m.H.row(i).dot( PHt ) + R(i, i);
+                const Column k = PHt / s;
+                
+                dx += k * ( innovation(i) - m.H.row(i).dot( dx ) );
+                
+                // The row hP instead of PHt keeps (I - kh)P exact
+                // even if rounding made P slightly asymmetric
+                const Row hP = m.H.row(i) * P;
+                const Column MHt = PHt - k * hP.dot( m.H.row(i) );
+                P.noalias() -= k * hP + ( MHt - R(i, i) * k ) * k.transpose();
+            }
+            x += dx;
+            
             // return updated state estimate
             return this->getState();
         }
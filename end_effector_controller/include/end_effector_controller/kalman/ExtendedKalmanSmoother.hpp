@@ -0,0 +1,172 @@
+#ifndef KALMAN_EXTENDEDKALMANSMOOTHER_HPP_
+#define KALMAN_EXTENDEDKALMANSMOOTHER_HPP_
+
+#include "ExtendedKalmanFilter.hpp"
+
+#include <vector>
+
+namespace Kalman {
+    
+    /**
+     * @brief Extended Rauch-Tung-Striebel smoother
+     *
+     * Runs an \ref ExtendedKalmanFilter forward and records each prediction.
+     * \ref smooth then refines all recorded estimates backwards with the
+     * measurements that followed them. That's for offline use, since every
+     * prediction allocates unless the steps are reserved.
+     *
+     * @param StateType The vector-type of the system state (usually some type derived from Kalman::Vector)
+     */
+    template<class StateType>
+    class ExtendedKalmanSmoother : public ExtendedKalmanFilter<StateType>
+    {
+    public:
+        //! Extended Kalman Filter base type
+        typedef ExtendedKalmanFilter<StateType> Base;
+        
+        //! Numeric Scalar Type inherited from base
+        using typename Base::T;
+        
+        //! State Type inherited from base
+        using typename Base::State;
+        
+        //! Linearized System Model Type
+        template<class Control, template<class> class CovarianceBase>
+        using SystemModelType = LinearizedSystemModel<State, Control, CovarianceBase>;
+        
+    protected:
+        //! State Estimate
+        using Base::x;
+        //! State Covariance Matrix
+        using Base::P;
+        
+        //! The estimates around one prediction
+        struct Step
+        {
+            //! Filtered estimate before the prediction
+            State x;
+            Covariance<State> P;
+            //! System model jacobian of the prediction
+            Jacobian<State, State> F;
+            //! Predicted estimate
+            State xPred;
+            Covariance<State> PPred;
+        };
+        
+        std::vector<Step> steps;
+        
+        //! Smoothed estimates, one per step and the final one
+        std::vector<State> xSmooth;
+        std::vector<Covariance<State>> PSmooth;
+        
+    public:
+        /**
+         * @brief Drop the recorded steps and keep the current estimate as the first one
+         */
+        void clear()
+        {
+            steps.clear();
+            xSmooth.clear();
+            PSmooth.clear();
+        }
+        
+        /**
+         * @brief Reserve memory for the given number of predictions
+         */
+        void reserve( size_t predictions )
+        {
+            steps.reserve( predictions );
+            xSmooth.reserve( predictions + 1 );
+            PSmooth.reserve( predictions + 1 );
+        }
+        
+        /**
+         * @brief Perform and record a filter prediction step
+         *
+         * @param [in] s The System model
+         * @param [in] u The Control input vector
+         * @return The predicted state estimate
+         */
+        template<class Control, template<class> class CovarianceBase>
+        const State& predict( SystemModelType<Control, CovarianceBase>& s, const Control& u )
+        {
+            steps.emplace_back();
+            Step& step = steps.back();
+            step.x = x;
+            step.P = P;
+            
+            Base::predict( s, u );
+            
+            step.F = s.F;
+            step.xPred = x;
+            step.PPred = P;
+            return this->getState();
+        }
+        
+        /**
+         * @brief Perform and record a filter prediction step without control input
+         *
+         * @param [in] s The System model
+         * @return The predicted state estimate
+         */
+        template<class Control, template<class> class CovarianceBase>
+        const State& predict( SystemModelType<Control, CovarianceBase>& s )
+        {
+            Control u;
+            u.setZero();
+            return predict( s, u );
+        }
+        
+        /**
+         * @brief Smooth all recorded estimates with the current one
+         *
+         * Call it after the last update. Doesn't change the filter's estimate.
+         *
+         * @return False if a predicted covariance wasn't invertible
+         */
+        bool smooth()
+        {
+            const size_t n = steps.size();
+            xSmooth.resize( n + 1 );
+            PSmooth.resize( n + 1 );
+            xSmooth[n] = x;
+            PSmooth[n] = P;
+            
+            bool success = true;
+            for( size_t k = n; k-- > 0; )
+            {
+                const Step& step = steps[k];
+                
+                // Smoother gain C = P F^T PPred^-1, with both covariances symmetric
+                Eigen::LDLT<Covariance<State>> PPred( step.PPred );
+                success = success && PPred.info() == Eigen::Success;
+                const Covariance<State> C = PPred.solve( step.F * step.P ).transpose();
+                
+                xSmooth[k] = step.x + C * ( xSmooth[k + 1] - step.xPred );
+                PSmooth[k] = step.P + C * ( PSmooth[k + 1] - step.PPred ) * C.transpose();
+            }
+            return success;
+        }
+        
+        //! The number of recorded predictions
+        size_t size() const
+        {
+            return steps.size();
+        }
+        
+        /**
+         * @brief The smoothed estimate before the given prediction, or the final one for size()
+         */
+        const State& getSmoothedState( size_t k ) const
+        {
+            return xSmooth[k];
+        }
+        
+        const Covariance<State>& getSmoothedCovariance( size_t k ) const
+        {
+            return PSmooth[k];
+        }
+    };
+}
+
+#endif
@@ -29,6 +29,8 @@ namespace Kalman {
     class ExtendedKalmanFilter;
     template<class StateType>
     class SquareRootExtendedKalmanFilter;
+    template<class StateType>
+    class ExtendedKalmanSmoother;
     
     /**
      * @brief Abstract base class of all linearized (first order taylor expansion) system models
@@ -42,6 +44,7 @@ namespace Kalman {
     {
         friend class ExtendedKalmanFilter<StateType>;
         friend class SquareRootExtendedKalmanFilter<StateType>;
+        friend class ExtendedKalmanSmoother<StateType>;
     public:
         //! System model base
         typedef SystemModel<StateType, ControlType, CovarianceBase> Base;
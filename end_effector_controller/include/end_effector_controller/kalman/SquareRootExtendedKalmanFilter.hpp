@@ -131,6 +131,15 @@ namespace Kalman {
         {
             m.updateJacobians( x );
             
+            if constexpr ( DiagonalMeasurementNoise<Measurement>::value )
+            {
+                if( sequentialUpdate( m, z ) )
+                {
+                    return this->getState();
+                }
+                // Fall back to the batch update below
+            }
+            
             // COMPUTE KALMAN GAIN
             // compute innovation covariance
             CovarianceSquareRoot<Measurement> S_y;
@@ -151,6 +160,53 @@ namespace Kalman {
             return this->getState();
         }
     protected:
+        /**
+         * @brief Update with one measurement component at a time
+         *
+         * Equivalent to the batch update for uncorrelated measurement noise, since all
+         * components use the same linearization. With \f$ P = SS^T \f$ and the Jacobian row
+         * \f$ h \f$, each step computes \f$ u = S^T h^T \f$, the scalar innovation variance
+         * \f$ s = u^T u + r \f$ and the gain \f$ k = Su / s \f$, and downdates the square root with
+         *
+         *     \f[ SS^T \leftarrow SS^T - (Su)(Su)^T / s \f]
+         *
+         * instead of decomposing the updated covariance again.
+         *
+         * If a downdate fails, state and covariance are left as they were.
+         *
+         * @param [in] m The Measurement model with updated Jacobians
+         * @param [in] z The measurement vector
+         * @return True on success, false on failure due to numerical issue
+         */
+        template<class Measurement, template<class> class CovarianceBase>
+        bool sequentialUpdate( MeasurementModelType<Measurement, CovarianceBase>& m, const Measurement& z )
+        {
+            typedef Matrix<T, State::RowsAtCompileTime, 1> Column;
+            
+            // Innovation and noise w.r.t. the prior estimate
+            const Measurement innovation = z - m.h( x );
+            const Covariance<Measurement> R = m.V * m.getCovariance() * m.V.transpose();
+            
+            const CovarianceSquareRoot<State> S_prior = S;
+            Column dx = Column::Zero();
+            for( int i = 0; i < Measurement::RowsAtCompileTime; ++i )
+            {
+                const Column u = S.matrixU() * m.H.row(i).transpose();
+                const Column PHt = S.matrixL() * u;
+                const T s = u.squaredNorm() + R(i, i);
+                
+                dx += PHt * ( ( innovation(i) - m.H.row(i).dot( dx ) ) / s );
+                S.rankUpdate( PHt, -1 / s );
+                if( S.info() == Eigen::NumericalIssue )
+                {
+                    S = S_prior;
+                    return false;
+                }
+            }
+            x += dx;
+            
+            return true;
+        }
         
         /**
          * @brief Compute the predicted state or innovation covariance (as square root)
@@ -281,7 +281,15 @@ namespace Kalman {
                     = (sigmaStatePoints.colwise() - x).cwiseProduct( W ).eval()
                     * (sigmaMeasurementPoints.colwise() - y).transpose();
             
-            K = S_y.solve(P.transpose()).transpose();
+            if constexpr ( Measurement::RowsAtCompileTime == 1 )
+            {
+                const T s_y = S_y.matrixLLT()(0, 0);
+                K = P / ( s_y * s_y );
+            }
+            else
+            {
+                K = S_y.solve(P.transpose()).transpose();
+            }
             return true;
         }
         
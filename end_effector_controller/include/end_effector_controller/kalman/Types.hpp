@@ -24,6 +24,8 @@
 
 #include "Matrix.hpp"
 
+#include <type_traits>
+
 namespace Kalman
 {
     /**
@@ -70,6 +72,23 @@ namespace Kalman
     using Jacobian = Matrix<typename A::Scalar,
                             A::RowsAtCompileTime,
                             B::RowsAtCompileTime>;
+    
+    /**
+     * @class Kalman::DiagonalMeasurementNoise
+     * @brief Trait for measurements with uncorrelated noise components
+     *
+     * Filters update with such measurements one component at a time, which avoids
+     * inverting the innovation covariance. Scalar measurements are always processed this way.
+     * Specialize as std::true_type for measurement types whose noise covariance
+     * \f$ VRV^T \f$ is diagonal.
+     *
+     * @param Measurement The measurement type
+     */
+    template<class Measurement>
+    struct DiagonalMeasurementNoise
+        : std::integral_constant<bool, Measurement::RowsAtCompileTime == 1>
+    {
+    };
 }
 
 #endif
@@ -250,7 +250,14 @@ namespace Kalman {
                     = (sigmaStatePoints.colwise() - x).cwiseProduct( W ).eval()
                     * (sigmaMeasurementPoints.colwise() - y).transpose();
             
-            K = P_xy * P_yy.inverse();
+            if constexpr ( Measurement::RowsAtCompileTime == 1 )
+            {
+                K = P_xy / P_yy(0, 0);
+            }
+            else
+            {
+                K = P_xy * P_yy.inverse();
+            }
             return true;
         }
         
@@ -266,7 +273,14 @@ namespace Kalman {
         template<class Measurement>
         bool updateStateCovariance(const KalmanGain<Measurement>& K, const Covariance<Measurement>& P_yy)
         {
-            P -= K * P_yy * K.transpose();
+            if constexpr ( Measurement::RowsAtCompileTime == 1 )
+            {
+                P.noalias() -= P_yy(0, 0) * K * K.transpose();
+            }
+            else
+            {
+                P -= K * P_yy * K.transpose();
+            }
             return true;
         }
     };
@@ -0,0 +1,129 @@
+#ifndef MEASUREMENT_BUFFER_H_INCLUDED
+#define MEASUREMENT_BUFFER_H_INCLUDED
+
+#include <cartesian_controller_base/RingBuffer.h>
+
+namespace end_effector_controller
+{
+/**
+ * @brief A force measurement with the stamp of its message
+ */
+struct ForceSample
+{
+  double time = 0.0;
+  double force = 0.0;
+};
+
+/**
+ * @brief Match delayed force measurements to kinematic samples by their stamps
+ *
+ * The force-torque sensor's messages arrive later than the kinematics of the
+ * same instant, by a latency that depends on the sensor and the transport.
+ * This buffer keeps both streams with their stamps. A kinematic sample is
+ * released once there is a force measurement at or after its stamp, together
+ * with the force linearly interpolated at that stamp. Samples older than the
+ * oldest buffered force can't be matched and are skipped.
+ *
+ * Both streams must be pushed in the order of their stamps. The storage is
+ * fixed, so nothing allocates. If a stream outgrows its capacity, its oldest
+ * entries are overwritten.
+ *
+ * @tparam Sample Copy-assignable kinematic sample type
+ * @tparam N Capacity of each stream
+ */
+template <typename Sample, size_t N>
+class MeasurementBuffer
+{
+public:
+  /**
+   * @brief Add a kinematic sample
+   *
+   * @return False if the oldest pending sample got overwritten
+   */
+  bool addSample(double time, const Sample & sample)
+  {
+    const bool overwrite = m_samples.full();
+    m_samples.push(Entry{time, sample});
+    return !overwrite;
+  }
+
+  /**
+   * @brief Add a force measurement. Ignores it if it's older than the newest one.
+   */
+  void addForce(const ForceSample & force)
+  {
+    if (m_forces.empty() || force.time >= m_forces.back().time)
+    {
+      m_forces.push(force);
+    }
+  }
+
+  /**
+   * @brief Release the oldest kinematic sample whose force is known
+   *
+   * @param [out] time The sample's stamp
+   * @param [out] sample The sample
+   * @param [out] force The force interpolated at the sample's stamp
+   *
+   * @return False if no sample can be matched yet
+   */
+  bool pop(double & time, Sample & sample, double & force)
+  {
+    while (!m_samples.empty() && !m_forces.empty())
+    {
+      const Entry & oldest = m_samples.front();
+      if (oldest.time > m_forces.back().time)
+      {
+        return false;  // The force of this instant is yet to come
+      }
+      if (oldest.time < m_forces.front().time)
+      {
+        m_samples.pop();  // Too old to ever be matched
+        continue;
+      }
+
+      // Forces older than the last one before this sample aren't needed anymore
+      while (m_forces.size() > 1 && m_forces[1].time <= oldest.time)
+      {
+        m_forces.pop();
+      }
+
+      const ForceSample & before = m_forces.front();
+      force = before.force;
+      if (m_forces.size() > 1 && m_forces[1].time > before.time)
+      {
+        const ForceSample & after = m_forces[1];
+        force += (after.force - before.force) * (oldest.time - before.time) /
+                 (after.time - before.time);
+      }
+      time = oldest.time;
+      sample = oldest.sample;
+      m_samples.pop();
+      return true;
+    }
+    return false;
+  }
+
+  void clear()
+  {
+    m_samples.clear();
+    m_forces.clear();
+  }
+
+  //! The number of kinematic samples waiting for their force
+  size_t pending() const { return m_samples.size(); }
+
+private:
+  struct Entry
+  {
+    double time;
+    Sample sample;
+  };
+
+  cartesian_controller_base::RingBuffer<Entry, N> m_samples;
+  cartesian_controller_base::RingBuffer<ForceSample, N> m_forces;
+};
+
+}  // namespace end_effector_controller
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef MOTION_PROFILE_H_INCLUDED
+#define MOTION_PROFILE_H_INCLUDED
+
+#include <Eigen/Dense>
+
+namespace end_effector_controller
+{
+/**
+ * @brief Bounds on the magnitudes of velocity, acceleration and jerk
+ */
+struct MotionLimits
+{
+  double velocity;
+  double acceleration;
+  double jerk;
+};
+
+/**
+ * @brief Time-optimal, jerk-limited motion from rest to rest along a distance
+ *
+ * A double S velocity profile: the acceleration ramps up and down with the
+ * jerk limit, the velocity possibly cruises at its limit, and the deceleration
+ * mirrors the acceleration. Short distances don't reach the velocity or
+ * acceleration limit.
+ *
+ * An infinite distance accelerates to the velocity limit and keeps it.
+ */
+class JerkLimitedProfile
+{
+public:
+  /**
+   * @brief Plan the motion
+   *
+   * @param distance The non-negative distance, possibly infinite
+   * @param limits Positive limits
+   */
+  void plan(double distance, const MotionLimits & limits);
+
+  //! The time until the motion stops, infinite for an infinite distance
+  double duration() const { return 2 * m_acceleration_time + m_cruise_time; }
+
+  //! The distance travelled at the time since the start
+  double position(double time) const;
+
+private:
+  //! The distance travelled while accelerating
+  double accelerating(double time) const;
+
+  double m_distance = 0.0;
+  double m_jerk = 0.0;
+  double m_jerk_time = 0.0;          // Of one ramp of the acceleration
+  double m_acceleration_time = 0.0;  // Until the highest velocity
+  double m_cruise_time = 0.0;
+  double m_acceleration = 0.0;  // Highest acceleration
+  double m_velocity = 0.0;      // Highest velocity
+};
+
+/**
+ * @brief Jerk-limited straight line motion, sampled at the actual control period
+ *
+ * Stepping by each cycle's period keeps the motion's velocity independent of
+ * the update rate.
+ */
+class LinearMotion
+{
+public:
+  //! Move from rest at one point to rest at another
+  void start(const Eigen::Vector3d & from, const Eigen::Vector3d & to, const MotionLimits & limits);
+
+  //! Move from rest in a direction without stopping
+  void startEndless(const Eigen::Vector3d & from, const Eigen::Vector3d & direction,
+                    const MotionLimits & limits);
+
+  //! The position after the time step
+  Eigen::Vector3d step(double period);
+
+  //! Whether the motion stopped at its goal
+  bool finished() const { return m_time >= m_profile.duration(); }
+
+private:
+  JerkLimitedProfile m_profile;
+  Eigen::Vector3d m_start = Eigen::Vector3d::Zero();
+  Eigen::Vector3d m_direction = Eigen::Vector3d::Zero();  // Unit length or zero
+  double m_time = 0.0;
+};
+
+}  // namespace end_effector_controller
+
+#endif
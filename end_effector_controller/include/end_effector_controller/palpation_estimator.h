@@ -0,0 +1,158 @@
+#ifndef PALPATION_ESTIMATOR_H_INCLUDED
+#define PALPATION_ESTIMATOR_H_INCLUDED
+
+#include <cartesian_controller_base/SpscQueue.h>
+#include <cartesian_controller_base/TripleBuffer.h>
+#include <end_effector_controller/measurement_buffer.h>
+#include <end_effector_controller/tissue_filter.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace end_effector_controller
+{
+/**
+ * @brief One control cycle of the palpation
+ */
+struct PalpationSample
+{
+  double time = 0.0;
+  double previous_position = 0.0;
+  double target_position = 0.0;
+  double position = 0.0;  // End-effector position along z
+  double velocity = 0.0;  // End-effector velocity along z
+  double force = 0.0;     // Contact force, positive into the tissue, matched by the estimator
+  bool first = false;     // Starts a new palpation, estimated with a fresh filter
+};
+
+/**
+ * @brief The tissue parameters after one estimation step
+ */
+struct TissueEstimate
+{
+  double time = 0.0;  // Of the sample that got estimated
+  double velocity = 0.0;
+  double measured_velocity = 0.0;  // Positive into the tissue
+  double elasticity = 0.0;
+  double viscosity = 0.0;
+  double exponent = 0.0;
+  double force = 0.0;  // Contact force of the estimated state
+  double measured_force = 0.0;
+};
+
+/**
+ * @brief Estimate the tissue parameters in a background thread
+ *
+ * The control loop pushes one \ref PalpationSample per cycle into a
+ * preallocated lock-free single-producer single-consumer queue and reads the
+ * newest \ref TissueEstimate from a triple buffer. Neither blocks. The
+ * force-torque sensor's callback pushes its stamped measurements into a
+ * second queue. A background thread drains both queues and runs a
+ * \ref TissueFilter on them. Each palpation gets a fresh filter, since the
+ * filters' state starts at contact with the tissue.
+ *
+ * The force measurements lag behind the kinematics. The estimator matches
+ * them by their stamps in a \ref MeasurementBuffer and runs the filters with
+ * the force interpolated at each sample's stamp, once that's known, and with
+ * the time step between the samples' stamps.
+ * If a queue is full, its samples are dropped and counted.
+ */
+class PalpationEstimator
+{
+public:
+  /**
+   * @brief Called in the estimator thread after each step
+   *
+   * Gets the estimated sample, with its matched force, and the estimate.
+   */
+  typedef std::function<void(const PalpationSample &, const TissueEstimate &)> Callback;
+
+  //! How many samples can wait for their force
+  static constexpr size_t kBufferSize = 128;
+
+  PalpationEstimator();
+  ~PalpationEstimator();
+
+  /**
+   * @brief Allocate the queues
+   *
+   * Call it once before any producer exists, e.g. before subscribing to the
+   * force-torque sensor. Later \ref start calls only clear the queues.
+   *
+   * @param capacity The number of samples each queue holds
+   */
+  void allocate(size_t capacity);
+
+  /**
+   * @brief Clear the queues and start the estimator thread
+   *
+   * Safe while the producers keep pushing, since it only consumes.
+   *
+   * @param config The filter to run. Each \ref PalpationSample::first creates a fresh one.
+   * @param period How often the thread checks for new samples
+   * @param callback Optional, e.g. for publishing the estimates
+   *
+   * @return False for an invalid configuration, see \ref makeTissueFilter
+   */
+  bool start(const TissueFilterConfig & config, std::chrono::nanoseconds period,
+             Callback callback);
+
+  /**
+   * @brief Estimate the remaining samples and stop the estimator thread
+   */
+  void stop();
+
+  /**
+   * @brief Queue one sample for estimation
+   *
+   * Doesn't block, allocate or print and is safe to call in the control loop.
+   * The sample's force is ignored, see \ref pushForce.
+   *
+   * @return False if the sample got dropped
+   */
+  bool push(const PalpationSample & sample);
+
+  /**
+   * @brief Queue one force measurement, positive into the tissue
+   *
+   * Doesn't block or allocate. Call it from a single thread, e.g. the sensor's callback.
+   *
+   * @return False if the measurement got dropped
+   */
+  bool pushForce(const ForceSample & force);
+
+  /**
+   * @brief Get the newest estimate
+   *
+   * Safe to call in the control loop.
+   *
+   * @return True if there was a new estimate since the last read, false otherwise
+   */
+  bool read(TissueEstimate & estimate) { return m_estimates.read(estimate); }
+
+  bool running() const { return m_running; }
+  size_t dropped() const { return m_dropped; }
+
+private:
+  void run(std::chrono::nanoseconds period);
+  void estimate(const PalpationSample & sample, double force);
+
+  TissueFilterConfig m_config;
+  std::unique_ptr<TissueFilter> m_filter;
+  Callback m_callback;
+  MeasurementBuffer<PalpationSample, kBufferSize> m_buffer;
+  double m_time;  // Of the last estimated sample
+  cartesian_controller_base::SpscQueue<PalpationSample> m_samples;
+  cartesian_controller_base::SpscQueue<ForceSample> m_forces;
+  cartesian_controller_base::TripleBuffer<TissueEstimate> m_estimates;
+  std::atomic<size_t> m_dropped;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+}  // namespace end_effector_controller
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef PALPATION_PLANNER_H_INCLUDED
+#define PALPATION_PLANNER_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace end_effector_controller
+{
+/**
+ * @brief Where and in which order to palpate
+ */
+struct PalpationPlannerConfig
+{
+  //! Sites as x, y pairs, relative to the starting position. Empty to palpate the region.
+  std::vector<double> sites;
+
+  //! Minimum x, minimum y, maximum x and maximum y, relative to the starting position
+  std::vector<double> region = {0.0, 0.0, 0.045, 0.045};
+
+  /**
+   * @brief Distance of the sites of the region's grid
+   *
+   * Also applies to given sites. Those at most 1.5 times as far apart are
+   * neighbours, and the serpentine's columns are sites within half of it
+   * along x. Zero with given sites to use their smallest spacing.
+   */
+  double resolution = 0.0025;
+
+  //! serpentine or nearest_neighbor
+  std::string ordering = "serpentine";
+
+  /**
+   * @brief Largest height difference of the surface around two neighbouring sites
+   *
+   * Up to that, the end effector moves between them at a clearance above the
+   * surface instead of retracting fully. Negative to always retract fully.
+   */
+  double height_tolerance = 0.001;
+
+  //! Height above the surface for moving between neighbouring sites
+  double clearance = 0.005;
+};
+
+/**
+ * @brief Orders the palpation sites and decides how far to retract between them
+ *
+ * The sites are either given or form a grid over a rectangular region. A
+ * serpentine visits the grid's columns in alternating directions. The nearest
+ * neighbour ordering starts next to the starting position and shortens its
+ * tour with 2-opt, which suits irregular sites. Both plan once, in \ref
+ * configure.
+ *
+ * Palpating a site reveals the surface height there. Moving on to a
+ * neighbouring site only needs a clearance above the surface if the known
+ * heights around the two sites are similar. That saves most of the full
+ * retract and of the slow descent that follows.
+ */
+class PalpationPlanner
+{
+public:
+  struct Site
+  {
+    double x;
+    double y;
+  };
+
+  /**
+   * @brief Plan the sites of the configuration
+   *
+   * @param config The sites and how to order them
+   * @param x The x coordinate of the starting position, which the sites are relative to
+   * @param y The y coordinate of the starting position
+   *
+   * @return False for an invalid configuration, e.g. an odd number of site
+   * coordinates, an empty region, a resolution that's not positive for the
+   * region or an unknown ordering
+   */
+  bool configure(const PalpationPlannerConfig & config, double x, double y);
+
+  //! The number of sites
+  std::size_t size() const { return m_sites.size(); }
+
+  //! The position of the current site in the tour
+  std::size_t index() const { return m_index; }
+
+  //! Whether all sites are palpated
+  bool done() const { return m_index >= m_sites.size(); }
+
+  //! The current site. Requires one that's not done.
+  const Site & site() const { return m_sites[m_index]; }
+
+  //! Move on to the next site
+  void next();
+
+  //! Remember the surface height at the current site
+  void setSurfaceHeight(double z);
+
+  //! The highest known surface around the current site, NaN if unknown
+  double surfaceHeight() const;
+
+  /**
+   * @brief The height to move at from the current site to the next one
+   *
+   * @param full_height The height of a full retract
+   *
+   * @return A clearance above the known surface around both sites if they
+   * are neighbours and that surface is flat enough, the full height otherwise
+   */
+  double retractHeight(double full_height) const;
+
+  //! The distance of the tour in the xy plane
+  double length() const;
+
+private:
+  bool isNeighbour(const Site & a, const Site & b) const;
+
+  void orderSerpentine();
+  void orderNearestNeighbor();
+
+  std::vector<Site> m_sites;
+  std::vector<double> m_heights;  // NaN where unknown
+  std::size_t m_index = 0;
+  double m_resolution = 0.0;
+  double m_height_tolerance = 0.0;
+  double m_clearance = 0.0;
+};
+
+}  // namespace end_effector_controller
+
+#endif
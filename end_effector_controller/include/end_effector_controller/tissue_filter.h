@@ -0,0 +1,92 @@
+#ifndef TISSUE_FILTER_H_INCLUDED
+#define TISSUE_FILTER_H_INCLUDED
+
+#include <end_effector_controller/SystemModelF.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace end_effector_controller
+{
+/**
+ * @brief How to estimate the tissue parameters
+ */
+struct TissueFilterConfig
+{
+  //! bank, ekf, ukf, sr_ekf or sr_ukf
+  std::string type = "bank";
+
+  //! double or float
+  std::string precision = "double";
+
+  double mass = 0.05;
+  double time_step = 0.002;
+
+  /**
+   * @brief Hunt-Crossley exponents and priors
+   *
+   * A bank runs one filter per combination. The other filters start from the
+   * middle entry of each.
+   */
+  std::vector<double> exponents = {1.2, 1.35, 1.5};
+  std::vector<double> elasticities = {500.0, 1000.0, 2000.0};
+  std::vector<double> viscosities = {500.0, 1000.0, 2000.0};
+
+  //! Initial velocity, positive into the tissue
+  double velocity = 0.0;
+
+  /**
+   * @brief Initial variances of the penetration and velocity
+   *
+   * The unscented filters sample the model at this spread and diverge for
+   * penetrations that are far off.
+   */
+  double state_variance = 1e-6;
+
+  //! Initial variances of the elasticity and viscosity
+  double parameter_variance = 1000.0;
+};
+
+/**
+ * @brief Estimates the viscoelastic tissue parameters from force and velocity
+ *
+ * Common interface of the Kalman filters in \c kalman and the \ref FilterBank,
+ * all with the system model of \ref SystemModel and the velocity measurement of
+ * \ref ForceMeasurementModel. Create them with \ref makeTissueFilter.
+ *
+ * The virtual calls cost a few nanoseconds per step. That's negligible
+ * compared to the filters themselves.
+ */
+class TissueFilter
+{
+public:
+  typedef KalmanExamples2::Estimation::State<double> State;
+
+  virtual ~TissueFilter() = default;
+
+  //! Set the time between two predictions
+  virtual void setTimeStep(double time_step) = 0;
+
+  //! Predict with the contact force, positive into the tissue
+  virtual void predict(double force) = 0;
+
+  //! Update with the measured velocity, positive into the tissue
+  virtual void update(double velocity) = 0;
+
+  virtual State state() const = 0;
+
+  //! The (estimated) Hunt-Crossley exponent
+  virtual double exponent() const = 0;
+};
+
+/**
+ * @brief Create the filter of the given configuration
+ *
+ * @return Null for an unknown type or precision or empty priors
+ */
+std::unique_ptr<TissueFilter> makeTissueFilter(const TissueFilterConfig & config);
+
+}  // namespace end_effector_controller
+
+#endif
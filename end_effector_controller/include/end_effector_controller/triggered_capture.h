@@ -0,0 +1,128 @@
+#ifndef TRIGGERED_CAPTURE_H_INCLUDED
+#define TRIGGERED_CAPTURE_H_INCLUDED
+
+#include <cartesian_controller_base/RingBuffer.h>
+
+#include <algorithm>
+
+namespace end_effector_controller
+{
+/**
+ * @brief Record continuously, but release only the windows around triggers
+ *
+ * Every record goes into a ring buffer. Outside of a window, the buffer keeps
+ * only the newest pre-trigger records. A triggering record opens a window,
+ * which releases the buffered pre-trigger records, the triggering ones and
+ * the post-trigger records after the last trigger. Drain the released records
+ * with \ref pop.
+ *
+ * The storage is fixed, so nothing allocates. Released records that aren't
+ * drained before the buffer is full get overwritten and count as dropped.
+ *
+ * @tparam Record Copy-assignable record type
+ * @tparam N Capacity, which also caps the pre-trigger records
+ */
+template <typename Record, size_t N>
+class TriggeredCapture
+{
+public:
+  /**
+   * @brief Set the number of records to keep before and after a window's triggers
+   */
+  void setWindow(size_t pre_trigger, size_t post_trigger)
+  {
+    m_pre_trigger = std::min(pre_trigger, N);
+    m_post_trigger = post_trigger;
+  }
+
+  /**
+   * @brief Record one cycle
+   *
+   * @param record The cycle's record
+   * @param trigger Whether the record is of interest
+   */
+  void add(const Record & record, bool trigger)
+  {
+    if (trigger)
+    {
+      m_remaining = m_post_trigger;
+      m_active = true;
+    }
+    else if (m_remaining > 0)
+    {
+      --m_remaining;
+      m_active = true;
+    }
+    else
+    {
+      m_active = false;
+    }
+
+    if (m_records.full() && m_released > 0)
+    {
+      --m_released;
+      ++m_dropped;
+    }
+    m_records.push(record);
+
+    if (m_active)
+    {
+      m_released = m_records.size();
+    }
+    else
+    {
+      // Keep the newest pre-trigger records once the released ones are drained
+      while (m_released == 0 && m_records.size() > m_pre_trigger)
+      {
+        m_records.pop();
+      }
+    }
+  }
+
+  /**
+   * @brief Take the oldest released record
+   *
+   * @return False if there is none
+   */
+  bool pop(Record & record)
+  {
+    if (m_released == 0)
+    {
+      return false;
+    }
+    record = m_records.front();
+    m_records.pop();
+    --m_released;
+    return true;
+  }
+
+  //! Whether the last record was inside a window
+  bool active() const { return m_active; }
+
+  //! The number of released records to drain
+  size_t released() const { return m_released; }
+
+  //! The number of released records that got overwritten before they were drained
+  size_t dropped() const { return m_dropped; }
+
+  void clear()
+  {
+    m_records.clear();
+    m_released = 0;
+    m_remaining = 0;
+    m_active = false;
+  }
+
+private:
+  cartesian_controller_base::RingBuffer<Record, N> m_records;
+  size_t m_pre_trigger = 0;
+  size_t m_post_trigger = 0;
+  size_t m_released = 0;   // The oldest records that may be drained
+  size_t m_remaining = 0;  // Post-trigger records still to release
+  size_t m_dropped = 0;
+  bool m_active = false;
+};
+
+}  // namespace end_effector_controller
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Compare the viscoelastic estimator's single EKF with a bank of EKFs over a
+ * grid of Hunt-Crossley exponents and priors. Both estimate the parameters of
+ * a simulated palpation of a tissue the single filter's prior doesn't fit.
+ * Reports the cycle time of both and the number of cycles until their
+ * elasticity estimates stay within 10% of the true value.
+ *
+ * The palpation is simulated twice: with the filters' own explicit Euler
+ * step, whose parameters the filters can identify exactly, and with a ten
+ * times finer integration like a real tissue. On the latter, the bank's
+ * estimates are biased, since an Euler step adds energy that the filters
+ * compensate with extra viscosity. The benchmark reports that bias.
+ *
+ * Usage: benchmark_filter_bank [number of cycles] [seed]
+ *
+ * Returns non-zero if a single-filter bank disagrees with the EKF, if the
+ * bank's final elasticity or viscosity isn't within 10% of the true value
+ * on the filters' own model, or if its elasticity isn't within 10% on the
+ * finer integration.
+ */
+
+#include <end_effector_controller/FilterBank.hpp>
+#include <end_effector_controller/ForceMeasurementModel.hpp>
+#include <end_effector_controller/SystemModelF.hpp>
+#include <end_effector_controller/kalman/ExtendedKalmanFilter.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace KalmanExamples2;
+
+namespace
+{
+typedef double T;
+typedef Estimation::State<T> State;
+
+struct Input
+{
+  T force;
+  T velocity;
+};
+
+// The simulated tissue. The filters' explicit Euler step is only stable with
+// enough damping, so the tissue is quite viscous.
+constexpr T kExponent = 1.5;
+constexpr T kElasticity = 2500.0;
+constexpr T kViscosity = 4000.0;
+
+constexpr T kMass = 0.05;
+constexpr T kTimeStep = 0.002;
+
+State initialState(T elasticity, T viscosity)
+{
+  State x;
+  x.x1() = 0.0;
+  x.x2() = 0.0;
+  x.x3() = elasticity;
+  x.x4() = viscosity;
+  return x;
+}
+
+Kalman::Covariance<State> initialCovariance()
+{
+  Kalman::Covariance<State> cov;
+  cov.setZero();
+  cov(0, 0) = 1.0;
+  cov(1, 1) = 1.0;
+  cov(2, 2) = 1000.0;
+  cov(3, 3) = 1000.0;
+  return cov;
+}
+
+/**
+ * @brief Number of cycles until the elasticity estimate stays within 10% of the tissue's
+ */
+size_t convergence(const std::vector<State> & estimates)
+{
+  size_t cycles = estimates.size();
+  while (cycles > 0 && std::abs(estimates[cycles - 1].x3() - kElasticity) <= 0.1 * kElasticity)
+  {
+    --cycles;
+  }
+  return cycles;
+}
+
+bool withinTenPercent(T estimate, T value) { return std::abs(estimate - value) <= 0.1 * value; }
+
+/**
+ * @brief Palpation with a periodic contact force and noisy velocity measurements
+ *
+ * @param steps Integration steps per cycle. With one, it's the filters' discrete model.
+ */
+std::vector<Input> simulate(int count, unsigned seed, int steps)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 0.000005);  // As in ForceMeasurementModel
+  std::vector<Input> inputs(count);
+  double x = 0.0;
+  double v = 0.0;
+  const double dt = kTimeStep / steps;
+  for (int i = 0; i < count; ++i)
+  {
+    const double force = 0.3 - 0.2 * std::cos(2 * M_PI * 2.5 * i * kTimeStep);
+    for (int j = 0; j < steps; ++j)
+    {
+      const double power = std::pow(std::abs(x), kExponent);
+      x += dt * v;
+      v += dt / kMass * (force - power * kElasticity - power * v * kViscosity);
+    }
+    inputs[i].force = force;
+    inputs[i].velocity = v + noise(rng);
+  }
+  return inputs;
+}
+
+/**
+ * @brief A bank over a grid of exponents and priors
+ */
+void addGrid(Estimation::FilterBank<T> & bank)
+{
+  for (T n : {1.2, 1.35, 1.5, 1.65})
+  {
+    for (T elasticity : {500.0, 1000.0, 2000.0, 4000.0})
+    {
+      for (T viscosity : {250.0, 500.0, 1000.0, 2000.0})
+      {
+        bank.addHypothesis(n, initialState(elasticity, viscosity), initialCovariance());
+      }
+    }
+  }
+}
+
+double percent(T estimate, T value) { return 100.0 * (estimate - value) / value; }
+
+double nanoseconds(std::chrono::steady_clock::duration duration, size_t cycles)
+{
+  return std::chrono::duration<double, std::nano>(duration).count() / cycles;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  const int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+  const unsigned seed = argc > 2 ? std::atoi(argv[2]) : 42;
+
+  const std::vector<Input> inputs = simulate(count, seed, 1);
+
+  // The controller's single filter
+  Estimation::SystemModel<T> sys;
+  sys.setModelData(kMass, kTimeStep, 1.35);
+  Estimation::ForceMeasurementModel<T> fm;
+  Kalman::ExtendedKalmanFilter<State> ekf;
+  std::vector<State> single(count);
+  ekf.init(initialState(1000.0, 1000.0));
+  ekf.setCovariance(initialCovariance());
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    sys.setForce(inputs[i].force);
+    ekf.predict(sys);
+    Estimation::VelocityMeasurement<T> z;
+    z.v() = inputs[i].velocity;
+    single[i] = ekf.update(fm, z);
+  }
+  const double t_single = nanoseconds(std::chrono::steady_clock::now() - start, count);
+
+  // The same filter as a bank
+  Estimation::FilterBank<T> bank;
+  bank.setModelData(kMass, kTimeStep);
+  bank.addHypothesis(1.35, initialState(1000.0, 1000.0), initialCovariance());
+  double difference = 0.0;
+  for (int i = 0; i < count; ++i)
+  {
+    bank.predict(inputs[i].force);
+    bank.update(inputs[i].velocity);
+    const State x = bank.getState();
+    difference = std::max<double>(difference, std::abs(x.x3() - single[i].x3()) / single[i].x3());
+    difference = std::max<double>(difference, std::abs(x.x4() - single[i].x4()) / single[i].x4());
+  }
+
+  // A grid of exponents and priors
+  bank.clear();
+  addGrid(bank);
+  std::vector<State> multiple(count);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    bank.predict(inputs[i].force);
+    bank.update(inputs[i].velocity);
+    multiple[i] = bank.getState();
+  }
+  const double t_bank = nanoseconds(std::chrono::steady_clock::now() - start, count);
+
+  // The same grid on the finer integration
+  const std::vector<Input> fine_inputs = simulate(count, seed, 10);
+  Estimation::FilterBank<T> fine_bank;
+  fine_bank.setModelData(kMass, kTimeStep);
+  addGrid(fine_bank);
+  for (const Input & input : fine_inputs)
+  {
+    fine_bank.predict(input.force);
+    fine_bank.update(input.velocity);
+  }
+  const State fine = fine_bank.getState();
+
+  std::cout << "EKF: " << t_single << " ns per cycle, converged after " << convergence(single)
+            << " of " << count << " cycles to elasticity " << single.back().x3()
+            << " and viscosity " << single.back().x4() << std::endl;
+  std::cout << "Bank of " << bank.size() << " EKFs: " << t_bank << " ns per cycle ("
+            << t_bank / t_single << "x), converged after " << convergence(multiple)
+            << " cycles to elasticity " << multiple.back().x3() << ", viscosity "
+            << multiple.back().x4() << " and exponent " << bank.exponent() << std::endl;
+  std::cout << "Bank on the finer integration: elasticity " << fine.x3() << " ("
+            << percent(fine.x3(), kElasticity) << "%), viscosity " << fine.x4() << " ("
+            << percent(fine.x4(), kViscosity) << "%) and exponent " << fine_bank.exponent()
+            << std::endl;
+  std::cout << "Single-filter bank vs. EKF: max. relative difference " << difference
+            << std::endl;
+
+  const State x = multiple.back();
+  return difference < 1e-2 && withinTenPercent(x.x3(), kElasticity) &&
+             withinTenPercent(x.x4(), kViscosity) && withinTenPercent(fine.x3(), kElasticity)
+           ? 0
+           : 1;
+}
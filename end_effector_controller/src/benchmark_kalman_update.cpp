@@ -0,0 +1,236 @@
+/*
+ * Compare the sequential scalar measurement update of the Kalman filters
+ * against their general matrix update on the viscoelastic estimator, with its
+ * 4-state system model and 1-D velocity measurement, and measure the cycle time
+ * of both.
+ *
+ * Usage: benchmark_kalman_update [number of cycles] [seed]
+ *
+ * Returns non-zero if the updates disagree.
+ */
+
+#include <end_effector_controller/SystemModelF.hpp>
+#include <end_effector_controller/ForceMeasurementModel.hpp>
+#include <end_effector_controller/kalman/ExtendedKalmanFilter.hpp>
+#include <end_effector_controller/kalman/SquareRootExtendedKalmanFilter.hpp>
+#include <end_effector_controller/kalman/UnscentedKalmanFilter.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace KalmanExamples2;
+
+namespace
+{
+typedef double T;
+typedef Estimation::State<T> State;
+typedef Estimation::Control<T> Control;
+
+/**
+ * @brief The velocity measurement, processed with the general matrix update
+ */
+class DenseVelocityMeasurement : public Kalman::Vector<T, 1>
+{
+public:
+  KALMAN_VECTOR(DenseVelocityMeasurement, T, 1)
+
+  T & v() { return (*this)[0]; }
+};
+
+/**
+ * @brief The ForceMeasurementModel for DenseVelocityMeasurement
+ */
+template <template <class> class CovarianceBase>
+class DenseForceMeasurementModel
+: public Kalman::LinearizedMeasurementModel<State, DenseVelocityMeasurement, CovarianceBase>
+{
+public:
+  DenseForceMeasurementModel()
+  {
+    this->V.setIdentity();
+    this->V *= 0.000005;
+  }
+
+  DenseVelocityMeasurement h(const State & x) const
+  {
+    DenseVelocityMeasurement measurement;
+    measurement.v() = x.x2();
+    return measurement;
+  }
+
+protected:
+  void updateJacobians(const State &)
+  {
+    this->H.setZero();
+    this->H(0, State::VELOCITY) = 1.0;
+  }
+};
+}  // namespace
+
+namespace Kalman
+{
+template <>
+struct DiagonalMeasurementNoise<DenseVelocityMeasurement> : std::false_type
+{
+};
+}  // namespace Kalman
+
+namespace
+{
+struct Input
+{
+  T force;
+  T velocity;
+};
+
+State initialState()
+{
+  State x;
+  x.x1() = 0.0;
+  x.x2() = 0.01;
+  x.x3() = 1000.0;
+  x.x4() = 1000.0;
+  return x;
+}
+
+Kalman::Covariance<State> initialCovariance()
+{
+  Kalman::Covariance<State> cov;
+  cov.setZero();
+  cov(0, 0) = 1.0;
+  cov(1, 1) = 1.0;
+  cov(2, 2) = 1000.0;
+  cov(3, 3) = 1000.0;
+  return cov;
+}
+
+/**
+ * @brief Run a filter over the inputs
+ *
+ * @return The cycle time in nanoseconds
+ */
+template <class Filter, class System, class Model, class Measurement>
+double run(Filter & filter, System & sys, Model & model, const std::vector<Input> & inputs,
+           std::vector<State> & estimates)
+{
+  filter.init(initialState());
+  filter.setCovariance(initialCovariance());
+  estimates.resize(inputs.size());
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < inputs.size(); ++i)
+  {
+    sys.setForce(inputs[i].force);
+    filter.predict(sys);
+    Measurement z;
+    z.v() = inputs[i].velocity;
+    estimates[i] = filter.update(model, z);
+  }
+  const auto duration = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(duration).count() / inputs.size();
+}
+
+/**
+ * @brief Run only the filter's prediction over the inputs
+ *
+ * @return The cycle time in nanoseconds
+ */
+template <class Filter, class System>
+double runPredict(Filter & filter, System & sys, const std::vector<Input> & inputs)
+{
+  filter.init(initialState());
+  filter.setCovariance(initialCovariance());
+  T sum = 0.0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < inputs.size(); ++i)
+  {
+    sys.setForce(inputs[i].force);
+    sum += filter.predict(sys).x1();
+  }
+  const auto duration = std::chrono::steady_clock::now() - start;
+  volatile T sink = sum;
+  (void)sink;
+  return std::chrono::duration<double, std::nano>(duration).count() / inputs.size();
+}
+
+double maxDifference(const std::vector<State> & a, const std::vector<State> & b)
+{
+  double difference = 0.0;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    const double scale = std::max<double>(1.0, a[i].cwiseAbs().maxCoeff());
+    difference = std::max<double>(difference, (a[i] - b[i]).cwiseAbs().maxCoeff() / scale);
+  }
+  return difference;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+  const unsigned seed = argc > 2 ? std::atoi(argv[2]) : 42;
+
+  // A slow palpation cycle with noisy velocity measurements
+  std::mt19937 rng(seed);
+  std::normal_distribution<T> noise(0.0, 0.001);
+  std::vector<Input> inputs(count);
+  for (int i = 0; i < count; ++i)
+  {
+    const T t = i * 0.002;
+    inputs[i].force = 2.0 + 2.0 * std::sin(t);
+    inputs[i].velocity = 0.01 * std::cos(t) + noise(rng);
+  }
+
+  // The estimator's measurement noise is tiny compared to its state covariance.
+  // Rounding differences between both updates therefore grow to about 1e-4.
+  bool agree = true;
+  auto report = [&](const char * name, double predict, double general, double sequential,
+                    double difference)
+  {
+    std::cout << name << ": predict " << predict << " ns, update general " << general - predict
+              << " ns, sequential " << sequential - predict << " ns per cycle ("
+              << (general - predict) / (sequential - predict)
+              << "x), max. relative difference " << difference << std::endl;
+    agree = agree && difference < 1e-3;
+  };
+
+  std::vector<State> general, sequential;
+  {
+    Estimation::SystemModel<T> sys;
+    sys.setModelData(0.05, 0.002, 1.35);
+    DenseForceMeasurementModel<Kalman::StandardBase> dense;
+    Estimation::ForceMeasurementModel<T> scalar;
+    Kalman::ExtendedKalmanFilter<State> ekf;
+    const double t_general =
+      run<decltype(ekf), decltype(sys), decltype(dense), DenseVelocityMeasurement>(
+        ekf, sys, dense, inputs, general);
+    const double t_sequential =
+      run<decltype(ekf), decltype(sys), decltype(scalar), Estimation::VelocityMeasurement<T>>(
+        ekf, sys, scalar, inputs, sequential);
+    const double t_predict = runPredict(ekf, sys, inputs);
+    report("EKF", t_predict, t_general, t_sequential, maxDifference(general, sequential));
+  }
+  {
+    Estimation::SystemModel<T, Kalman::SquareRootBase> sys;
+    sys.setModelData(0.05, 0.002, 1.35);
+    DenseForceMeasurementModel<Kalman::SquareRootBase> dense;
+    Estimation::ForceMeasurementModel<T, Kalman::SquareRootBase> scalar;
+    Kalman::SquareRootExtendedKalmanFilter<State> ekf;
+    const double t_general =
+      run<decltype(ekf), decltype(sys), decltype(dense), DenseVelocityMeasurement>(
+        ekf, sys, dense, inputs, general);
+    const double t_sequential =
+      run<decltype(ekf), decltype(sys), decltype(scalar), Estimation::VelocityMeasurement<T>>(
+        ekf, sys, scalar, inputs, sequential);
+    const double t_predict = runPredict(ekf, sys, inputs);
+    report("SR-EKF", t_predict, t_general, t_sequential, maxDifference(general, sequential));
+  }
+
+  return agree ? 0 : 1;
+}
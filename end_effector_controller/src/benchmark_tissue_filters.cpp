@@ -0,0 +1,225 @@
+/*
+ * Run each tissue filter type in double and float precision over palpation
+ * data. Reports the time per prediction and per update, the RMS of the
+ * velocity innovations and, if the true tissue parameters are known, the
+ * error of the final elasticity and viscosity estimates.
+ *
+ * Usage: benchmark_tissue_filters [recording] [--elasticity E] [--viscosity D]
+ *
+ * The recording is a text table with a header line. It needs the columns
+ * `time`, `velocity` and `force` as published on /data_control, i.e. along
+ * the base's z axis. Without a recording, the tool simulates the palpation of
+ * a tissue with known parameters.
+ */
+
+#include <end_effector_controller/tissue_filter.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace end_effector_controller;
+
+namespace
+{
+struct Input
+{
+  double time;
+  double force;     // Positive into the tissue
+  double velocity;  // Positive into the tissue
+};
+
+/**
+ * @brief Read the time, velocity and force columns of a recording
+ */
+bool readRecording(const std::string & path, std::vector<Input> & inputs)
+{
+  std::ifstream file(path);
+  std::string line;
+  if (!std::getline(file, line))
+  {
+    std::cerr << "Can't read " << path << std::endl;
+    return false;
+  }
+
+  std::istringstream header(line);
+  std::vector<std::string> names;
+  std::string name;
+  while (header >> name)
+  {
+    names.push_back(name);
+  }
+  auto column = [&names](const std::string & name) {
+    return std::find(names.begin(), names.end(), name) - names.begin();
+  };
+  const size_t time = column("time");
+  const size_t velocity = column("velocity");
+  const size_t force = column("force");
+  if (time == names.size() || velocity == names.size() || force == names.size())
+  {
+    std::cerr << path << " needs the columns time, velocity and force" << std::endl;
+    return false;
+  }
+
+  std::vector<double> row(names.size());
+  while (std::getline(file, line))
+  {
+    std::istringstream values(line);
+    size_t i = 0;
+    while (i < row.size() && values >> row[i])
+    {
+      ++i;
+    }
+    if (i == row.size())
+    {
+      inputs.push_back({row[time], -row[force], -row[velocity]});
+    }
+  }
+  return !inputs.empty();
+}
+
+/**
+ * @brief Palpate a tissue with a periodic contact force and noisy velocity measurements
+ */
+std::vector<Input> simulate(double elasticity, double viscosity, size_t count)
+{
+  constexpr double kExponent = 1.5;
+  constexpr double kMass = 0.05;
+  constexpr double kTimeStep = 0.002;
+
+  std::mt19937 rng(42);
+  std::normal_distribution<double> noise(0.0, 0.000005);  // As in ForceMeasurementModel
+  std::vector<Input> inputs(count);
+  double x = 0.0;
+  double v = 0.0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const double force = 0.3 - 0.2 * std::cos(2 * M_PI * 2.5 * i * kTimeStep);
+    for (int j = 0; j < 10; ++j)
+    {
+      const double power = std::pow(std::abs(x), kExponent);
+      x += 0.1 * kTimeStep * v;
+      v += 0.1 * kTimeStep / kMass * (force - power * elasticity - power * v * viscosity);
+    }
+    inputs[i] = {i * kTimeStep, force, v + noise(rng)};
+  }
+  return inputs;
+}
+
+struct Result
+{
+  double predict = 0.0;  // ns
+  double update = 0.0;   // ns
+  double innovation = 0.0;  // RMS
+  TissueFilter::State state;
+};
+
+Result run(TissueFilter & filter, const std::vector<Input> & inputs)
+{
+  Result result;
+  std::chrono::steady_clock::duration predict(0);
+  std::chrono::steady_clock::duration update(0);
+  for (size_t i = 0; i < inputs.size(); ++i)
+  {
+    if (i > 0 && inputs[i].time > inputs[i - 1].time)
+    {
+      filter.setTimeStep(inputs[i].time - inputs[i - 1].time);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    filter.predict(inputs[i].force);
+    predict += std::chrono::steady_clock::now() - start;
+
+    const double innovation = inputs[i].velocity - filter.state().x2();
+    result.innovation += innovation * innovation;
+
+    start = std::chrono::steady_clock::now();
+    filter.update(inputs[i].velocity);
+    update += std::chrono::steady_clock::now() - start;
+  }
+  result.predict = std::chrono::duration<double, std::nano>(predict).count() / inputs.size();
+  result.update = std::chrono::duration<double, std::nano>(update).count() / inputs.size();
+  result.innovation = std::sqrt(result.innovation / inputs.size());
+  result.state = filter.state();
+  return result;
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  std::string recording;
+  double elasticity = std::nan("");
+  double viscosity = std::nan("");
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (arg == "--elasticity" && i + 1 < argc)
+    {
+      elasticity = std::atof(argv[++i]);
+    }
+    else if (arg == "--viscosity" && i + 1 < argc)
+    {
+      viscosity = std::atof(argv[++i]);
+    }
+    else
+    {
+      recording = arg;
+    }
+  }
+
+  std::vector<Input> inputs;
+  if (recording.empty())
+  {
+    elasticity = 2500.0;
+    viscosity = 400.0;
+    inputs = simulate(elasticity, viscosity, 20000);
+  }
+  else if (!readRecording(recording, inputs))
+  {
+    return 1;
+  }
+
+  std::cout << std::left << std::setw(8) << "filter" << std::setw(8) << "scalar" << std::right
+            << std::setw(12) << "predict/ns" << std::setw(12) << "update/ns" << std::setw(14)
+            << "innovation" << std::setw(14) << "elasticity" << std::setw(10) << "error"
+            << std::setw(14) << "viscosity" << std::setw(10) << "error" << std::endl;
+  for (const char * type : {"ekf", "sr_ekf", "ukf", "sr_ukf", "bank"})
+  {
+    for (const char * precision : {"double", "float"})
+    {
+      TissueFilterConfig config;
+      config.type = type;
+      config.precision = precision;
+      if (inputs.size() > 1)
+      {
+        config.time_step = inputs[1].time - inputs[0].time;
+      }
+      config.velocity = inputs.front().velocity;
+      std::unique_ptr<TissueFilter> filter = makeTissueFilter(config);
+      if (!filter)
+      {
+        std::cerr << "Can't create " << type << " in " << precision << std::endl;
+        return 1;
+      }
+
+      const Result result = run(*filter, inputs);
+      std::cout << std::left << std::setw(8) << type << std::setw(8) << precision << std::right
+                << std::fixed << std::setprecision(0) << std::setw(12) << result.predict
+                << std::setw(12) << result.update << std::scientific << std::setprecision(2)
+                << std::setw(14) << result.innovation << std::fixed << std::setprecision(0)
+                << std::setw(14) << result.state.x3() << std::setprecision(2) << std::setw(10)
+                << std::abs(result.state.x3() - elasticity) / elasticity << std::setprecision(0)
+                << std::setw(14) << result.state.x4() << std::setprecision(2) << std::setw(10)
+                << std::abs(result.state.x4() - viscosity) / viscosity << std::endl;
+    }
+  }
+  return 0;
+}
@@ -52,9 +52,13 @@
 namespace end_effector_controller
 {
 
-EndEffectorControl::EndEffectorControl() {}
+EndEffectorControl::EndEffectorControl()
+: m_force_bias(0.0), m_force_bias_reset(true), m_force_sum(0.0), m_force_sample(0),
+  m_force_sample_flag(false)
+{
+}
 
-EndEffectorControl::~EndEffectorControl() {}
+EndEffectorControl::~EndEffectorControl() { m_estimator.stop(); }
 
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 EndEffectorControl::on_activate(const rclcpp_lifecycle::State & previous_state)
@@ -95,18 +99,64 @@ EndEffectorControl::on_activate(const rclcpp_lifecycle::State & previous_state)
   m_current_pose = getEndEffectorPose();
   prev_pos = m_current_pose.pose.position.z;
   m_starting_position = m_current_pose.pose.position;
-  // Print starting pos 
-  std::cout << "Starting position: " << m_starting_position.x << ", " << m_starting_position.y << ", " << m_starting_position.z << std::endl;
+  RCLCPP_INFO(get_node()->get_logger(), "Starting position: %f, %f, %f", m_starting_position.x,
+              m_starting_position.y, m_starting_position.z);
   // m_starting_position.z -= 0.005;
   m_grid_position = m_starting_position;
+  m_retract_height = m_starting_position.z;
+
+  // Plan the palpation sites around the starting position
+  PalpationPlannerConfig planner;
+  planner.sites = get_node()->get_parameter("planner.sites").as_double_array();
+  planner.region = get_node()->get_parameter("planner.region").as_double_array();
+  planner.resolution = get_node()->get_parameter("planner.resolution").as_double();
+  planner.ordering = get_node()->get_parameter("planner.ordering").as_string();
+  planner.height_tolerance = get_node()->get_parameter("planner.height_tolerance").as_double();
+  planner.clearance = get_node()->get_parameter("planner.clearance").as_double();
+  if (!m_planner.configure(planner, m_starting_position.x, m_starting_position.y) ||
+      m_planner.done())
+  {
+    RCLCPP_ERROR(get_node()->get_logger(),
+                 "Invalid palpation sites. Give x, y pairs or a region of x_min, y_min, x_max, "
+                 "y_max with a positive resolution, ordered serpentine or nearest_neighbor");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  RCLCPP_INFO(get_node()->get_logger(), "Palpating %zu sites along %f m", m_planner.size(),
+              m_planner.length());
+  m_grid_position.x = m_planner.site().x;
+  m_grid_position.y = m_planner.site().y;
+
+  // Jerk-limited motions, faster in free space than towards the tissue
+  m_free_space.velocity = get_node()->get_parameter("motion.free_space.velocity").as_double();
+  m_free_space.acceleration =
+    get_node()->get_parameter("motion.free_space.acceleration").as_double();
+  m_free_space.jerk = get_node()->get_parameter("motion.free_space.jerk").as_double();
+  m_near_contact.velocity = get_node()->get_parameter("motion.near_contact.velocity").as_double();
+  m_near_contact.acceleration =
+    get_node()->get_parameter("motion.near_contact.acceleration").as_double();
+  m_near_contact.jerk = get_node()->get_parameter("motion.near_contact.jerk").as_double();
+  m_approach_distance = get_node()->get_parameter("motion.approach_distance").as_double();
+  for (const MotionLimits & limits : {m_free_space, m_near_contact})
+  {
+    if (!(limits.velocity > 0.0 && limits.acceleration > 0.0 && limits.jerk > 0.0))
+    {
+      RCLCPP_ERROR(get_node()->get_logger(),
+                   "Motion limits of velocity, acceleration and jerk must be positive");
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
+  }
+  m_target_pose.pose.position = m_starting_position;
+  m_motion.start(Eigen::Vector3d(m_starting_position.x, m_starting_position.y,
+                                 m_starting_position.z),
+                 Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_retract_height),
+                 m_free_space);
   // m_grid_position.x = -0.055691;
   // m_grid_position.y = 0.454190; // 0.514197;//
   m_sin_bias = 0.0045; // 0.0035;
   m_surface = m_current_pose.pose.position.z;
 
-  m_force_bias = 0.0; 
-  m_force_sample = 0;
-  m_force_sample_flag = false;
+  m_force_bias = 0.0;
+  m_force_bias_reset = true;
 
   m_ft_sensor_wrench(0) = 0.0;
   m_ft_sensor_wrench(1) = 0.0;
@@ -116,6 +166,52 @@ EndEffectorControl::on_activate(const rclcpp_lifecycle::State & previous_state)
   m_target_wrench(1) = 0.0;
   m_target_wrench(2) = 0.0;
 
+  // Estimate the tissue parameters of each palpation and publish them outside the control loop
+  TissueFilterConfig estimator;
+  estimator.type = get_node()->get_parameter("estimator.type").as_string();
+  estimator.precision = get_node()->get_parameter("estimator.precision").as_string();
+  estimator.exponents = get_node()->get_parameter("estimator.exponents").as_double_array();
+  estimator.elasticities = get_node()->get_parameter("estimator.elasticities").as_double_array();
+  estimator.viscosities = get_node()->get_parameter("estimator.viscosities").as_double_array();
+  estimator.velocity = -cartVel(2);
+  m_estimate = TissueEstimate();
+  m_palpation_start = false;
+  if (!m_estimator.start(estimator, std::chrono::milliseconds(1),
+                         [this](const PalpationSample & sample, const TissueEstimate & estimate)
+                         {
+                           m_estimator_msg.data[0] = estimate.velocity;
+                           m_estimator_msg.data[1] = estimate.measured_velocity;
+                           m_estimator_msg.data[2] = estimate.elasticity;
+                           m_estimator_msg.data[3] = estimate.viscosity;
+                           m_estimator_msg.data[4] = estimate.force;
+                           m_estimator_msg.data[5] = estimate.measured_force;
+                           m_estimator_publisher->publish(m_estimator_msg);
+                         }))
+  {
+    RCLCPP_ERROR_STREAM(get_node()->get_logger(),
+                        "Invalid estimator: " << estimator.type << " in " << estimator.precision
+                                              << ". Choose bank, ekf, ukf, sr_ekf or sr_ukf in "
+                                                 "double or float, with non-empty priors");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  // Discard the forces measured while inactive
+  ForceSample force;
+  while (m_force_samples.pop(force))
+  {
+  }
+  m_data_buffer.clear();
+
+  // Capture windows around contacts and palpations, published in batches
+  m_capture.setWindow(
+    std::max<int64_t>(get_node()->get_parameter("capture.pre_trigger").as_int(), 0),
+    std::max<int64_t>(get_node()->get_parameter("capture.post_trigger").as_int(), 0));
+  m_capture.clear();
+  m_capture_batch = std::max<int64_t>(get_node()->get_parameter("capture.batch").as_int(), 1);
+  m_capture_force = get_node()->get_parameter("capture.force_threshold").as_double();
+  m_data_msg.data.clear();
+  m_data_msg.data.reserve(m_capture_batch * std::tuple_size<DataRecord>::value);
+
   initial_time = get_node()->now();
 
 
@@ -125,6 +221,7 @@ EndEffectorControl::on_activate(const rclcpp_lifecycle::State & previous_state)
 
   m_phase = 1;
   m_palpation_number = 0;
+  m_leaving_tissue = false;
 
   m_contact = false;
 
@@ -135,9 +232,20 @@ EndEffectorControl::on_activate(const rclcpp_lifecycle::State & previous_state)
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 EndEffectorControl::on_deactivate(const rclcpp_lifecycle::State & previous_state)
 {
+  m_estimator.stop();
+  if (m_estimator.dropped() > 0)
+  {
+    RCLCPP_WARN(get_node()->get_logger(), "The estimator dropped %zu samples",
+                m_estimator.dropped());
+  }
+
   m_joint_state_pos_handles.clear();
   m_joint_state_vel_handles.clear();
   this->release_interfaces();
+  if (m_capture.dropped() > 0)
+  {
+    RCLCPP_WARN(get_node()->get_logger(), "Dropped %zu captured records", m_capture.dropped());
+  }
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
@@ -171,58 +279,62 @@ controller_interface::return_type EndEffectorControl::update(const rclcpp::Time
   // 2. Move the end effector in order to touch the surface of the tissue
   // 3. Move the end effector in order to palpate the tCL_issue
   // 4. Move the end effector in order to go back to the initial high
-  if ( m_grid_position.x > m_starting_position.x + 0.0451)
+  if (m_planner.done())
   {
+    RCLCPP_INFO_STREAM_ONCE(get_node()->get_logger(), "End of palpation");
+
+    // Finish the last capture window
+    publishDataEE(time);
     return controller_interface::return_type::OK;
-    RCLCPP_INFO_STREAM(get_node()->get_logger(), "End of palpation");
   }
   
   switch (m_phase)
   {
     case 1:
-      gridPosition();
+      gridPosition(period);
       break;
     case 2:
-      surfaceApproach();
+      surfaceApproach(period);
       break;
     case 3:
       tissuePalpation(time);
       break;
     case 4:
-      startingHigh();
+      startingHigh(period);
       break;
     default:
       break;
   }
 
+  // Hand the palpation over to the estimator
+  if (m_phase == 3)
+  {
+    PalpationSample sample;
+    sample.time = time.nanoseconds() * 1e-9;
+    sample.previous_position = prev_pos;
+    sample.target_position = m_target_pose.pose.position.z;
+    sample.position = m_current_pose.pose.position.z;
+    sample.velocity = cartVel(2);
+    sample.first = m_palpation_start;
+    m_palpation_start = false;
+    m_estimator.push(sample);
+  }
+  m_estimator.read(m_estimate);
+  prev_pos = m_current_pose.pose.position.z;
+
   // Publish the data
   publishDataEE(time);
 
   return controller_interface::return_type::OK;
 }
 
-void EndEffectorControl::gridPosition()
+void EndEffectorControl::gridPosition(const rclcpp::Duration & period)
 {
   // The end effector will move to the position of the palpation
-  if ( abs(m_target_pose.pose.position.x - m_grid_position.x) < 0.001)
-  {
-    m_target_pose.pose.position.x = m_grid_position.x;
-  }
-  else
-  {
-    m_target_pose.pose.position.x += std::copysign(0.005/500, m_grid_position.x - m_current_pose.pose.position.x);
-  }
-
-  if ( abs(m_target_pose.pose.position.y - m_grid_position.y) < 0.001)
-  {
-    m_target_pose.pose.position.y = m_grid_position.y;
-  }
-  else
-  {
-    m_target_pose.pose.position.y += std::copysign(0.005/500, m_grid_position.y - m_current_pose.pose.position.y);
-  }
-
-  m_target_pose.pose.position.z = m_starting_position.z;
+  const Eigen::Vector3d target = m_motion.step(period.seconds());
+  m_target_pose.pose.position.x = target.x();
+  m_target_pose.pose.position.y = target.y();
+  m_target_pose.pose.position.z = target.z();
 
   m_target_pose.header.stamp = get_node()->now();
   m_target_pose.header.frame_id = m_robot_base_link;
@@ -230,29 +342,45 @@ void EndEffectorControl::gridPosition()
   m_pose_publisher->publish(m_target_pose);
 
   // If the end effector is in the position of the palpation the phase is finished
-  if (abs(m_current_pose.pose.position.x - m_grid_position.x) < 0.001 &&
+  if (m_motion.finished() && abs(m_current_pose.pose.position.x - m_grid_position.x) < 0.001 &&
       abs(m_current_pose.pose.position.y - m_grid_position.y) < 0.001)
   {
     m_phase = 2;
+    startApproach();
     m_prev_force = 0.0;
-    std::cout << "Palpation number: " << m_palpation_number << std::endl;
-    std::cout << "Phase 2" << std::endl;
-    std::cout << "Bias " << m_force_bias << std::endl;
+    RCLCPP_DEBUG(get_node()->get_logger(), "Palpation %u: phase 2, force bias %f",
+                 m_palpation_number, m_force_bias.load());
     // m_surface = m_current_pose.pose.position.z;
-    m_force_bias = 0.0; 
-    m_force_sample = 0;
-    m_force_sample_flag = false;
+    m_force_bias = 0.0;
+    m_force_bias_reset = true;
   }
 }
 
-void EndEffectorControl::surfaceApproach()
+void EndEffectorControl::startApproach()
+{
+  // Close to the surface around the neighbouring sites, if known, in free space
+  const Eigen::Vector3d from(m_grid_position.x, m_grid_position.y, m_grid_position.z);
+  const double surface = m_planner.surfaceHeight();
+  if (!std::isnan(surface) && from.z() > surface + m_approach_distance)
+  {
+    m_motion.start(from, Eigen::Vector3d(from.x(), from.y(), surface + m_approach_distance),
+                   m_free_space);
+  }
+  else
+  {
+    m_motion.startEndless(from, -Eigen::Vector3d::UnitZ(), m_near_contact);
+  }
+}
+
+void EndEffectorControl::surfaceApproach(const rclcpp::Duration & period)
 {
   // If the detected force in the z direction is greater than 10 N the phase is finished
   if ( m_current_pose.pose.position.z <= m_surface - m_sin_bias)// - 0.5 * m_palpation_number)
   // if ( m_current_pose.pose.position.z  < -0.1304 )
   {
-    std::cout << "Phase 3" << std::endl;
+    RCLCPP_DEBUG(get_node()->get_logger(), "Palpation %u: phase 3", m_palpation_number);
     m_phase = 3;
+    m_palpation_start = true;
     // m_grid_position.z = m_current_pose.pose.position.z;
     m_target_pose.pose.position.x = m_grid_position.x;
     m_target_pose.pose.position.y = m_grid_position.y;
@@ -262,10 +390,17 @@ void EndEffectorControl::surfaceApproach()
   // The end effector will move in the z direction until it touches the surface of the tissue
   else
   {
+    // Then on at the near contact velocity until deep enough
+    if (m_motion.finished())
+    {
+      m_motion.startEndless(
+        Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_grid_position.z),
+        -Eigen::Vector3d::UnitZ(), m_near_contact);
+    }
     m_target_pose.pose.position.x = m_grid_position.x;
     m_target_pose.pose.position.y = m_grid_position.y;
     // m_grid_position.z -= (0.005 * (m_palpation_number + 1) ) / 500;
-    m_grid_position.z -= ( 0.002 ) / 500;
+    m_grid_position.z = m_motion.step(period.seconds()).z();
     m_target_pose.pose.position.z = m_grid_position.z;
     m_prev_force = m_ft_sensor_wrench(2);
     initial_time = get_node()->now();
@@ -274,6 +409,10 @@ void EndEffectorControl::surfaceApproach()
   if (m_ft_sensor_wrench(2) < -0.35)
   {
     RCLCPP_INFO_STREAM_THROTTLE(get_node()->get_logger(), *get_node()->get_clock(), 1000, "Contact detected");
+    if (!m_contact)
+    {
+      m_planner.setSurfaceHeight(m_current_pose.pose.position.z);
+    }
     m_contact = true;
   } 
   else
@@ -314,26 +453,26 @@ void EndEffectorControl::tissuePalpation(const rclcpp::Time & time)
     // m_grid_position.z = m_grid_position.z -
     // 0.003 * sin(2 * M_PI * (time.nanoseconds() * 1e-9 - initial_time.nanoseconds() * 1e-9) * 5);
     // m_grid_position.y = m_target_pose.pose.position.y;
-    std::cout << "Phase 4" << std::endl;
+    RCLCPP_DEBUG(get_node()->get_logger(), "Palpation %u: phase 4", m_palpation_number);
     m_phase = 4;
-    while (!msgs_queue.empty())
-    {
-      msgs_queue.pop();
-    }
     m_contact = false;
+
+    // Retract fully unless the surface towards the next site is known and flat. Leave the
+    // tissue at the near contact limits, up to the approach distance above its surface.
+    m_retract_height = m_planner.retractHeight(m_starting_position.z);
+    const double surface = m_planner.surfaceHeight();
+    const double clear = std::isnan(surface)
+                           ? m_retract_height
+                           : std::min(surface + m_approach_distance, m_retract_height);
+    m_leaving_tissue = true;
+    m_motion.start(Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_grid_position.z),
+                   Eigen::Vector3d(m_grid_position.x, m_grid_position.y, clear), m_near_contact);
   }
 }
 
-void EndEffectorControl::startingHigh()
+void EndEffectorControl::startingHigh(const rclcpp::Duration & period)
 {
-  if (m_current_pose.pose.position.z < m_starting_position.z)
-  {
-    m_grid_position.z += 0.005 / 500;
-  }
-  else 
-  {
-    m_grid_position.z = m_starting_position.z;
-  }
+  m_grid_position.z = m_motion.step(period.seconds()).z();
 
   m_target_pose.pose.position.x = m_grid_position.x;
   m_target_pose.pose.position.y = m_grid_position.y;
@@ -348,12 +487,26 @@ void EndEffectorControl::startingHigh()
 
   m_pose_publisher->publish(m_target_pose);
 
+  // Then on in free space
+  if (m_leaving_tissue && m_motion.finished())
+  {
+    m_leaving_tissue = false;
+    m_motion.start(Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_grid_position.z),
+                   Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_retract_height),
+                   m_free_space);
+  }
+
   // If the end effector is the starting high the phase is finished
-  if (abs(m_current_pose.pose.position.z - m_starting_position.z) < 0.001)
+  if (!m_leaving_tissue && m_motion.finished() &&
+      abs(m_current_pose.pose.position.z - m_retract_height) < 0.001)
   {
     m_phase = 1;
     newStartingPosition();
-    m_grid_position.z = m_starting_position.z;
+    m_grid_position.z = m_retract_height;
+    m_motion.start(Eigen::Vector3d(m_target_pose.pose.position.x, m_target_pose.pose.position.y,
+                                   m_target_pose.pose.position.z),
+                   Eigen::Vector3d(m_grid_position.x, m_grid_position.y, m_retract_height),
+                   m_free_space);
     // m_surface = m_starting_position.z;
     
   }
@@ -362,16 +515,16 @@ void EndEffectorControl::startingHigh()
 void EndEffectorControl::newStartingPosition()
 { 
   m_palpation_number++;
-  m_grid_position.x = m_starting_position.x + 0.0025 * (int)(m_palpation_number / 19);
-  m_grid_position.y = m_starting_position.y + 0.0025 * (m_palpation_number % 19);
-  // m_grid_position.x = m_starting_position.x + 0.002 * (m_palpation_number % 15);
-  // Move the end effector in a grid of 0.05x0.05 m starting from the bottom left corner and with a step of 0.002 m
-  // m_grid_position.x = m_starting_position.x + 0.002 * (m_palpation_number % 26);
-  // m_grid_position.y += 0.005;
+  m_planner.next();
+  if (m_planner.done())
+  {
+    return;
+  }
+  m_grid_position.x = m_planner.site().x;
+  m_grid_position.y = m_planner.site().y;
 
-  //Plot the grid
-  std::cout << "x: " << m_grid_position.x << std::endl;
-  std::cout << "y: " << m_grid_position.y << std::endl;
+  RCLCPP_DEBUG(get_node()->get_logger(), "Next site: %f, %f", m_grid_position.x,
+               m_grid_position.y);
 
   // Launch from command line the following command
   // ros2 service call /bus0/ft_sensor0/reset_wrench rokubimini_msgs/srv/ResetWrench "desired_wrench:
@@ -404,39 +557,43 @@ void EndEffectorControl::publishDataEE(const rclcpp::Time & time)
   // m_data_publisher->publish(msg);
 
   // Publish state
-  std_msgs::msg::Float64MultiArray msg;
-  // msg.data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
-  //             m_target_pose.pose.position.z, cartVel(2), m_ft_sensor_wrench(2)};
-  // m_data_publisher->publish(msg);
-  // if (m_phase == 3)
-  // {  
-  //   if (msgs_queue.size() < 15)
-  //   {
-  //     msg.data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
-  //               m_target_pose.pose.position.z, cartVel(2), 0, (double)m_palpation_number, (double)m_phase, m_current_pose.pose.position.x, m_current_pose.pose.position.y};
-  //     msgs_queue.push(msg);
-  //   }
-  //   else
-  //   {
-  //     msgs_queue.front().data[4] = m_ft_sensor_wrench(2) - m_force_bias;
-  //     m_data_publisher->publish(msgs_queue.front());
-
-  //     msgs_queue.pop();
-  //     msg.data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
-  //               m_target_pose.pose.position.z, cartVel(2), 0, (double)m_palpation_number, (double)m_phase, m_current_pose.pose.position.x, m_current_pose.pose.position.y};
-  //     msgs_queue.push(msg);
-  //   }
-  // }
-  // if (m_phase == 3)
-  // {
-  //   msg.data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
-  //               m_target_pose.pose.position.z, cartVel(2), m_ft_sensor_wrench(2) - m_force_bias, (double)m_palpation_number, (double)m_phase, m_current_pose.pose.position.x, m_current_pose.pose.position.y};
-  //   m_data_publisher->publish(msg);
-  // }
-  msg.data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
-                m_target_pose.pose.position.z, cartVel(2), m_ft_sensor_wrench(2) - m_force_bias, (double)m_palpation_number, (double)m_phase, m_current_pose.pose.position.x, m_current_pose.pose.position.y};
-  m_data_publisher->publish(msg);
+  // time, current position, target position, velocity, force, palpation, phase, x, y
+  // The force measurements arrive later than the kinematics. Each state gets captured once the
+  // force at its stamp is known.
+  DataRecord data = {(time.nanoseconds() * 1e-9), m_current_pose.pose.position.z,
+                     m_target_pose.pose.position.z, cartVel(2), 0.0,
+                     (double)m_palpation_number, (double)m_phase,
+                     m_current_pose.pose.position.x, m_current_pose.pose.position.y};
+  m_data_buffer.addSample(data[0], data);
+
+  ForceSample force;
+  while (m_force_samples.pop(force))
+  {
+    m_data_buffer.addForce(force);
+  }
+
+  double stamp;
+  while (m_data_buffer.pop(stamp, data, force.force))
+  {
+    data[4] = force.force - m_force_bias;
+    m_capture.add(data, data[6] == 3 || std::abs(data[4]) >= m_capture_force);
+  }
 
+  // Publish the captured windows in batches of records, at most one message per cycle. The
+  // backlog of a window's pre-trigger records drains at one batch per cycle.
+  const size_t batch_size = m_capture_batch * data.size();
+  while (m_data_msg.data.size() < batch_size && m_capture.pop(data))
+  {
+    m_data_msg.data.insert(m_data_msg.data.end(), data.begin(), data.end());
+  }
+  const bool window_closed = !m_capture.active() && m_capture.released() == 0;
+  if (m_data_msg.data.size() >= batch_size || (window_closed && !m_data_msg.data.empty()))
+  {
+    m_data_msg.layout.dim[0].size = m_data_msg.data.size() / data.size();
+    m_data_msg.layout.dim[0].stride = m_data_msg.data.size();
+    m_data_publisher->publish(m_data_msg);
+    m_data_msg.data.clear();
+  }
 }
 
 controller_interface::InterfaceConfiguration EndEffectorControl::state_interface_configuration()
@@ -463,6 +620,39 @@ EndEffectorControl::on_init()
   auto_declare<std::string>("end_effector_link", "");
   auto_declare<std::vector<std::string>>("joints", std::vector<std::string>());
 
+  // Palpation sites as x, y pairs relative to the starting position, or else a grid over the region.
+  // The resolution also decides the given sites' neighbours and serpentine columns, 0 derives it.
+  auto_declare<std::vector<double>>("planner.sites", std::vector<double>());
+  auto_declare<std::vector<double>>("planner.region", {0.0, 0.0, 0.045, 0.045});
+  auto_declare<double>("planner.resolution", 0.0025);
+  auto_declare<std::string>("planner.ordering", "serpentine");
+  auto_declare<double>("planner.height_tolerance", 0.001);
+  auto_declare<double>("planner.clearance", 0.005);
+
+  // Motion limits in m/s, m/s^2 and m/s^3. Near contact applies to the final approach distance
+  // above the surface of the neighbouring sites, or to the whole approach if that's unknown.
+  auto_declare<double>("motion.free_space.velocity", 0.02);
+  auto_declare<double>("motion.free_space.acceleration", 0.05);
+  auto_declare<double>("motion.free_space.jerk", 0.5);
+  auto_declare<double>("motion.near_contact.velocity", 0.002);
+  auto_declare<double>("motion.near_contact.acceleration", 0.01);
+  auto_declare<double>("motion.near_contact.jerk", 0.1);
+  auto_declare<double>("motion.approach_distance", 0.003);
+
+  // Records of /data_control to publish before and after each contact or palpation, and how many
+  // records to publish per message. Forces of at least the threshold count as contact.
+  auto_declare<int>("capture.pre_trigger", 250);
+  auto_declare<int>("capture.post_trigger", 250);
+  auto_declare<int>("capture.batch", 50);
+  auto_declare<double>("capture.force_threshold", 0.35);
+
+  // Tissue estimation. A bank runs one filter per combination of exponent and priors.
+  auto_declare<std::string>("estimator.type", "bank");
+  auto_declare<std::string>("estimator.precision", "double");
+  auto_declare<std::vector<double>>("estimator.exponents", {1.2, 1.35, 1.5});
+  auto_declare<std::vector<double>>("estimator.elasticities", {500.0, 1000.0, 2000.0});
+  auto_declare<std::vector<double>>("estimator.viscosities", {500.0, 1000.0, 2000.0});
+
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
@@ -527,9 +717,15 @@ EndEffectorControl::on_configure(const rclcpp_lifecycle::State & previous_state)
 
   m_data_publisher = get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
     std::string("/data_control"), 10);
+  m_data_msg.layout.dim.resize(2);
+  m_data_msg.layout.dim[0].label = "records";
+  m_data_msg.layout.dim[1].label = "fields";
+  m_data_msg.layout.dim[1].size = std::tuple_size<DataRecord>::value;
+  m_data_msg.layout.dim[1].stride = std::tuple_size<DataRecord>::value;
 
   m_estimator_publisher = get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
     std::string("/data_estimation"), 10);
+  m_estimator_msg.data.resize(6);
 
   // m_elasticity_publisher = get_node()->create_publisher<std_msgs::msg::Float64>(
   //     std::string("/position_desired"), 10);
@@ -550,13 +746,16 @@ EndEffectorControl::on_configure(const rclcpp_lifecycle::State & previous_state)
     get_node()->get_name() + std::string("/target_wrench"), 10,
     std::bind(&EndEffectorControl::targetWrenchCallback, this, std::placeholders::_1));
 
+  // Allocate before the sensor's callback can push into them
+  m_force_samples.reset(100);
+  m_estimator.allocate(100);
   m_ft_sensor_wrench_subscriber =
     get_node()->create_subscription<geometry_msgs::msg::WrenchStamped>(
       get_node()->get_name() + std::string("/ft_sensor_wrench"), 10,
       std::bind(&EndEffectorControl::ftSensorWrenchCallback, this, std::placeholders::_1));
 
   // Initialize kinematics
-  m_fk_solver.reset(new KDL::ChainFkSolverVel_recursive(m_robot_chain));
+  m_measured_state.init(m_robot_chain);
   m_current_pose = getEndEffectorPose();
   Eigen::Quaterniond current_quat(
     m_current_pose.pose.orientation.w, m_current_pose.pose.orientation.x,
@@ -574,28 +773,20 @@ EndEffectorControl::on_configure(const rclcpp_lifecycle::State & previous_state)
 
 geometry_msgs::msg::PoseStamped EndEffectorControl::getEndEffectorPose()
 {
-  KDL::JntArray positions(m_joint_state_pos_handles.size());
-  KDL::JntArray velocities(m_joint_state_pos_handles.size());
-  for (size_t i = 0; i < m_joint_state_pos_handles.size(); ++i)
-  {
-    positions(i) = m_joint_state_pos_handles[i].get().get_value();
-    velocities(i) = m_joint_state_vel_handles[i].get().get_value();
-  }
-
-  KDL::JntArrayVel joint_data(positions, velocities);
-  KDL::FrameVel tmp;
-  m_fk_solver->JntToCart(joint_data, tmp);
+  m_measured_state.update(m_joint_state_pos_handles, m_joint_state_vel_handles);
+  const KDL::Frame & pose = m_measured_state.pose();
+  const KDL::Twist & twist = m_measured_state.twist();
 
   geometry_msgs::msg::PoseStamped current;
-  current.pose.position.x = tmp.p.p.x();
-  current.pose.position.y = tmp.p.p.y();
-  current.pose.position.z = tmp.p.p.z();
-  tmp.M.R.GetQuaternion(current.pose.orientation.x, current.pose.orientation.y,
-                        current.pose.orientation.z, current.pose.orientation.w);
-  
-  cartVel(0) = tmp.p.v.x();
-  cartVel(1) = tmp.p.v.y();
-  cartVel(2) = tmp.p.v.z();
+  current.pose.position.x = pose.p.x();
+  current.pose.position.y = pose.p.y();
+  current.pose.position.z = pose.p.z();
+  pose.M.GetQuaternion(current.pose.orientation.x, current.pose.orientation.y,
+                       current.pose.orientation.z, current.pose.orientation.w);
+
+  cartVel(0) = twist.vel.x();
+  cartVel(1) = twist.vel.y();
+  cartVel(2) = twist.vel.z();
 
   return current;
 }
@@ -625,17 +816,33 @@ void EndEffectorControl::ftSensorWrenchCallback(
   m_ft_sensor_wrench(1) = tmp[1];
   m_ft_sensor_wrench(2) = tmp[2];
 
-    if (m_phase == 2 && m_force_sample_flag == false)
+  // Matched to the published state by its stamp
+  ForceSample force;
+  force.time = rclcpp::Time(wrench->header.stamp).seconds();
+  force.force = tmp[2];
+  m_force_samples.push(force);
+
+  // Average the bias over the first 500 measurements of each approach
+  if (m_force_bias_reset.exchange(false))
   {
-    m_force_bias += m_ft_sensor_wrench(2);
+    m_force_sum = 0.0;
+    m_force_sample = 0;
+    m_force_sample_flag = false;
+  }
+  if (!m_force_sample_flag)
+  {
+    m_force_sum += tmp[2];
     m_force_sample++;
     if (m_force_sample == 500)
     {
-      m_force_bias = m_force_bias / 500;
+      m_force_bias = m_force_sum / 500;
       m_force_sample_flag = true;
     }
-    
   }
+
+  // The estimator matches it to the palpation the same way, positive into the tissue
+  force.force = (m_force_sample_flag ? m_force_bias.load() : 0.0) - tmp[2];
+  m_estimator.pushForce(force);
 }
 
 void EndEffectorControl::targetWrenchCallback(
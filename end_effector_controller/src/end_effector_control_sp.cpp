@@ -52,7 +52,7 @@ namespace end_effector_controller
 
   EndEffectorControl::EndEffectorControl() {}
 
-  EndEffectorControl::~EndEffectorControl() {}
+  EndEffectorControl::~EndEffectorControl() { m_estimator.stop(); }
 
   rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
   EndEffectorControl::on_activate(const rclcpp_lifecycle::State &previous_state)
@@ -112,31 +112,35 @@ namespace end_effector_controller
 
     initial_time = get_node()->now();
 
-    // Set the initial state of the estimator
-    State x;
-    x.x1() = 0.0;
-    x.x2() = -cartVel(2);
-    x.x3() = 1000.0;
-    x.x4() = 1000.0;
-
-    // Init filters with true system state
-    ekf.init(x);
-
-    // Save covariance for later
-    cov = ekf.getCovariance();
-    cov.setZero();
-    
-    // Set initial values for the covariance
-    cov(0, 0) = 1.0;
-    cov(1, 1) = 1.0;
-    cov(2, 2) = 1000.0;
-    cov(3, 3) = 1000.0;
-
-    // Set covariance
-    ekf.setCovariance(cov);
-
-    // Set data for the kalman filter estimation 
-    sys.setModelData(0.05, 0.002, 1.35);
+    // The default estimator. EndEffectorControl selects it by parameter.
+    TissueFilterConfig config;
+    config.velocity = -cartVel(2);
+
+    // Estimate and publish outside the control loop
+    m_estimate = TissueEstimate();
+    if (!m_estimator.start(config, std::chrono::milliseconds(1),
+                           [this](const PalpationSample & sample, const TissueEstimate & estimate)
+                           {
+                             m_data_msg.data[0] = sample.time;
+                             m_data_msg.data[1] = sample.previous_position;
+                             m_data_msg.data[2] = sample.target_position;
+                             m_data_msg.data[3] = sample.position;
+                             m_data_msg.data[4] = sample.velocity;
+                             m_data_msg.data[5] = sample.force;
+                             m_data_publisher->publish(m_data_msg);
+
+                             m_estimator_msg.data[0] = estimate.velocity;
+                             m_estimator_msg.data[1] = estimate.measured_velocity;
+                             m_estimator_msg.data[2] = estimate.elasticity;
+                             m_estimator_msg.data[3] = estimate.viscosity;
+                             m_estimator_msg.data[4] = estimate.force;
+                             m_estimator_msg.data[5] = estimate.measured_force;
+                             m_estimator_publisher->publish(m_estimator_msg);
+                           }))
+    {
+      RCLCPP_ERROR(get_node()->get_logger(), "Invalid estimator");
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
     
 
     m_current_pose = getEndEffectorPose();
@@ -150,6 +154,13 @@ namespace end_effector_controller
   rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
   EndEffectorControl::on_deactivate(const rclcpp_lifecycle::State &previous_state)
   {
+    m_estimator.stop();
+    if (m_estimator.dropped() > 0)
+    {
+      RCLCPP_WARN(get_node()->get_logger(), "The estimator dropped %zu samples",
+                  m_estimator.dropped());
+    }
+
     m_joint_state_pos_handles.clear();
     m_joint_state_vel_handles.clear();
     this->release_interfaces();
@@ -227,73 +238,16 @@ namespace end_effector_controller
       m_pose_publisher->publish(m_current_pose);
     }
 
-    // Publish state
-    std_msgs::msg::Float64MultiArray msg;
-    // if( prec_time.nanoseconds() != time.nanoseconds() )
-    // {
-    if (msgs_queue.size() < 28)
-    {
-      msg.data = {
-        (time.nanoseconds() * 1e-9),
-        prev_pos,
-        m_current_pose.pose.position.z,
-        tmp,
-        cartVel(2),
-        0
-      };
-      msgs_queue.push(msg);
-    }
-    else
-    {
-      msgs_queue.front().data[5] = -m_ft_sensor_wrench(2);
-      m_data_publisher->publish(msgs_queue.front());
-
-      sys.setForce(-m_ft_sensor_wrench(2));
-      // Predict state for current time-step using the filters
-      auto x_ekf = ekf.predict(sys);
-
-      // Measure velocity
-      VelocityMeasurement vm;
-
-      // Set measurement
-      vm.v() = -msgs_queue.front().data[4];
-
-      // Update UKF
-      x_ekf = ekf.update(fm, vm);
-
-      // Publish estimation
-      msg.data = {
-        x_ekf.x2(),
-        -cartVel(2),
-        x_ekf.x3(),
-        x_ekf.x4(),
-        pow(abs(x_ekf.x1()),1.35) * x_ekf.x3() + pow(abs(x_ekf.x1()),1.35) * x_ekf.x2() * x_ekf.x4(),
-        -m_ft_sensor_wrench(2)
-      };
-      m_estimator_publisher->publish(msg);
-
-      
-      msgs_queue.pop();
-      msg.data = {
-        (time.nanoseconds() * 1e-9),
-        prev_pos,
-        m_current_pose.pose.position.z,
-        tmp,
-        cartVel(2),
-        0
-      };
-      msgs_queue.push(msg);
-
-      
-    }
-      
-      
-      
-
-      
+    // Hand the state over to the estimator
+    PalpationSample sample;
+    sample.time = time.nanoseconds() * 1e-9;
+    sample.previous_position = prev_pos;
+    sample.target_position = m_current_pose.pose.position.z;
+    sample.position = tmp;
+    sample.velocity = cartVel(2);
+    m_estimator.push(sample);
+    m_estimator.read(m_estimate);
 
-      // prec_time = time;
-    //}
     // std_msgs::msg::Float64 msg;
     // msg.data = m_current_pose.pose.position.z;
     // m_elasticity_publisher->publish(msg);
@@ -452,6 +406,10 @@ namespace end_effector_controller
     m_estimator_publisher = get_node()->create_publisher<std_msgs::msg::Float64MultiArray>(
         std::string("/data_estimation"), 10);
 
+    // Preallocate the messages of the delayed state and the estimation
+    m_data_msg.data.resize(6);
+    m_estimator_msg.data.resize(6);
+
     // m_elasticity_publisher = get_node()->create_publisher<std_msgs::msg::Float64>(
     //     std::string("/position_desired"), 10);
 
@@ -472,6 +430,8 @@ namespace end_effector_controller
         10,
         std::bind(&EndEffectorControl::targetWrenchCallback, this, std::placeholders::_1));
 
+    // Allocate before the sensor's callback can push into them
+    m_estimator.allocate(100);
     m_ft_sensor_wrench_subscriber =
         get_node()->create_subscription<geometry_msgs::msg::WrenchStamped>(
             get_node()->get_name() + std::string("/ft_sensor_wrench"),
@@ -479,7 +439,7 @@ namespace end_effector_controller
             std::bind(&EndEffectorControl::ftSensorWrenchCallback, this, std::placeholders::_1));
 
     // Initialize kinematics
-    m_fk_solver.reset(new KDL::ChainFkSolverVel_recursive(m_robot_chain));
+    m_measured_state.init(m_robot_chain);
     m_current_pose = getEndEffectorPose();
     Eigen::Quaterniond current_quat(m_current_pose.pose.orientation.w, m_current_pose.pose.orientation.x, m_current_pose.pose.orientation.y, m_current_pose.pose.orientation.z);
     Eigen::AngleAxisd current_aa(current_quat);
@@ -566,31 +526,23 @@ namespace end_effector_controller
 
   geometry_msgs::msg::PoseStamped EndEffectorControl::getEndEffectorPose()
   {
-    KDL::JntArray positions(m_joint_state_pos_handles.size());
-    KDL::JntArray velocities(m_joint_state_pos_handles.size());
-    for (size_t i = 0; i < m_joint_state_pos_handles.size(); ++i)
-    {
-      positions(i) = m_joint_state_pos_handles[i].get().get_value();
-      velocities(i) = m_joint_state_vel_handles[i].get().get_value();
-    }
-
-    KDL::JntArrayVel joint_data(positions,velocities);
-    KDL::FrameVel tmp;
-    m_fk_solver->JntToCart(joint_data, tmp);
+    m_measured_state.update(m_joint_state_pos_handles, m_joint_state_vel_handles);
+    const KDL::Frame & pose = m_measured_state.pose();
+    const KDL::Twist & twist = m_measured_state.twist();
 
     geometry_msgs::msg::PoseStamped current;
-    current.pose.position.x = tmp.p.p.x();
-    current.pose.position.y = tmp.p.p.y();
-    current.pose.position.z = tmp.p.p.z();
-    tmp.M.R.GetQuaternion(current.pose.orientation.x,
+    current.pose.position.x = pose.p.x();
+    current.pose.position.y = pose.p.y();
+    current.pose.position.z = pose.p.z();
+    pose.M.GetQuaternion(current.pose.orientation.x,
                         current.pose.orientation.y,
                         current.pose.orientation.z,
                         current.pose.orientation.w);
 
     // Publish state
-    cartVel(0) = tmp.p.v.x();
-    cartVel(1) = tmp.p.v.y();
-    cartVel(2) = tmp.p.v.z();
+    cartVel(0) = twist.vel.x();
+    cartVel(1) = twist.vel.y();
+    cartVel(2) = twist.vel.z();
     // RCLCPP_INFO_STREAM(get_node()->get_logger(), "vel arrr: " << cartVel);
     return current;
   }
@@ -619,7 +571,11 @@ namespace end_effector_controller
     m_ft_sensor_wrench(1) = tmp[1];
     m_ft_sensor_wrench(2) = tmp[2];
 
-
+    // The estimator matches the force to the kinematics by its stamp
+    ForceSample force;
+    force.time = rclcpp::Time(wrench->header.stamp).seconds();
+    force.force = -tmp[2];
+    m_estimator.pushForce(force);
   }
 
   void EndEffectorControl::targetWrenchCallback(const geometry_msgs::msg::WrenchStamped::SharedPtr wrench)
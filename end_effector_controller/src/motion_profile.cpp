@@ -0,0 +1,116 @@
+#include <end_effector_controller/motion_profile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace end_effector_controller
+{
+void JerkLimitedProfile::plan(double distance, const MotionLimits & limits)
+{
+  // See Biagiotti and Melchiorri, Trajectory Planning for Automatic Machines and Robots,
+  // section 3.4, for the case of zero initial and final velocities
+  const double v = limits.velocity;
+  const double a = limits.acceleration;
+  const double j = limits.jerk;
+  m_distance = std::max(distance, 0.0);
+  m_jerk = j;
+
+  // Reach the velocity limit, with or without reaching the acceleration limit
+  if (v * j >= a * a)
+  {
+    m_jerk_time = a / j;
+    m_acceleration_time = m_jerk_time + v / a;
+  }
+  else
+  {
+    m_jerk_time = std::sqrt(v / j);
+    m_acceleration_time = 2 * m_jerk_time;
+  }
+  m_cruise_time = m_distance / v - m_acceleration_time;
+
+  // Too short to reach the velocity limit
+  if (m_cruise_time < 0.0)
+  {
+    m_cruise_time = 0.0;
+    if (m_distance >= 2 * a * a * a / (j * j))
+    {
+      m_jerk_time = a / j;
+      m_acceleration_time =
+        0.5 * m_jerk_time + std::sqrt(0.25 * m_jerk_time * m_jerk_time + m_distance / a);
+    }
+    else
+    {
+      m_jerk_time = std::cbrt(0.5 * m_distance / j);
+      m_acceleration_time = 2 * m_jerk_time;
+    }
+  }
+
+  m_acceleration = j * m_jerk_time;
+  m_velocity = m_acceleration * (m_acceleration_time - m_jerk_time);
+}
+
+double JerkLimitedProfile::position(double time) const
+{
+  if (time <= 0.0)
+  {
+    return 0.0;
+  }
+  if (time <= m_acceleration_time)
+  {
+    return accelerating(time);
+  }
+  if (time <= m_acceleration_time + m_cruise_time)
+  {
+    return 0.5 * m_velocity * m_acceleration_time + m_velocity * (time - m_acceleration_time);
+  }
+  if (time < duration())
+  {
+    return m_distance - accelerating(duration() - time);
+  }
+  return m_distance;
+}
+
+double JerkLimitedProfile::accelerating(double time) const
+{
+  // Acceleration ramps up, stays at its maximum and ramps down
+  if (time <= m_jerk_time)
+  {
+    return m_jerk * time * time * time / 6;
+  }
+  if (time <= m_acceleration_time - m_jerk_time)
+  {
+    return m_acceleration / 6 *
+           (3 * time * time - 3 * m_jerk_time * time + m_jerk_time * m_jerk_time);
+  }
+  const double remaining = m_acceleration_time - time;
+  return 0.5 * m_velocity * m_acceleration_time - m_velocity * remaining +
+         m_jerk * remaining * remaining * remaining / 6;
+}
+
+void LinearMotion::start(const Eigen::Vector3d & from, const Eigen::Vector3d & to,
+                         const MotionLimits & limits)
+{
+  const double distance = (to - from).norm();
+  m_start = from;
+  m_direction = distance > 0.0 ? Eigen::Vector3d((to - from) / distance) : Eigen::Vector3d::Zero();
+  m_profile.plan(distance, limits);
+  m_time = 0.0;
+}
+
+void LinearMotion::startEndless(const Eigen::Vector3d & from, const Eigen::Vector3d & direction,
+                                const MotionLimits & limits)
+{
+  m_start = from;
+  m_direction = direction.normalized();
+  m_profile.plan(std::numeric_limits<double>::infinity(), limits);
+  m_time = 0.0;
+}
+
+Eigen::Vector3d LinearMotion::step(double period)
+{
+  m_time += period;
+  return m_start + m_profile.position(m_time) * m_direction;
+}
+
+}  // namespace end_effector_controller
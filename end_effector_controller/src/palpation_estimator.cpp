@@ -0,0 +1,160 @@
+#include <end_effector_controller/palpation_estimator.h>
+
+#include <cmath>
+#include <limits>
+
+namespace end_effector_controller
+{
+PalpationEstimator::PalpationEstimator() : m_time(0.0), m_dropped(0), m_running(false) {}
+
+PalpationEstimator::~PalpationEstimator() { stop(); }
+
+void PalpationEstimator::allocate(size_t capacity)
+{
+  stop();
+  m_samples.reset(capacity);
+  m_forces.reset(capacity);
+}
+
+bool PalpationEstimator::start(const TissueFilterConfig & config, std::chrono::nanoseconds period,
+                               Callback callback)
+{
+  stop();
+  m_config = config;
+  m_filter = makeTissueFilter(m_config);
+  if (!m_filter)
+  {
+    return false;
+  }
+  m_callback = std::move(callback);
+  m_buffer.clear();
+  m_time = std::numeric_limits<double>::quiet_NaN();
+  // Drop what's left from the last run. Only consumes, so the producers may keep pushing.
+  PalpationSample sample;
+  while (m_samples.pop(sample))
+  {
+  }
+  ForceSample force;
+  while (m_forces.pop(force))
+  {
+  }
+  m_estimates.reset();
+  m_dropped = 0;
+  m_running = true;
+  m_thread = std::thread(&PalpationEstimator::run, this, period);
+  return true;
+}
+
+void PalpationEstimator::stop()
+{
+  m_running = false;
+  if (m_thread.joinable())
+  {
+    m_thread.join();
+  }
+}
+
+bool PalpationEstimator::push(const PalpationSample & sample)
+{
+  if (!m_running)
+  {
+    return false;
+  }
+  if (!m_samples.push(sample))
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool PalpationEstimator::pushForce(const ForceSample & force)
+{
+  if (!m_running)
+  {
+    return false;
+  }
+  if (!m_forces.push(force))
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void PalpationEstimator::run(std::chrono::nanoseconds period)
+{
+  // Drain until stopped, and once more afterwards
+  bool draining = true;
+  while (draining)
+  {
+    draining = m_running;
+
+    // Forces first, so that they cover the samples queued before them
+    ForceSample force;
+    while (m_forces.pop(force))
+    {
+      m_buffer.addForce(force);
+    }
+    PalpationSample sample;
+    while (m_samples.pop(sample))
+    {
+      if (!m_buffer.addSample(sample.time, sample))
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    double time;
+    while (m_buffer.pop(time, sample, force.force))
+    {
+      estimate(sample, force.force);
+    }
+
+    if (draining)
+    {
+      std::this_thread::sleep_for(period);
+    }
+  }
+}
+
+void PalpationEstimator::estimate(const PalpationSample & sample, double force)
+{
+  if (sample.first)
+  {
+    m_config.velocity = -sample.velocity;
+    m_filter = makeTissueFilter(m_config);
+    m_time = std::numeric_limits<double>::quiet_NaN();
+  }
+
+  // Step with the time between the samples' stamps
+  if (sample.time > m_time)
+  {
+    m_filter->setTimeStep(sample.time - m_time);
+  }
+  m_time = sample.time;
+
+  m_filter->predict(force);
+  m_filter->update(-sample.velocity);
+
+  PalpationSample matched = sample;
+  matched.force = force;
+
+  const TissueFilter::State x = m_filter->state();
+  TissueEstimate estimate;
+  estimate.time = sample.time;
+  estimate.velocity = x.x2();
+  estimate.measured_velocity = -sample.velocity;
+  estimate.elasticity = x.x3();
+  estimate.viscosity = x.x4();
+  estimate.exponent = m_filter->exponent();
+  estimate.force = std::pow(std::abs(x.x1()), estimate.exponent) * (x.x3() + x.x2() * x.x4());
+  estimate.measured_force = force;
+  m_estimates.write(estimate);
+  if (m_callback)
+  {
+    m_callback(matched, estimate);
+  }
+}
+
+}  // namespace end_effector_controller
@@ -0,0 +1,230 @@
+#include <end_effector_controller/palpation_planner.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace end_effector_controller
+{
+namespace
+{
+double distance(const PalpationPlanner::Site & a, const PalpationPlanner::Site & b)
+{
+  return std::hypot(a.x - b.x, a.y - b.y);
+}
+}  // namespace
+
+bool PalpationPlanner::configure(const PalpationPlannerConfig & config, double x, double y)
+{
+  m_sites.clear();
+  m_heights.clear();
+  m_index = 0;
+  m_resolution = config.resolution;
+  m_height_tolerance = config.height_tolerance;
+  m_clearance = config.clearance;
+
+  if (!config.sites.empty())
+  {
+    if (config.sites.size() % 2 != 0 || !(config.resolution >= 0.0))
+    {
+      return false;
+    }
+    for (std::size_t i = 0; i < config.sites.size(); i += 2)
+    {
+      m_sites.push_back({x + config.sites[i], y + config.sites[i + 1]});
+    }
+
+    // The smallest spacing of distinct sites, if not given
+    if (config.resolution == 0.0)
+    {
+      for (std::size_t i = 0; i < m_sites.size(); ++i)
+      {
+        for (std::size_t j = i + 1; j < m_sites.size(); ++j)
+        {
+          const double d = distance(m_sites[i], m_sites[j]);
+          if (d > 0.0 && (m_resolution == 0.0 || d < m_resolution))
+          {
+            m_resolution = d;
+          }
+        }
+      }
+    }
+  }
+  else
+  {
+    if (!(config.resolution > 0.0) || config.region.size() != 4 || !(config.region[2] >= config.region[0]) ||
+        !(config.region[3] >= config.region[1]))
+    {
+      return false;
+    }
+
+    // Tolerate rounding, so that the grid includes a maximum that's a multiple of the resolution
+    const int columns = std::floor((config.region[2] - config.region[0]) / config.resolution + 1e-6);
+    const int rows = std::floor((config.region[3] - config.region[1]) / config.resolution + 1e-6);
+    for (int i = 0; i <= columns; ++i)
+    {
+      for (int j = 0; j <= rows; ++j)
+      {
+        m_sites.push_back(
+          {x + config.region[0] + i * config.resolution, y + config.region[1] + j * config.resolution});
+      }
+    }
+  }
+
+  if (config.ordering == "serpentine")
+  {
+    orderSerpentine();
+  }
+  else if (config.ordering == "nearest_neighbor")
+  {
+    // Start next to the starting position
+    auto first = std::min_element(m_sites.begin(), m_sites.end(),
+                                  [x, y](const Site & a, const Site & b)
+                                  { return distance(a, {x, y}) < distance(b, {x, y}); });
+    std::iter_swap(m_sites.begin(), first);
+    orderNearestNeighbor();
+  }
+  else
+  {
+    m_sites.clear();
+    return false;
+  }
+
+  m_heights.assign(m_sites.size(), std::numeric_limits<double>::quiet_NaN());
+  return true;
+}
+
+void PalpationPlanner::next()
+{
+  if (m_index < m_sites.size())
+  {
+    ++m_index;
+  }
+}
+
+void PalpationPlanner::setSurfaceHeight(double z)
+{
+  if (m_index < m_sites.size())
+  {
+    m_heights[m_index] = z;
+  }
+}
+
+double PalpationPlanner::retractHeight(double full_height) const
+{
+  if (m_height_tolerance < 0.0 || m_index + 1 >= m_sites.size() ||
+      std::isnan(m_heights[m_index]) || !isNeighbour(m_sites[m_index], m_sites[m_index + 1]))
+  {
+    return full_height;
+  }
+
+  // The known surface around the way to the next site
+  double lowest = m_heights[m_index];
+  double highest = m_heights[m_index];
+  for (std::size_t i = 0; i < m_sites.size(); ++i)
+  {
+    if (!std::isnan(m_heights[i]) && isNeighbour(m_sites[i], m_sites[m_index + 1]))
+    {
+      lowest = std::min(lowest, m_heights[i]);
+      highest = std::max(highest, m_heights[i]);
+    }
+  }
+
+  if (highest - lowest > m_height_tolerance)
+  {
+    return full_height;
+  }
+  return std::min(full_height, highest + m_clearance);
+}
+
+double PalpationPlanner::surfaceHeight() const
+{
+  double highest = std::numeric_limits<double>::quiet_NaN();
+  for (std::size_t i = 0; m_index < m_sites.size() && i < m_sites.size(); ++i)
+  {
+    if (!std::isnan(m_heights[i]) && isNeighbour(m_sites[i], m_sites[m_index]) &&
+        (std::isnan(highest) || m_heights[i] > highest))
+    {
+      highest = m_heights[i];
+    }
+  }
+  return highest;
+}
+
+double PalpationPlanner::length() const
+{
+  double length = 0.0;
+  for (std::size_t i = 1; i < m_sites.size(); ++i)
+  {
+    length += distance(m_sites[i - 1], m_sites[i]);
+  }
+  return length;
+}
+
+bool PalpationPlanner::isNeighbour(const Site & a, const Site & b) const
+{
+  return distance(a, b) <= 1.5 * m_resolution;
+}
+
+void PalpationPlanner::orderSerpentine()
+{
+  std::sort(m_sites.begin(), m_sites.end(),
+            [](const Site & a, const Site & b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+  // Columns of sites with about the same x, in alternating directions along y
+  bool reverse = false;
+  auto column = m_sites.begin();
+  while (column != m_sites.end())
+  {
+    const double x = column->x;
+    auto end = std::find_if(column, m_sites.end(),
+                            [this, x](const Site & site) { return site.x > x + 0.5 * m_resolution; });
+    std::sort(column, end, [](const Site & a, const Site & b) { return a.y < b.y; });
+    if (reverse)
+    {
+      std::reverse(column, end);
+    }
+    reverse = !reverse;
+    column = end;
+  }
+}
+
+void PalpationPlanner::orderNearestNeighbor()
+{
+  // Greedy tour from the first site
+  for (std::size_t i = 1; i < m_sites.size(); ++i)
+  {
+    auto nearest =
+      std::min_element(m_sites.begin() + i, m_sites.end(),
+                       [this, i](const Site & a, const Site & b)
+                       { return distance(a, m_sites[i - 1]) < distance(b, m_sites[i - 1]); });
+    std::iter_swap(m_sites.begin() + i, nearest);
+  }
+
+  // 2-opt on the open tour with a fixed start. Reversing the sites i + 1 to j replaces the edges
+  // (i, i + 1) and (j, j + 1) with (i, j) and (i + 1, j + 1). The last site has no outgoing edge.
+  const std::size_t n = m_sites.size();
+  bool improved = true;
+  while (improved)
+  {
+    improved = false;
+    for (std::size_t i = 0; i + 2 < n; ++i)
+    {
+      for (std::size_t j = i + 2; j < n; ++j)
+      {
+        double change = distance(m_sites[i], m_sites[j]) - distance(m_sites[i], m_sites[i + 1]);
+        if (j + 1 < n)
+        {
+          change += distance(m_sites[i + 1], m_sites[j + 1]) - distance(m_sites[j], m_sites[j + 1]);
+        }
+        if (change < -1e-12)
+        {
+          std::reverse(m_sites.begin() + i + 1, m_sites.begin() + j + 1);
+          improved = true;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace end_effector_controller
@@ -0,0 +1,170 @@
+#include <end_effector_controller/FilterBank.hpp>
+#include <end_effector_controller/ForceMeasurementModel.hpp>
+#include <end_effector_controller/kalman/ExtendedKalmanFilter.hpp>
+#include <end_effector_controller/kalman/SquareRootExtendedKalmanFilter.hpp>
+#include <end_effector_controller/kalman/SquareRootUnscentedKalmanFilter.hpp>
+#include <end_effector_controller/kalman/UnscentedKalmanFilter.hpp>
+#include <end_effector_controller/tissue_filter.h>
+
+namespace end_effector_controller
+{
+namespace
+{
+using namespace KalmanExamples2;
+
+template <typename T>
+Estimation::State<T> initialState(const TissueFilterConfig & config, double elasticity,
+                                  double viscosity)
+{
+  Estimation::State<T> x;
+  x.x1() = 0.0;
+  x.x2() = config.velocity;
+  x.x3() = elasticity;
+  x.x4() = viscosity;
+  return x;
+}
+
+template <typename T>
+Kalman::Covariance<Estimation::State<T>> initialCovariance(const TissueFilterConfig & config)
+{
+  Kalman::Covariance<Estimation::State<T>> cov;
+  cov.setZero();
+  cov(0, 0) = config.state_variance;
+  cov(1, 1) = config.state_variance;
+  cov(2, 2) = config.parameter_variance;
+  cov(3, 3) = config.parameter_variance;
+  return cov;
+}
+
+double middle(const std::vector<double> & values) { return values[values.size() / 2]; }
+
+/**
+ * @brief One of the Kalman filters with its models
+ */
+template <typename T, template <class> class Filter, template <class> class CovarianceBase>
+class KalmanTissueFilter : public TissueFilter
+{
+public:
+  explicit KalmanTissueFilter(const TissueFilterConfig & config)
+  : m_mass(config.mass), m_exponent(middle(config.exponents))
+  {
+    m_system.setModelData(m_mass, config.time_step, m_exponent);
+    m_filter.init(
+      initialState<T>(config, middle(config.elasticities), middle(config.viscosities)));
+    m_filter.setCovariance(initialCovariance<T>(config));
+  }
+
+  void setTimeStep(double time_step) override
+  {
+    m_system.setModelData(m_mass, time_step, m_exponent);
+  }
+
+  void predict(double force) override
+  {
+    m_system.setForce(force);
+    m_filter.predict(m_system);
+  }
+
+  void update(double velocity) override
+  {
+    Estimation::VelocityMeasurement<T> z;
+    z.v() = velocity;
+    m_filter.update(m_measurement, z);
+  }
+
+  State state() const override { return m_filter.getState().template cast<double>(); }
+
+  double exponent() const override { return m_exponent; }
+
+private:
+  T m_mass;
+  T m_exponent;
+  Estimation::SystemModel<T, CovarianceBase> m_system;
+  Estimation::ForceMeasurementModel<T, CovarianceBase> m_measurement;
+  Filter<Estimation::State<T>> m_filter;
+};
+
+/**
+ * @brief A filter per exponent and prior
+ */
+template <typename T>
+class BankTissueFilter : public TissueFilter
+{
+public:
+  explicit BankTissueFilter(const TissueFilterConfig & config)
+  {
+    m_bank.setModelData(config.mass, config.time_step);
+    for (double n : config.exponents)
+    {
+      for (double elasticity : config.elasticities)
+      {
+        for (double viscosity : config.viscosities)
+        {
+          m_bank.addHypothesis(n, initialState<T>(config, elasticity, viscosity),
+                               initialCovariance<T>(config));
+        }
+      }
+    }
+  }
+
+  void setTimeStep(double time_step) override { m_bank.setTimeStep(time_step); }
+  void predict(double force) override { m_bank.predict(force); }
+  void update(double velocity) override { m_bank.update(velocity); }
+  State state() const override { return m_bank.getState().template cast<double>(); }
+  double exponent() const override { return m_bank.exponent(); }
+
+private:
+  Estimation::FilterBank<T> m_bank;
+};
+
+template <typename T>
+std::unique_ptr<TissueFilter> makeTissueFilter(const TissueFilterConfig & config)
+{
+  if (config.type == "bank")
+  {
+    return std::make_unique<BankTissueFilter<T>>(config);
+  }
+  if (config.type == "ekf")
+  {
+    return std::make_unique<
+      KalmanTissueFilter<T, Kalman::ExtendedKalmanFilter, Kalman::StandardBase>>(config);
+  }
+  if (config.type == "ukf")
+  {
+    return std::make_unique<
+      KalmanTissueFilter<T, Kalman::UnscentedKalmanFilter, Kalman::StandardBase>>(config);
+  }
+  if (config.type == "sr_ekf")
+  {
+    return std::make_unique<
+      KalmanTissueFilter<T, Kalman::SquareRootExtendedKalmanFilter, Kalman::SquareRootBase>>(
+      config);
+  }
+  if (config.type == "sr_ukf")
+  {
+    return std::make_unique<
+      KalmanTissueFilter<T, Kalman::SquareRootUnscentedKalmanFilter, Kalman::SquareRootBase>>(
+      config);
+  }
+  return nullptr;
+}
+}  // namespace
+
+std::unique_ptr<TissueFilter> makeTissueFilter(const TissueFilterConfig & config)
+{
+  if (config.exponents.empty() || config.elasticities.empty() || config.viscosities.empty())
+  {
+    return nullptr;
+  }
+  if (config.precision == "double")
+  {
+    return makeTissueFilter<double>(config);
+  }
+  if (config.precision == "float")
+  {
+    return makeTissueFilter<float>(config);
+  }
+  return nullptr;
+}
+
+}  // namespace end_effector_controller
@@ -0,0 +1,190 @@
+#include <end_effector_controller/FilterBank.hpp>
+#include <end_effector_controller/ForceMeasurementModel.hpp>
+#include <end_effector_controller/SystemModelF.hpp>
+#include <end_effector_controller/kalman/ExtendedKalmanFilter.hpp>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace KalmanExamples2;
+
+namespace
+{
+typedef Estimation::State<double> State;
+typedef Estimation::FilterBank<double> FilterBank;
+
+const double kMass = 0.05;
+const double kTimeStep = 0.002;
+
+struct Input
+{
+  double force;
+  double velocity;
+};
+
+State initialState(double elasticity, double viscosity)
+{
+  State x;
+  x.x1() = 0.0;
+  x.x2() = 0.0;
+  x.x3() = elasticity;
+  x.x4() = viscosity;
+  return x;
+}
+
+Kalman::Covariance<State> initialCovariance()
+{
+  Kalman::Covariance<State> cov;
+  cov.setZero();
+  cov(0, 0) = 1.0;
+  cov(1, 1) = 1.0;
+  cov(2, 2) = 1000.0;
+  cov(3, 3) = 1000.0;
+  return cov;
+}
+
+/**
+ * @brief Palpate a tissue with the filters' own discrete model
+ */
+std::vector<Input> palpate(int count, double exponent, double elasticity, double viscosity,
+                           unsigned seed = 42)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 0.000005);
+  std::vector<Input> inputs(count);
+  double x = 0.0;
+  double v = 0.0;
+  for (int i = 0; i < count; ++i)
+  {
+    const double force = 0.3 - 0.2 * std::cos(2 * M_PI * 2.5 * i * kTimeStep);
+    const double power = std::pow(std::abs(x), exponent);
+    x += kTimeStep * v;
+    v += kTimeStep / kMass * (force - power * elasticity - power * v * viscosity);
+    inputs[i].force = force;
+    inputs[i].velocity = v + noise(rng);
+  }
+  return inputs;
+}
+}  // namespace
+
+TEST(FilterBank, SingleFilterMatchesTheExtendedKalmanFilter)
+{
+  const std::vector<Input> inputs = palpate(5000, 1.5, 2500.0, 4000.0);
+
+  Estimation::SystemModel<double> sys;
+  sys.setModelData(kMass, kTimeStep, 1.35);
+  Estimation::ForceMeasurementModel<double> fm;
+  Kalman::ExtendedKalmanFilter<State> ekf;
+  ekf.init(initialState(1000.0, 1000.0));
+  ekf.setCovariance(initialCovariance());
+
+  FilterBank bank;
+  bank.setModelData(kMass, kTimeStep);
+  bank.addHypothesis(1.35, initialState(1000.0, 1000.0), initialCovariance());
+  ASSERT_EQ(bank.size(), 1);
+
+  for (const Input & input : inputs)
+  {
+    sys.setForce(input.force);
+    ekf.predict(sys);
+    bank.predict(input.force);
+
+    Estimation::VelocityMeasurement<double> z;
+    z.v() = input.velocity;
+    const State expected = ekf.update(fm, z);
+    bank.update(input.velocity);
+
+    const State x = bank.getState();
+    for (int i = 0; i < 4; ++i)
+    {
+      ASSERT_NEAR(x[i], expected[i], 1e-8 * std::max(1.0, std::abs(expected[i])));
+    }
+  }
+  EXPECT_TRUE(bank.getCovariance(0).isApprox(ekf.getCovariance(), 1e-8));
+  EXPECT_DOUBLE_EQ(bank.weight(0), 1.0);
+}
+
+TEST(FilterBank, EstimatesWithinTheBestExponentOnly)
+{
+  // Equal weights, so the first filter is the best one
+  FilterBank bank;
+  bank.setModelData(kMass, kTimeStep);
+  bank.addHypothesis(1.2, initialState(100.0, 200.0), initialCovariance());
+  bank.addHypothesis(1.5, initialState(10000.0, 20000.0), initialCovariance());
+  bank.addHypothesis(1.2, initialState(300.0, 400.0), initialCovariance());
+  EXPECT_NEAR(bank.weight(0) + bank.weight(1) + bank.weight(2), 1.0, 1e-12);
+
+  EXPECT_EQ(bank.best(), 0);
+  EXPECT_DOUBLE_EQ(bank.exponent(), 1.2);
+  const State x = bank.getState();
+  EXPECT_DOUBLE_EQ(x.x3(), 200.0);
+  EXPECT_DOUBLE_EQ(x.x4(), 300.0);
+}
+
+TEST(FilterBank, SelectsTheTissuesExponent)
+{
+  const std::vector<Input> inputs = palpate(20000, 1.5, 2500.0, 4000.0);
+
+  FilterBank bank;
+  bank.setModelData(kMass, kTimeStep);
+  for (double n : {1.2, 1.35, 1.5, 1.65})
+  {
+    for (double elasticity : {1000.0, 4000.0})
+    {
+      bank.addHypothesis(n, initialState(elasticity, 1000.0), initialCovariance());
+    }
+  }
+  for (const Input & input : inputs)
+  {
+    bank.predict(input.force);
+    bank.update(input.velocity);
+  }
+
+  EXPECT_DOUBLE_EQ(bank.exponent(), 1.5);
+  EXPECT_DOUBLE_EQ(bank.exponent(bank.best()), 1.5);
+
+  // The weighted mean of the filters with that exponent
+  double weight = 0.0;
+  double elasticity = 0.0;
+  for (Eigen::Index i = 0; i < bank.size(); ++i)
+  {
+    if (bank.exponent(i) == 1.5)
+    {
+      weight += bank.weight(i);
+      elasticity += bank.weight(i) * bank.getState(i).x3();
+    }
+  }
+  const State x = bank.getState();
+  EXPECT_NEAR(x.x3(), elasticity / weight, 1e-9 * x.x3());
+  EXPECT_NEAR(x.x3(), 2500.0, 250.0);
+  EXPECT_NEAR(x.x4(), 4000.0, 400.0);
+}
+
+TEST(FilterBank, LetsLateConvergingHypothesesTakeOver)
+{
+  // With this noise, a filter with the exponent 1.35 fits best while the ones with 1.5 still
+  // converge from their priors. Without forgetting, it would keep that lead.
+  const std::vector<Input> inputs = palpate(20000, 1.5, 2500.0, 4000.0, 2);
+
+  FilterBank bank;
+  bank.setModelData(kMass, kTimeStep);
+  for (double n : {1.2, 1.35, 1.5, 1.65})
+  {
+    for (double elasticity : {500.0, 1000.0, 2000.0, 4000.0})
+    {
+      for (double viscosity : {250.0, 500.0, 1000.0, 2000.0})
+      {
+        bank.addHypothesis(n, initialState(elasticity, viscosity), initialCovariance());
+      }
+    }
+  }
+  for (const Input & input : inputs)
+  {
+    bank.predict(input.force);
+    bank.update(input.velocity);
+  }
+  EXPECT_DOUBLE_EQ(bank.exponent(), 1.5);
+  EXPECT_NEAR(bank.getState().x3(), 2500.0, 250.0);
+}
@@ -0,0 +1,105 @@
+#include <end_effector_controller/measurement_buffer.h>
+#include <gtest/gtest.h>
+
+using end_effector_controller::MeasurementBuffer;
+
+TEST(MeasurementBuffer, WaitsForTheForceOfASample)
+{
+  MeasurementBuffer<int, 8> buffer;
+  double time;
+  int sample;
+  double force;
+
+  buffer.addSample(1.0, 10);
+  EXPECT_FALSE(buffer.pop(time, sample, force));
+
+  buffer.addForce({0.9, 1.0});
+  EXPECT_FALSE(buffer.pop(time, sample, force));
+  EXPECT_EQ(buffer.pending(), 1u);
+
+  buffer.addForce({1.1, 3.0});
+  ASSERT_TRUE(buffer.pop(time, sample, force));
+  EXPECT_DOUBLE_EQ(time, 1.0);
+  EXPECT_EQ(sample, 10);
+  EXPECT_NEAR(force, 2.0, 1e-12);
+  EXPECT_EQ(buffer.pending(), 0u);
+}
+
+TEST(MeasurementBuffer, InterpolatesBetweenTheSurroundingForces)
+{
+  MeasurementBuffer<int, 8> buffer;
+  for (int i = 0; i < 5; ++i)
+  {
+    buffer.addSample(0.25 * i, i);
+  }
+  buffer.addForce({0.0, 0.0});
+  buffer.addForce({0.5, 1.0});
+  buffer.addForce({1.0, 5.0});
+
+  const double expected[5] = {0.0, 0.5, 1.0, 3.0, 5.0};
+  double time;
+  int sample;
+  double force;
+  for (int i = 0; i < 5; ++i)
+  {
+    ASSERT_TRUE(buffer.pop(time, sample, force));
+    EXPECT_EQ(sample, i);
+    EXPECT_DOUBLE_EQ(time, 0.25 * i);
+    EXPECT_NEAR(force, expected[i], 1e-12);
+  }
+  EXPECT_FALSE(buffer.pop(time, sample, force));
+}
+
+TEST(MeasurementBuffer, SkipsSamplesOlderThanTheForces)
+{
+  MeasurementBuffer<int, 8> buffer;
+  buffer.addSample(0.1, 1);
+  buffer.addSample(0.2, 2);
+  buffer.addForce({0.15, 4.0});
+  buffer.addForce({0.25, 4.0});
+
+  double time;
+  int sample;
+  double force;
+  ASSERT_TRUE(buffer.pop(time, sample, force));
+  EXPECT_EQ(sample, 2);
+  EXPECT_FALSE(buffer.pop(time, sample, force));
+}
+
+TEST(MeasurementBuffer, IgnoresForcesOutOfOrder)
+{
+  MeasurementBuffer<int, 8> buffer;
+  buffer.addSample(1.0, 1);
+  buffer.addForce({0.5, 1.0});
+  buffer.addForce({1.5, 2.0});
+  buffer.addForce({1.2, 100.0});
+
+  double time;
+  int sample;
+  double force;
+  ASSERT_TRUE(buffer.pop(time, sample, force));
+  EXPECT_NEAR(force, 1.5, 1e-12);
+}
+
+TEST(MeasurementBuffer, OverwritesTheOldestSamplesWhenFull)
+{
+  MeasurementBuffer<int, 4> buffer;
+  for (int i = 0; i < 4; ++i)
+  {
+    EXPECT_TRUE(buffer.addSample(i, i));
+  }
+  EXPECT_FALSE(buffer.addSample(4, 4));
+  EXPECT_EQ(buffer.pending(), 4u);
+
+  buffer.addForce({0.0, 0.0});
+  buffer.addForce({10.0, 0.0});
+  double time;
+  int sample;
+  double force;
+  ASSERT_TRUE(buffer.pop(time, sample, force));
+  EXPECT_EQ(sample, 1);
+
+  buffer.clear();
+  EXPECT_EQ(buffer.pending(), 0u);
+  EXPECT_FALSE(buffer.pop(time, sample, force));
+}
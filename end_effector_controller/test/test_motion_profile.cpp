@@ -0,0 +1,126 @@
+#include <end_effector_controller/motion_profile.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+using end_effector_controller::JerkLimitedProfile;
+using end_effector_controller::LinearMotion;
+using end_effector_controller::MotionLimits;
+
+namespace
+{
+const MotionLimits kLimits = {0.02, 0.05, 0.5};
+
+/**
+ * @brief Check position, velocity and acceleration by finite differences
+ */
+void expectWithinLimits(const JerkLimitedProfile & profile, double distance)
+{
+  const double dt = 1e-4;
+  double previous_velocity = 0.0;
+  for (double t = 0.0; t < profile.duration(); t += dt)
+  {
+    const double velocity = (profile.position(t + dt) - profile.position(t)) / dt;
+    EXPECT_GE(velocity, 0.0);
+    EXPECT_LE(velocity, kLimits.velocity * (1 + 1e-6));
+    EXPECT_LE(std::abs(velocity - previous_velocity) / dt, kLimits.acceleration * 1.01);
+    previous_velocity = velocity;
+  }
+  EXPECT_NEAR(profile.position(profile.duration()), distance, 1e-12);
+}
+}  // namespace
+
+TEST(JerkLimitedProfile, CruisesAtTheVelocityLimit)
+{
+  JerkLimitedProfile profile;
+  profile.plan(0.1, kLimits);
+
+  // Jerk for 0.1 s, then 0.3 s at the acceleration limit up to 0.02 m/s after 0.5 s and 5 mm
+  EXPECT_NEAR(profile.duration(), 2 * 0.5 + (0.1 - 2 * 0.005) / 0.02, 1e-12);
+  EXPECT_NEAR(profile.position(0.1), 0.5 * 0.1 * 0.1 * 0.1 / 6, 1e-12);
+  EXPECT_NEAR(profile.position(0.5), 0.005, 1e-12);
+  EXPECT_NEAR(profile.position(0.5 + 1.0), 0.005 + 0.02, 1e-12);
+  EXPECT_NEAR(profile.position(0.5 * profile.duration()), 0.05, 1e-12);
+  EXPECT_DOUBLE_EQ(profile.position(-1.0), 0.0);
+  EXPECT_DOUBLE_EQ(profile.position(profile.duration() + 1.0), 0.1);
+  expectWithinLimits(profile, 0.1);
+}
+
+TEST(JerkLimitedProfile, ShortDistancesStayBelowTheLimits)
+{
+  // Reaches the acceleration limit, but not the velocity limit
+  JerkLimitedProfile profile;
+  profile.plan(0.005, kLimits);
+  const double jerk_time = 0.1;
+  const double acceleration_time =
+    0.5 * jerk_time + std::sqrt(0.25 * jerk_time * jerk_time + 0.005 / 0.05);
+  EXPECT_NEAR(profile.duration(), 2 * acceleration_time, 1e-12);
+  expectWithinLimits(profile, 0.005);
+
+  // Neither, with four jerk phases of equal length
+  profile.plan(0.0001, kLimits);
+  EXPECT_NEAR(profile.duration(), 4 * std::cbrt(0.5 * 0.0001 / 0.5), 1e-12);
+  EXPECT_NEAR(profile.position(0.5 * profile.duration()), 0.00005, 1e-15);
+  expectWithinLimits(profile, 0.0001);
+
+  profile.plan(0.0, kLimits);
+  EXPECT_DOUBLE_EQ(profile.duration(), 0.0);
+  EXPECT_DOUBLE_EQ(profile.position(1.0), 0.0);
+}
+
+TEST(JerkLimitedProfile, InfiniteDistancesCruiseForever)
+{
+  JerkLimitedProfile profile;
+  profile.plan(std::numeric_limits<double>::infinity(), kLimits);
+  EXPECT_TRUE(std::isinf(profile.duration()));
+  EXPECT_NEAR(profile.position(0.5), 0.005, 1e-12);
+  EXPECT_NEAR(profile.position(100.5), 0.005 + 100 * 0.02, 1e-9);
+}
+
+TEST(LinearMotion, StopsAtTheGoal)
+{
+  const Eigen::Vector3d from(0.1, 0.2, 0.3);
+  const Eigen::Vector3d to(0.1, 0.23, 0.26);
+
+  LinearMotion motion;
+  motion.start(from, to, kLimits);
+  EXPECT_FALSE(motion.finished());
+
+  Eigen::Vector3d position = from;
+  int cycles = 0;
+  while (!motion.finished() && cycles < 100000)
+  {
+    const Eigen::Vector3d next = motion.step(0.002);
+
+    // Along the straight line
+    EXPECT_NEAR((next - from).normalized().dot((to - from).normalized()), 1.0, 1e-9);
+    EXPECT_LE((next - position).norm(), kLimits.velocity * 0.002 * (1 + 1e-6));
+    position = next;
+    ++cycles;
+  }
+  EXPECT_TRUE(motion.finished());
+  EXPECT_NEAR((position - to).norm(), 0.0, 1e-12);
+}
+
+TEST(LinearMotion, EndlessMotionsKeepTheirDirection)
+{
+  const Eigen::Vector3d from(0.0, 0.0, 0.1);
+
+  LinearMotion motion;
+  motion.startEndless(from, Eigen::Vector3d(0.0, 0.0, -2.0), kLimits);
+  Eigen::Vector3d position;
+  for (int i = 0; i < 1000; ++i)
+  {
+    position = motion.step(0.002);
+  }
+  EXPECT_FALSE(motion.finished());
+  EXPECT_NEAR(position.x(), 0.0, 1e-15);
+  EXPECT_NEAR(position.y(), 0.0, 1e-15);
+  EXPECT_NEAR(position.z(), 0.1 - (0.005 + 1.5 * 0.02), 1e-9);
+
+  // A motion of zero length is finished right away
+  motion.start(from, from, kLimits);
+  EXPECT_TRUE((motion.step(0.002) - from).isZero());
+  EXPECT_TRUE(motion.finished());
+}
@@ -0,0 +1,182 @@
+#include <end_effector_controller/palpation_planner.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <set>
+#include <utility>
+
+using end_effector_controller::PalpationPlanner;
+using end_effector_controller::PalpationPlannerConfig;
+
+namespace
+{
+// A 3 x 3 grid with 5 mm between the sites
+PalpationPlannerConfig grid(const std::string & ordering)
+{
+  PalpationPlannerConfig config;
+  config.region = {0.0, 0.0, 0.01, 0.01};
+  config.resolution = 0.005;
+  config.ordering = ordering;
+  config.height_tolerance = 0.001;
+  config.clearance = 0.005;
+  return config;
+}
+
+std::set<std::pair<long, long>> visited(PalpationPlanner & planner)
+{
+  std::set<std::pair<long, long>> sites;
+  for (; !planner.done(); planner.next())
+  {
+    sites.insert({std::lround(planner.site().x * 1e4), std::lround(planner.site().y * 1e4)});
+  }
+  return sites;
+}
+}  // namespace
+
+TEST(PalpationPlanner, SerpentineAlternatesTheColumns)
+{
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(grid("serpentine"), 1.0, 2.0));
+  ASSERT_EQ(planner.size(), 9u);
+
+  const double expected[9][2] = {{0.0, 0.0},   {0.0, 0.005},   {0.0, 0.01},
+                                 {0.005, 0.01}, {0.005, 0.005}, {0.005, 0.0},
+                                 {0.01, 0.0},   {0.01, 0.005},  {0.01, 0.01}};
+  for (const auto & site : expected)
+  {
+    ASSERT_FALSE(planner.done());
+    EXPECT_NEAR(planner.site().x, 1.0 + site[0], 1e-12);
+    EXPECT_NEAR(planner.site().y, 2.0 + site[1], 1e-12);
+    planner.next();
+  }
+  EXPECT_TRUE(planner.done());
+  EXPECT_NEAR(planner.length(), 8 * 0.005, 1e-12);
+}
+
+TEST(PalpationPlanner, NearestNeighborStartsNextToTheStartingPosition)
+{
+  PalpationPlannerConfig config = grid("nearest_neighbor");
+  config.region = {-0.01, -0.01, 0.01, 0.01};
+
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  EXPECT_NEAR(planner.site().x, 0.0, 1e-12);
+  EXPECT_NEAR(planner.site().y, 0.0, 1e-12);
+
+  // Each grid site once, along a tour without long detours
+  EXPECT_LE(planner.length(), 1.25 * (planner.size() - 1) * config.resolution);
+  EXPECT_EQ(visited(planner).size(), 25u);
+}
+
+TEST(PalpationPlanner, NearestNeighborUntanglesGivenSites)
+{
+  // Greedy steps left, zigzags right and crosses back over the start for 71 mm
+  PalpationPlannerConfig config = grid("nearest_neighbor");
+  config.sites = {0.0, 0.0, 0.01, 0.0, 0.02, 0.0, -0.005, 0.0, -0.021, 0.0};
+
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  EXPECT_LE(planner.length(), 0.062 + 1e-12);
+  EXPECT_EQ(visited(planner).size(), 5u);
+}
+
+TEST(PalpationPlanner, DerivesTheResolutionFromGivenSites)
+{
+  // Two columns 5 mm apart, with 5 mm between their sites
+  PalpationPlannerConfig config = grid("serpentine");
+  config.sites = {0.005, 0.0, 0.0, 0.005, 0.0, 0.0, 0.005, 0.005};
+  config.resolution = 0.0;
+
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  const double expected[4][2] = {{0.0, 0.0}, {0.0, 0.005}, {0.005, 0.005}, {0.005, 0.0}};
+  for (const auto & site : expected)
+  {
+    ASSERT_FALSE(planner.done());
+    EXPECT_NEAR(planner.site().x, site[0], 1e-12);
+    EXPECT_NEAR(planner.site().y, site[1], 1e-12);
+    planner.next();
+  }
+
+  // Neighbours along the derived resolution
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  planner.setSurfaceHeight(0.0);
+  EXPECT_NEAR(planner.retractHeight(0.1), 0.005, 1e-12);
+}
+
+TEST(PalpationPlanner, RejectsInvalidConfigurations)
+{
+  PalpationPlanner planner;
+
+  PalpationPlannerConfig config = grid("serpentine");
+  config.sites = {0.0, 0.0, 0.01};
+  EXPECT_FALSE(planner.configure(config, 0.0, 0.0));
+
+  config = grid("serpentine");
+  config.resolution = 0.0;
+  EXPECT_FALSE(planner.configure(config, 0.0, 0.0));
+
+  config.sites = {0.0, 0.0, 0.01, 0.0};
+  config.resolution = -0.005;
+  EXPECT_FALSE(planner.configure(config, 0.0, 0.0));
+
+  config = grid("serpentine");
+  config.region = {0.01, 0.0, 0.0, 0.01};
+  EXPECT_FALSE(planner.configure(config, 0.0, 0.0));
+
+  EXPECT_FALSE(planner.configure(grid("spiral"), 0.0, 0.0));
+  EXPECT_TRUE(planner.done());
+}
+
+TEST(PalpationPlanner, RetractsToAClearanceBetweenFlatNeighbours)
+{
+  const double full_height = 0.1;
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(grid("serpentine"), 0.0, 0.0));
+
+  // Unknown surface
+  EXPECT_TRUE(std::isnan(planner.surfaceHeight()));
+  EXPECT_DOUBLE_EQ(planner.retractHeight(full_height), full_height);
+
+  planner.setSurfaceHeight(0.0);
+  EXPECT_DOUBLE_EQ(planner.surfaceHeight(), 0.0);
+  EXPECT_NEAR(planner.retractHeight(full_height), 0.005, 1e-12);
+  EXPECT_DOUBLE_EQ(planner.retractHeight(0.003), 0.003);
+
+  // Within the tolerance of the known surface around the next site
+  planner.next();
+  EXPECT_DOUBLE_EQ(planner.surfaceHeight(), 0.0);
+  planner.setSurfaceHeight(0.0005);
+  EXPECT_NEAR(planner.retractHeight(full_height), 0.0055, 1e-12);
+
+  // Beyond it, since the next site also neighbours the second one diagonally
+  planner.next();
+  planner.setSurfaceHeight(0.003);
+  EXPECT_DOUBLE_EQ(planner.surfaceHeight(), 0.003);
+  EXPECT_DOUBLE_EQ(planner.retractHeight(full_height), full_height);
+}
+
+TEST(PalpationPlanner, RetractsFullyWithoutANeighbouringNextSite)
+{
+  const double full_height = 0.1;
+
+  // Between the columns of a coarse grid
+  PalpationPlannerConfig config = grid("serpentine");
+  config.sites = {0.0, 0.0, 0.02, 0.0};
+  PalpationPlanner planner;
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  planner.setSurfaceHeight(0.0);
+  EXPECT_DOUBLE_EQ(planner.retractHeight(full_height), full_height);
+
+  // After the last site
+  planner.next();
+  planner.setSurfaceHeight(0.0);
+  EXPECT_DOUBLE_EQ(planner.retractHeight(full_height), full_height);
+
+  // If disabled
+  config = grid("serpentine");
+  config.height_tolerance = -1.0;
+  ASSERT_TRUE(planner.configure(config, 0.0, 0.0));
+  planner.setSurfaceHeight(0.0);
+  EXPECT_DOUBLE_EQ(planner.retractHeight(full_height), full_height);
+}
@@ -0,0 +1,86 @@
+#include <end_effector_controller/triggered_capture.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using end_effector_controller::TriggeredCapture;
+
+namespace
+{
+template <size_t N>
+std::vector<int> drain(TriggeredCapture<int, N> & capture)
+{
+  std::vector<int> records;
+  int record;
+  while (capture.pop(record))
+  {
+    records.push_back(record);
+  }
+  return records;
+}
+}  // namespace
+
+TEST(TriggeredCapture, ReleasesNothingWithoutTriggers)
+{
+  TriggeredCapture<int, 16> capture;
+  capture.setWindow(3, 2);
+  for (int i = 0; i < 100; ++i)
+  {
+    capture.add(i, false);
+  }
+  EXPECT_FALSE(capture.active());
+  EXPECT_EQ(capture.released(), 0u);
+  EXPECT_TRUE(drain(capture).empty());
+  EXPECT_EQ(capture.dropped(), 0u);
+}
+
+TEST(TriggeredCapture, ReleasesTheWindowAroundATrigger)
+{
+  TriggeredCapture<int, 16> capture;
+  capture.setWindow(3, 2);
+  for (int i = 0; i < 20; ++i)
+  {
+    capture.add(i, i == 10);
+  }
+
+  // Three records before the trigger and two after it
+  EXPECT_EQ(drain(capture), std::vector<int>({7, 8, 9, 10, 11, 12}));
+  EXPECT_FALSE(capture.active());
+  EXPECT_EQ(capture.dropped(), 0u);
+}
+
+TEST(TriggeredCapture, ExtendsTheWindowWithEachTrigger)
+{
+  // Drained each cycle, like the controller's publisher
+  TriggeredCapture<int, 16> capture;
+  capture.setWindow(2, 2);
+  std::vector<int> records;
+  for (int i = 0; i < 30; ++i)
+  {
+    capture.add(i, i == 5 || i == 7 || i == 20);
+    EXPECT_EQ(capture.active(), (i >= 5 && i <= 9) || (i >= 20 && i <= 22));
+    const std::vector<int> released = drain(capture);
+    records.insert(records.end(), released.begin(), released.end());
+  }
+  EXPECT_EQ(records, std::vector<int>({3, 4, 5, 6, 7, 8, 9, 18, 19, 20, 21, 22}));
+  EXPECT_EQ(capture.dropped(), 0u);
+}
+
+TEST(TriggeredCapture, CountsUndrainedRecordsAsDropped)
+{
+  TriggeredCapture<int, 8> capture;
+  capture.setWindow(2, 100);
+  for (int i = 0; i < 20; ++i)
+  {
+    capture.add(i, i == 4);
+  }
+
+  // The window released 2 + 16 records, of which only the newest 8 fit
+  EXPECT_TRUE(capture.active());
+  EXPECT_EQ(capture.dropped(), 10u);
+  EXPECT_EQ(drain(capture), std::vector<int>({12, 13, 14, 15, 16, 17, 18, 19}));
+
+  capture.clear();
+  EXPECT_FALSE(capture.active());
+  EXPECT_TRUE(drain(capture).empty());
+}